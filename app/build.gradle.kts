@@ -203,6 +203,7 @@ dependencies {
     testImplementation(libs.junit)
     testImplementation(libs.kotlinx.coroutines.test)
     testImplementation("io.mockk:mockk:1.13.9")
+    testImplementation("org.json:json:20231013") // Real org.json; android.jar only has stubs
     
     // JUnit 5
     testImplementation(libs.junit.jupiter.api)
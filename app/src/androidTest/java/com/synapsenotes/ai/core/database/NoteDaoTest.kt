@@ -42,6 +42,19 @@ class NoteDaoTest {
         assertEquals(note, byId)
     }
 
+    @Test
+    fun updateEmbeddingOnlyTouchesTheMatchingVersion() = runBlocking {
+        noteDao.insert(NoteEntity("1", "Title", "Content", 123L, 456L))
+
+        assertEquals(0, noteDao.updateEmbedding("1", 455L, floatArrayOf(1f, 2f)))
+        assertNull(noteDao.getById("1")!!.embedding)
+
+        assertEquals(1, noteDao.updateEmbedding("1", 456L, floatArrayOf(1f, 2f)))
+        val stored = noteDao.getById("1")!!
+        assertEquals("Content", stored.content)
+        assertEquals(listOf(1f, 2f), stored.embedding!!.toList())
+    }
+
     @Test
     fun deleteNote() = runBlocking {
         val note = NoteEntity("1", "Title", "Content", 123L, 123L)
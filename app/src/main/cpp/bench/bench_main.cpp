@@ -0,0 +1,351 @@
+// Host benchmark for the native core: time to first token, prefill and decode speed of a chat model,
+// embedding throughput of an embedding model, and peak RSS. Results are printed, optionally written
+// as JSON, and optionally compared against an earlier JSON result to catch regressions.
+//
+//   llm_bench -m chat.gguf -e embed.gguf -o result.json --baseline baseline.json
+//
+// Exit status: 0 ok, 1 regression against the baseline, 2 usage or load error.
+
+#include "inference.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchOptions {
+    std::string chat_model;
+    std::string embed_model;
+    std::string output_path;
+    std::string baseline_path;
+    int n_prompt = 512;
+    int n_gen = 128;
+    int n_ctx = 2048;
+    int n_batch = 512;
+    int n_threads = 0;
+    int repetitions = 3;
+    int n_embed_texts = 64;
+    double tolerance = 0.10;
+    bool verbose = false;
+};
+
+struct Metric {
+    const char* name;
+    bool higher_is_better;
+    double value;
+};
+
+static void print_usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s -m CHAT.gguf [-e EMBED.gguf] [options]\n"
+            "  -m PATH          chat model\n"
+            "  -e PATH          embedding model\n"
+            "  -p N             prompt tokens (default 512)\n"
+            "  -n N             generated tokens (default 128)\n"
+            "  -c N             context size (default 2048)\n"
+            "  -b N             batch size (default 512)\n"
+            "  -t N             threads (default: all cores)\n"
+            "  -r N             repetitions, the median is reported (default 3)\n"
+            "  --embed-texts N  texts per embedding run (default 64)\n"
+            "  -o PATH          write results as JSON\n"
+            "  --baseline PATH  compare against an earlier JSON result\n"
+            "  --tolerance F    allowed relative regression (default 0.10)\n"
+            "  -v               show llama.cpp logs\n",
+            argv0);
+}
+
+static bool parse_args(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-v") {
+            options.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (arg == "-m") options.chat_model = value;
+        else if (arg == "-e") options.embed_model = value;
+        else if (arg == "-o") options.output_path = value;
+        else if (arg == "--baseline") options.baseline_path = value;
+        else if (arg == "-p") options.n_prompt = atoi(value);
+        else if (arg == "-n") options.n_gen = atoi(value);
+        else if (arg == "-c") options.n_ctx = atoi(value);
+        else if (arg == "-b") options.n_batch = atoi(value);
+        else if (arg == "-t") options.n_threads = atoi(value);
+        else if (arg == "-r") options.repetitions = atoi(value);
+        else if (arg == "--embed-texts") options.n_embed_texts = atoi(value);
+        else if (arg == "--tolerance") options.tolerance = atof(value);
+        else return false;
+    }
+    if (options.n_threads <= 0) options.n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (options.repetitions <= 0) options.repetitions = 1;
+    return !options.chat_model.empty() || !options.embed_model.empty();
+}
+
+static void quiet_log_callback(ggml_log_level level, const char* text, void* user_data) {
+    const bool verbose = *static_cast<const bool*>(user_data);
+    if (verbose || level == GGML_LOG_LEVEL_ERROR) fputs(text, stderr);
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double median(std::vector<double> values) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    const size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+// Peak resident set size of this process in MB, from VmHWM in /proc/self/status
+static double peak_rss_mb() {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return 0;
+    char line[256];
+    unsigned long long kb = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmHWM: %llu kB", &kb) == 1) break;
+    }
+    fclose(file);
+    return kb / 1024.0;
+}
+
+// Deterministic note-like texts of varying length, a few longer than one micro-batch
+static std::vector<std::string> embedding_texts(int n_texts) {
+    static const char* words[] = {
+        "meeting", "notes", "project", "deadline", "review", "design", "the", "a", "with", "for",
+        "budget", "draft", "summary", "customer", "feedback", "release", "plan", "and", "to", "of",
+        "research", "paper", "idea", "follow", "up", "question", "answer", "list", "todo", "tomorrow",
+    };
+    const int n_words = sizeof(words) / sizeof(words[0]);
+    std::vector<std::string> texts(n_texts);
+    uint32_t state = 12345;
+    for (int i = 0; i < n_texts; i++) {
+        const int length = i % 16 == 15 ? 700 : 16 + (i * 37) % 240;
+        for (int w = 0; w < length; w++) {
+            state = state * 1664525u + 1013904223u;
+            if (w > 0) texts[i] += ' ';
+            texts[i] += words[(state >> 16) % n_words];
+        }
+    }
+    return texts;
+}
+
+static bool bench_chat(const BenchOptions& options, std::vector<Metric>& metrics) {
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0;
+
+    const double t_load = now_ms();
+    llama_model* model = llama_model_load_from_file(options.chat_model.c_str(), model_params);
+    if (!model) {
+        fprintf(stderr, "failed to load chat model %s\n", options.chat_model.c_str());
+        return false;
+    }
+
+    // Same shape as the app's chat context
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = options.n_ctx;
+    ctx_params.n_batch = options.n_batch;
+    ctx_params.n_threads = options.n_threads;
+    ctx_params.n_threads_batch = options.n_threads;
+    ctx_params.kv_unified = true;
+    llama_context* ctx = llama_init_from_model(model, ctx_params);
+    const double load_ms = now_ms() - t_load;
+    if (!ctx) {
+        fprintf(stderr, "failed to create chat context\n");
+        llama_model_free(model);
+        return false;
+    }
+
+    const std::vector<llama_token> prompt = bench_tokens(llama_model_get_vocab(model), options.n_prompt);
+    std::vector<double> ttft, prefill, decode;
+    bool ok = true;
+    for (int r = 0; r < options.repetitions && ok; r++) {
+        GenerationBench bench;
+        ok = bench_generation(ctx, model, prompt, options.n_gen, bench);
+        if (!ok) break;
+        ttft.push_back(bench.ttft_ms);
+        prefill.push_back(bench.prefill_tps);
+        decode.push_back(bench.decode_tps);
+        fprintf(stderr, "chat run %d: %d prompt + %d generated tokens, TTFT %.1f ms, prefill %.1f tok/s, decode %.1f tok/s\n",
+                r + 1, bench.n_prompt, bench.n_gen, bench.ttft_ms, bench.prefill_tps, bench.decode_tps);
+    }
+
+    llama_free(ctx);
+    llama_model_free(model);
+    if (!ok) {
+        fprintf(stderr, "chat benchmark failed\n");
+        return false;
+    }
+
+    metrics.push_back({"chat_load_ms", false, load_ms});
+    metrics.push_back({"ttft_ms", false, median(ttft)});
+    metrics.push_back({"prefill_tps", true, median(prefill)});
+    metrics.push_back({"decode_tps", true, median(decode)});
+    return true;
+}
+
+static bool bench_embedding(const BenchOptions& options, std::vector<Metric>& metrics) {
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0;
+
+    const double t_load = now_ms();
+    llama_model* model = llama_model_load_from_file(options.embed_model.c_str(), model_params);
+    if (!model) {
+        fprintf(stderr, "failed to load embedding model %s\n", options.embed_model.c_str());
+        return false;
+    }
+    llama_context_params ctx_params = embedding_context_params();
+    ctx_params.n_threads = options.n_threads;
+    ctx_params.n_threads_batch = options.n_threads;
+    llama_context* ctx = llama_init_from_model(model, ctx_params);
+    const double load_ms = now_ms() - t_load;
+    if (!ctx) {
+        fprintf(stderr, "failed to create embedding context\n");
+        llama_model_free(model);
+        return false;
+    }
+
+    const std::vector<std::string> texts = embedding_texts(options.n_embed_texts);
+    size_t n_tokens = 0;
+    for (const std::string& text : texts) {
+        n_tokens += tokenize_text(llama_model_get_vocab(model), text.c_str(), text.size()).size();
+    }
+
+    std::vector<double> texts_per_s, tokens_per_s;
+    std::vector<float> output;
+    bool ok = true;
+    for (int r = 0; r < options.repetitions + 1 && ok; r++) {
+        const double t_start = now_ms();
+        ok = embed_texts(ctx, model, texts, output);
+        const double elapsed_s = std::max(now_ms() - t_start, 1e-3) / 1000.0;
+        if (!ok || r == 0) continue; // The first run warms up
+        texts_per_s.push_back(texts.size() / elapsed_s);
+        tokens_per_s.push_back(n_tokens / elapsed_s);
+        fprintf(stderr, "embedding run %d: %zu texts, %zu tokens, %.1f texts/s, %.1f tok/s\n",
+                r, texts.size(), n_tokens, texts_per_s.back(), tokens_per_s.back());
+    }
+
+    llama_free(ctx);
+    llama_model_free(model);
+    if (!ok) {
+        fprintf(stderr, "embedding benchmark failed\n");
+        return false;
+    }
+
+    metrics.push_back({"embed_load_ms", false, load_ms});
+    metrics.push_back({"embed_texts_per_s", true, median(texts_per_s)});
+    metrics.push_back({"embed_tokens_per_s", true, median(tokens_per_s)});
+    return true;
+}
+
+static std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static bool write_json(const std::string& path, const BenchOptions& options, const std::vector<Metric>& metrics) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"chat_model\": \"%s\",\n", json_escape(options.chat_model).c_str());
+    fprintf(file, "  \"embed_model\": \"%s\",\n", json_escape(options.embed_model).c_str());
+    fprintf(file, "  \"config\": {\"n_prompt\": %d, \"n_gen\": %d, \"n_ctx\": %d, \"n_batch\": %d, \"n_threads\": %d, \"repetitions\": %d, \"embed_texts\": %d},\n",
+            options.n_prompt, options.n_gen, options.n_ctx, options.n_batch, options.n_threads, options.repetitions, options.n_embed_texts);
+    fprintf(file, "  \"metrics\": {\n");
+    for (size_t i = 0; i < metrics.size(); i++) {
+        fprintf(file, "    \"%s\": %.3f%s\n", metrics[i].name, metrics[i].value, i + 1 < metrics.size() ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    return fclose(file) == 0;
+}
+
+// Value of "name": <number> inside the "metrics" object of a file written by write_json
+static bool read_baseline_metric(const std::string& json, const char* name, double& value) {
+    const size_t metrics = json.find("\"metrics\"");
+    if (metrics == std::string::npos) return false;
+    const size_t key = json.find(std::string("\"") + name + "\"", metrics);
+    if (key == std::string::npos) return false;
+    const size_t colon = json.find(':', key);
+    if (colon == std::string::npos) return false;
+    char* end = nullptr;
+    value = strtod(json.c_str() + colon + 1, &end);
+    return end != json.c_str() + colon + 1;
+}
+
+// Print each metric against the baseline; returns the number of regressions beyond tolerance
+static int compare_baseline(const std::string& path, double tolerance, const std::vector<Metric>& metrics) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        fprintf(stderr, "cannot read baseline %s\n", path.c_str());
+        return -1;
+    }
+    std::string json;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) json.append(buf, n);
+    fclose(file);
+
+    int regressions = 0;
+    printf("\n%-20s %12s %12s %8s\n", "metric", "baseline", "current", "change");
+    for (const Metric& metric : metrics) {
+        double base = 0;
+        if (!read_baseline_metric(json, metric.name, base) || base <= 0) {
+            printf("%-20s %12s %12.2f %8s\n", metric.name, "-", metric.value, "new");
+            continue;
+        }
+        const double change = (metric.value - base) / base;
+        const bool regressed = metric.higher_is_better ? change < -tolerance : change > tolerance;
+        if (regressed) regressions++;
+        printf("%-20s %12.2f %12.2f %+7.1f%%%s\n", metric.name, base, metric.value, change * 100, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    llama_log_set(quiet_log_callback, &options.verbose);
+    llama_backend_init();
+
+    std::vector<Metric> metrics;
+    bool ok = true;
+    if (!options.chat_model.empty()) ok = bench_chat(options, metrics) && ok;
+    if (!options.embed_model.empty()) ok = bench_embedding(options, metrics) && ok;
+    metrics.push_back({"peak_rss_mb", false, peak_rss_mb()});
+    llama_backend_free();
+    if (!ok) return 2;
+
+    printf("%-20s %12s\n", "metric", "value");
+    for (const Metric& metric : metrics) {
+        printf("%-20s %12.2f\n", metric.name, metric.value);
+    }
+
+    if (!options.output_path.empty() && !write_json(options.output_path, options, metrics)) {
+        fprintf(stderr, "cannot write %s\n", options.output_path.c_str());
+        return 2;
+    }
+
+    if (!options.baseline_path.empty()) {
+        const int regressions = compare_baseline(options.baseline_path, options.tolerance, metrics);
+        if (regressions < 0) return 2;
+        if (regressions > 0) {
+            printf("\n%d metric(s) regressed by more than %.0f%%\n", regressions, options.tolerance * 100);
+            return 1;
+        }
+    }
+    return 0;
+}
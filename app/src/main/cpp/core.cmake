@@ -0,0 +1,31 @@
+# Platform-neutral native core: no JNI or Android dependencies. Built into the app library and into
+# the host benchmark (bench/). Expects the llama target to exist.
+add_library(
+        llm_notes_core
+        STATIC
+        ${CMAKE_CURRENT_LIST_DIR}/inference.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/vector_index.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/text_index.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/token_stream.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/scheduler.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/embed_pipeline.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/offload_planner.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/trace.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/prompt_assembler.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/embedding_cache.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/cpu_topology.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/embedding_codec.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/decode_governor.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/gguf_inspector.cpp
+)
+
+# Linked into the shared JNI library
+set_target_properties(llm_notes_core PROPERTIES POSITION_INDEPENDENT_CODE ON)
+
+target_include_directories(llm_notes_core PUBLIC ${CMAKE_CURRENT_LIST_DIR})
+
+target_link_libraries(
+        llm_notes_core
+        PUBLIC
+        llama
+)
@@ -0,0 +1,152 @@
+#include "cpu_topology.h"
+#include "ggml-cpu.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+bool read_long(const std::string& path, long& value) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    const bool ok = fscanf(f, "%ld", &value) == 1;
+    fclose(f);
+    return ok;
+}
+
+// Kernel cpu list format, e.g. "0-3,6,8-9"
+std::vector<int> read_cpu_list(const std::string& path) {
+    std::vector<int> cpus;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return cpus;
+    char line[256];
+    if (fgets(line, sizeof(line), f)) {
+        const char* p = line;
+        int first = 0, last = 0, n = 0;
+        while (sscanf(p, "%d%n", &first, &n) == 1) {
+            p += n;
+            last = first;
+            if (*p == '-' && sscanf(p + 1, "%d%n", &last, &n) == 1) p += 1 + n;
+            for (int cpu = first; cpu <= last && cpu < 1024; cpu++) cpus.push_back(cpu);
+            if (*p != ',') break;
+            p++;
+        }
+    }
+    fclose(f);
+    return cpus;
+}
+
+long core_score(const CpuCore& core) {
+    return core.capacity > 0 ? core.capacity : core.max_khz;
+}
+
+} // namespace
+
+CpuTopology read_cpu_topology(const std::string& sysfs_root) {
+    CpuTopology topology;
+    for (int id : read_cpu_list(sysfs_root + "/online")) {
+        const std::string dir = sysfs_root + "/cpu" + std::to_string(id);
+        CpuCore core;
+        core.id = id;
+        read_long(dir + "/cpufreq/cpuinfo_max_freq", core.max_khz);
+        read_long(dir + "/cpu_capacity", core.capacity);
+        const std::vector<int> related = read_cpu_list(dir + "/cpufreq/related_cpus");
+        core.cluster = related.empty() ? id : related.front();
+        topology.cores.push_back(core);
+    }
+
+    std::stable_sort(topology.cores.begin(), topology.cores.end(),
+                     [](const CpuCore& a, const CpuCore& b) { return core_score(a) > core_score(b); });
+
+    // A new tier starts where a core is more than 5% slower than the one before it, so cores of one
+    // class with slightly different binning stay together
+    for (size_t i = 0; i < topology.cores.size(); i++) {
+        if (i > 0) {
+            const long prev = core_score(topology.cores[i - 1]);
+            const long score = core_score(topology.cores[i]);
+            topology.cores[i].tier = topology.cores[i - 1].tier + (score * 100 < prev * 95 ? 1 : 0);
+        }
+        topology.n_tiers = topology.cores[i].tier + 1;
+    }
+    return topology;
+}
+
+ThreadPlan plan_threads(const CpuTopology& topology) {
+    ThreadPlan plan;
+    if (topology.cores.empty()) return plan;
+
+    const int lowest_tier = topology.n_tiers - 1;
+    for (const CpuCore& core : topology.cores) {
+        plan.batch_cpus.push_back(core.id);
+        if (topology.n_tiers == 1 || core.tier < lowest_tier) plan.decode_cpus.push_back(core.id);
+    }
+    plan.n_threads_decode = plan.decode_cpus.size();
+    plan.n_threads_batch = plan.batch_cpus.size();
+    return plan;
+}
+
+std::string describe_topology(const CpuTopology& topology) {
+    std::string out = std::to_string(topology.cores.size()) + " cores in " + std::to_string(topology.n_tiers) + " tiers:";
+    for (size_t i = 0; i < topology.cores.size(); i++) {
+        const CpuCore& core = topology.cores[i];
+        const bool new_tier = i == 0 || core.tier != topology.cores[i - 1].tier;
+        out += new_tier ? (i == 0 ? " [" : "] [") : ",";
+        out += std::to_string(core.id);
+    }
+    if (!topology.cores.empty()) out += "]";
+    return out;
+}
+
+ggml_threadpool_t make_threadpool(const std::vector<int>& cpus, int n_threads, bool strict, ggml_sched_priority prio, unsigned poll) {
+    ggml_threadpool_params params = ggml_threadpool_params_default(n_threads);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < GGML_MAX_N_THREADS) params.cpumask[cpu] = true;
+    }
+    params.strict_cpu = strict && !cpus.empty();
+    params.prio = prio;
+    params.poll = poll;
+
+    ggml_threadpool_t pool = nullptr;
+    std::thread([&] { pool = ggml_threadpool_new(&params); }).join();
+    return pool;
+}
+
+#ifdef __linux__
+
+static_assert(sizeof(cpu_set_t) <= 128, "AffinityScope::saved_ too small for cpu_set_t");
+
+static bool apply_affinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+AffinityScope::AffinityScope(const std::vector<int>& cpus) {
+    if (cpus.empty()) return;
+    cpu_set_t* saved = reinterpret_cast<cpu_set_t*>(saved_);
+    active_ = sched_getaffinity(0, sizeof(cpu_set_t), saved) == 0 && apply_affinity(cpus);
+}
+
+AffinityScope::~AffinityScope() {
+    if (active_) sched_setaffinity(0, sizeof(cpu_set_t), reinterpret_cast<cpu_set_t*>(saved_));
+}
+
+bool set_thread_affinity(const std::vector<int>& cpus) {
+    return !cpus.empty() && apply_affinity(cpus);
+}
+
+#else
+
+AffinityScope::AffinityScope(const std::vector<int>&) {}
+AffinityScope::~AffinityScope() {}
+bool set_thread_affinity(const std::vector<int>&) { return false; }
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+// CPU topology of heterogeneous (big.LITTLE / DynamIQ) SoCs and the thread layout derived from it.
+//
+// Cores are ranked by the kernel's cpu_capacity, or by their maximum frequency where that is missing,
+// and grouped into performance tiers: prime, performance, efficiency. Decode is memory-bound and
+// synchronizes every op, so one thread on an efficiency core holds back the whole step; it runs on
+// the cores above the lowest tier only, one thread pinned per core. Prefill is compute-bound and
+// ggml hands out matrix chunks dynamically, so it runs wide over every online core.
+// Linux only (sysfs and sched_setaffinity); on other systems read_cpu_topology finds no cores.
+
+#include "ggml.h"
+
+#include <string>
+#include <vector>
+
+struct CpuCore {
+    int id = 0;
+    int cluster = 0;       // First core of its cpufreq policy
+    long max_khz = 0;
+    long capacity = 0;     // Kernel's relative compute capacity (1024 = fastest), 0 if not exposed
+    int tier = 0;          // 0 = fastest
+};
+
+struct CpuTopology {
+    std::vector<CpuCore> cores; // Online cores, fastest first
+    int n_tiers = 0;
+};
+
+// Online cores under sysfs_root (normally /sys/devices/system/cpu)
+CpuTopology read_cpu_topology(const std::string& sysfs_root = "/sys/devices/system/cpu");
+
+struct ThreadPlan {
+    int n_threads_decode = 4;
+    int n_threads_batch = 4;
+    std::vector<int> decode_cpus; // Empty: no affinity
+    std::vector<int> batch_cpus;
+};
+
+// Decode on every core above the lowest tier (all cores of a single-tier CPU), prefill on all cores.
+// Without a readable topology, falls back to ggml's default thread count without affinity.
+ThreadPlan plan_threads(const CpuTopology& topology);
+
+// One-line description for logs, e.g. "8 cores in 3 tiers: [7] [4-6] [0-3]"
+std::string describe_topology(const CpuTopology& topology);
+
+// A ggml CPU thread pool of n_threads over cpus (any core if empty). strict pins thread i to the i-th
+// core of cpus. Created on a helper thread: ggml applies the pool's affinity and priority to the
+// creating thread, which would otherwise leak onto the caller.
+ggml_threadpool_t make_threadpool(const std::vector<int>& cpus, int n_threads, bool strict, ggml_sched_priority prio, unsigned poll);
+
+// Restricts the calling thread to cpus for its lifetime, restoring the previous mask afterwards. The
+// thread calling into llama.cpp runs as thread 0 of the pool, so it needs placing too.
+class AffinityScope {
+public:
+    explicit AffinityScope(const std::vector<int>& cpus);
+    ~AffinityScope();
+    AffinityScope(const AffinityScope&) = delete;
+    AffinityScope& operator=(const AffinityScope&) = delete;
+private:
+    bool active_ = false;
+    alignas(8) unsigned char saved_[128]; // cpu_set_t, kept opaque so the header stays portable
+};
+
+// Pin the calling thread to cpus for good (e.g. a dedicated worker). No-op for an empty list.
+bool set_thread_affinity(const std::vector<int>& cpus);
@@ -0,0 +1,143 @@
+#include "decode_governor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+bool read_text(const std::string& path, std::string& text) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[128];
+    const bool ok = fgets(line, sizeof(line), f) != nullptr;
+    fclose(f);
+    if (ok) text = line;
+    return ok;
+}
+
+// Zone types of CPU clusters and SoC aggregates across Qualcomm, MediaTek, Exynos and Tensor
+bool is_cpu_zone(std::string type) {
+    std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const char* name : {"cpu", "soc", "big", "mid", "little", "tsens"}) {
+        if (type.find(name) != std::string::npos) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::vector<std::string> find_thermal_zones(const std::string& root) {
+    std::vector<std::string> cpu_zones;
+    std::vector<std::string> all_zones;
+    // Zone numbers can have gaps, so probe a fixed range instead of stopping at the first missing one
+    for (int i = 0; i < 128; i++) {
+        const std::string dir = root + "/thermal_zone" + std::to_string(i);
+        std::string type;
+        std::string temp;
+        if (!read_text(dir + "/type", type) || !read_text(dir + "/temp", temp)) continue;
+        (is_cpu_zone(type) ? cpu_zones : all_zones).push_back(dir + "/temp");
+    }
+    return cpu_zones.empty() ? all_zones : cpu_zones;
+}
+
+float read_soc_temperature(const std::vector<std::string>& zone_paths) {
+    float max_celsius = 0.0f;
+    for (const std::string& path : zone_paths) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f) continue;
+        long value = 0;
+        const bool ok = fscanf(f, "%ld", &value) == 1;
+        fclose(f);
+        if (!ok) continue;
+        // Millidegrees on most kernels, whole degrees on a few
+        const float celsius = value >= 1000 || value <= -1000 ? value / 1000.0f : (float) value;
+        // Disabled zones report 0 or sentinel values
+        if (celsius > 0.0f && celsius < 150.0f) max_celsius = std::max(max_celsius, celsius);
+    }
+    return max_celsius;
+}
+
+DecodeGovernor::DecodeGovernor(const GovernorConfig& config)
+    : config_(config), zones_(find_thermal_zones(config.thermal_root)), calm_needed_(config.calm_windows) {
+    config_.min_threads = std::max(1, std::min(config_.min_threads, config_.max_threads));
+    config_.min_batch = std::max(1, std::min(config_.min_batch, config_.max_batch));
+}
+
+int DecodeGovernor::n_threads() const {
+    return std::max(config_.min_threads, config_.max_threads - level_);
+}
+
+int DecodeGovernor::n_batch() const {
+    return std::max(config_.min_batch, config_.max_batch >> level_);
+}
+
+int64_t DecodeGovernor::pause_us(int64_t step_us) const {
+    if (level_ == 0 || best_window_us_ == 0) return 0;
+    const int64_t interval = (int64_t) (best_window_us_ * config_.pace_ratio);
+    return std::max<int64_t>(0, interval - step_us);
+}
+
+void DecodeGovernor::set_level(int level) {
+    level_ = level;
+    // Latency at the new setting is measured from scratch
+    best_window_us_ = 0;
+    window_sum_us_ = 0;
+    window_n_ = 0;
+    n_slow_ = 0;
+    n_calm_ = 0;
+}
+
+void DecodeGovernor::refresh_temperature(int64_t now_us) {
+    if (zones_.empty() || (last_thermal_us_ != 0 && now_us - last_thermal_us_ < config_.thermal_period_us)) return;
+    temperature_ = read_soc_temperature(zones_);
+    last_thermal_us_ = now_us;
+}
+
+bool DecodeGovernor::begin(int64_t now_us) {
+    last_thermal_us_ = 0;
+    refresh_temperature(now_us);
+    const int before = level_;
+
+    int level = level_;
+    if (last_step_us_ != 0 && config_.idle_cool_us > 0 && (temperature_ == 0.0f || temperature_ < config_.cool_celsius)) {
+        level -= (int) std::min<int64_t>(level, (now_us - last_step_us_) / config_.idle_cool_us);
+    }
+    // The answer starts hot: do not wait for the latency to show it
+    if (temperature_ >= config_.hot_celsius) level = std::max(level, 1);
+    // Cooled down while idle: the backoff starts over
+    if (level < level_) calm_needed_ = config_.calm_windows;
+    set_level(level);
+    return level_ != before;
+}
+
+bool DecodeGovernor::on_step(int64_t step_us, int64_t now_us) {
+    last_step_us_ = now_us;
+    refresh_temperature(now_us);
+    window_sum_us_ += step_us;
+    if (++window_n_ < config_.window_steps) return false;
+
+    const int64_t avg = window_sum_us_ / window_n_;
+    window_sum_us_ = 0;
+    window_n_ = 0;
+
+    const bool hot = temperature_ >= config_.hot_celsius;
+    const bool slow = best_window_us_ > 0 && avg > best_window_us_ * config_.slow_ratio;
+    const bool cool = has_sensor() ? temperature_ > 0.0f && temperature_ < config_.cool_celsius : !slow;
+    if (best_window_us_ == 0 || avg < best_window_us_) best_window_us_ = avg;
+
+    n_slow_ = hot || slow ? n_slow_ + 1 : 0;
+    n_calm_ = cool && !slow ? n_calm_ + 1 : 0;
+
+    // Two bad windows in a row rule out a one-off stall (GC, a notification)
+    if (n_slow_ >= 2 && level_ < config_.max_level) {
+        calm_needed_ = std::min(config_.max_calm_windows, calm_needed_ * 2);
+        set_level(level_ + 1);
+        return true;
+    }
+    if (n_calm_ >= calm_needed_ && level_ > 0) {
+        set_level(level_ - 1);
+        return true;
+    }
+    return false;
+}
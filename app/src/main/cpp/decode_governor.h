@@ -0,0 +1,81 @@
+#pragma once
+
+// Throughput- and temperature-aware pacing of token-by-token decoding.
+//
+// Under sustained generation a phone heats up and its governor drops the CPU/GPU clocks, so decode
+// latency climbs partway through an answer and a brief cool-down brings back a burst of fast steps.
+// DecodeGovernor watches the latency of every decode step, in windows of a few steps, and the SoC
+// temperature from the thermal zones. When the windows get markedly slower than the best one at the
+// current setting, or the SoC runs hot, it steps up a throttle level: fewer decode threads, smaller
+// prefill chunks, and a paced step interval just above the recent latency, so the rate stays level
+// instead of bursting and crawling. Levels come down again once the SoC has cooled (or, without a
+// sensor, after a run of steady windows); every step up doubles the calm stretch needed before the
+// next step down, so the governor does not oscillate around the thermal limit.
+// Pure logic apart from reading sysfs; the caller times the steps and applies the settings.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// temp files of the CPU/SoC thermal zones under root, or of every zone if none is recognizably a CPU one
+std::vector<std::string> find_thermal_zones(const std::string& root = "/sys/class/thermal");
+
+// Highest temperature in degrees Celsius over zone_paths, or 0 if none can be read
+float read_soc_temperature(const std::vector<std::string>& zone_paths);
+
+struct GovernorConfig {
+    int max_threads = 4;             // Decode threads at level 0
+    int min_threads = 1;
+    int max_batch = 512;             // Prefill chunk at level 0
+    int min_batch = 64;
+    int max_level = 3;
+    int window_steps = 16;           // Steps averaged per evaluation
+    float slow_ratio = 1.3f;         // Window this much slower than the best one at the level: throttling
+    float pace_ratio = 1.1f;         // Paced step interval relative to the best window at the level
+    float hot_celsius = 75.0f;
+    float cool_celsius = 68.0f;      // Below this a level may come down
+    int calm_windows = 4;            // Calm windows before stepping down, doubled per step up (capped)
+    int max_calm_windows = 64;
+    int64_t thermal_period_us = 1000000;
+    int64_t idle_cool_us = 30000000; // Idle time that takes one level off between generations
+    std::string thermal_root = "/sys/class/thermal";
+};
+
+class DecodeGovernor {
+public:
+    explicit DecodeGovernor(const GovernorConfig& config);
+
+    // Start of a generation at now_us: refresh the temperature and relax for the idle time since the
+    // last one. Returns true if the level changed.
+    bool begin(int64_t now_us);
+
+    // A decode step that took step_us ended at now_us. Returns true if the level changed.
+    bool on_step(int64_t step_us, int64_t now_us);
+
+    // Pause before the next step for a step that took step_us, 0 when not pacing
+    int64_t pause_us(int64_t step_us) const;
+
+    int level() const { return level_; }
+    int n_threads() const;
+    int n_batch() const;
+    float temperature() const { return temperature_; } // 0 if no sensor could be read
+    bool has_sensor() const { return !zones_.empty(); }
+
+private:
+    void set_level(int level);
+    void refresh_temperature(int64_t now_us);
+
+    GovernorConfig config_;
+    std::vector<std::string> zones_;
+    int level_ = 0;
+    float temperature_ = 0.0f;
+    int64_t last_thermal_us_ = 0;
+    int64_t last_step_us_ = 0;
+
+    int64_t window_sum_us_ = 0;
+    int window_n_ = 0;
+    int64_t best_window_us_ = 0;     // Best window average since the level was entered, 0 until one is seen
+    int n_slow_ = 0;                 // Consecutive slow or hot windows
+    int n_calm_ = 0;                 // Consecutive calm windows
+    int calm_needed_ = 0;
+};
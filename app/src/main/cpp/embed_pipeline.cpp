@@ -0,0 +1,156 @@
+#include "embed_pipeline.h"
+
+#include <chrono>
+
+EmbedPipeline::EmbedPipeline(EmbedFn embed, ResultFn on_result, ProgressFn on_progress, int max_batch, int coalesce_ms,
+                             std::function<void()> thread_start, std::function<void()> thread_stop)
+    : embed_(std::move(embed)),
+      on_result_(std::move(on_result)),
+      on_progress_(std::move(on_progress)),
+      max_batch_(max_batch > 0 ? max_batch : 1),
+      coalesce_ms_(coalesce_ms),
+      thread_start_(std::move(thread_start)),
+      thread_stop_(std::move(thread_stop)) {
+    worker_ = std::thread(&EmbedPipeline::run, this);
+}
+
+EmbedPipeline::~EmbedPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        preempt_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+void EmbedPipeline::enqueue(const std::string& id, const std::string& text, int64_t version) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto flight = in_flight_.find(id);
+        if (flight != in_flight_.end()) flight->second = true;
+
+        auto it = jobs_.find(id);
+        if (it != jobs_.end()) {
+            it->second = {text, version};
+        } else {
+            jobs_.emplace(id, Job{text, version});
+            order_.push_back(id);
+        }
+    }
+    cv_.notify_all();
+}
+
+bool EmbedPipeline::cancel(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool found = jobs_.erase(id) > 0;
+    auto flight = in_flight_.find(id);
+    if (flight != in_flight_.end()) {
+        flight->second = true;
+        found = true;
+    }
+    return found;
+}
+
+void EmbedPipeline::pause() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    n_paused_++;
+    preempt_ = true;
+}
+
+void EmbedPipeline::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (n_paused_ > 0) n_paused_--;
+        if (n_paused_ == 0 && !stopping_) preempt_ = false;
+    }
+    cv_.notify_all();
+}
+
+// Called with the lock held; releases it around the callback
+void EmbedPipeline::report_progress(std::unique_lock<std::mutex>& lock) {
+    const int done = n_done_;
+    const int total = n_done_ + (int) jobs_.size() + (int) in_flight_.size();
+    if (done == total) n_done_ = 0;
+
+    lock.unlock();
+    if (on_progress_) on_progress_(done, total);
+    lock.lock();
+}
+
+void EmbedPipeline::run() {
+    if (thread_start_) thread_start_();
+
+    const std::function<bool()> should_abort = [this] { return preempt_.load(); };
+    std::vector<std::string> ids;
+    std::vector<std::string> texts;
+    std::vector<int64_t> versions;
+    std::vector<float> vectors;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || (!jobs_.empty() && n_paused_ == 0); });
+        if (stopping_) break;
+
+        // Let a burst of saves settle so superseded edits are never embedded
+        if (cv_.wait_for(lock, std::chrono::milliseconds(coalesce_ms_), [this] { return stopping_; })) break;
+        if (n_paused_ > 0 || jobs_.empty()) continue;
+
+        ids.clear();
+        texts.clear();
+        versions.clear();
+        while (!order_.empty() && (int) ids.size() < max_batch_) {
+            std::string id = std::move(order_.front());
+            order_.pop_front();
+            auto it = jobs_.find(id);
+            if (it == jobs_.end()) continue; // Cancelled, or an older entry for a re-queued id
+
+            texts.push_back(std::move(it->second.text));
+            versions.push_back(it->second.version);
+            jobs_.erase(it);
+            in_flight_[id] = false;
+            ids.push_back(std::move(id));
+        }
+        if (ids.empty()) continue;
+
+        lock.unlock();
+        int dim = 0;
+        const bool ok = embed_(texts, should_abort, vectors, dim);
+        lock.lock();
+
+        if (!ok && preempt_ && !stopping_) {
+            // Yielded to interactive work: put the batch back in front, unless it was superseded
+            for (size_t i = ids.size(); i-- > 0;) {
+                auto flight = in_flight_.find(ids[i]);
+                const bool superseded = flight->second;
+                in_flight_.erase(flight);
+                if (!superseded) {
+                    jobs_.emplace(ids[i], Job{std::move(texts[i]), versions[i]});
+                    order_.push_front(ids[i]);
+                }
+            }
+            continue;
+        }
+
+        std::vector<bool> deliver(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            auto flight = in_flight_.find(ids[i]);
+            deliver[i] = !flight->second;
+            in_flight_.erase(flight);
+        }
+        n_done_ += ids.size();
+
+        lock.unlock();
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (!deliver[i] || !on_result_) continue;
+            const bool has_vector = ok && dim > 0 && vectors.size() >= (i + 1) * (size_t) dim;
+            on_result_(ids[i], versions[i], has_vector ? vectors.data() + i * dim : nullptr, has_vector ? dim : 0);
+        }
+        lock.lock();
+        if (stopping_) break;
+        report_progress(lock);
+    }
+    lock.unlock();
+
+    if (thread_stop_) thread_stop_();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Background embedding of notes on a worker thread.
+//
+// Jobs are keyed by note id. Enqueueing an id that is still pending replaces its text, so a burst of
+// edits is embedded once, and a result computed for text that was superseded or cancelled while in
+// flight is dropped. Each job carries the caller's version of the text (e.g. its modification time),
+// handed back with the result so the caller can tell whether its copy has changed since. The worker waits a short coalescing delay, then embeds up to max_batch pending
+// notes per call. Interactive work preempts it: while paused the embed function is told to abort at
+// its next decode boundary, the unfinished batch goes back to the front of the queue and the worker
+// sleeps until the last resume().
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class EmbedPipeline {
+public:
+    // Embed texts into out (texts.size() rows of dim floats). should_abort is polled before every
+    // decode. Returns false on failure or abort.
+    typedef std::function<bool(const std::vector<std::string>& texts, const std::function<bool()>& should_abort,
+                               std::vector<float>& out, int& dim)> EmbedFn;
+    // vec is nullptr if the note could not be embedded; version is the one the text was enqueued with
+    typedef std::function<void(const std::string& id, int64_t version, const float* vec, int dim)> ResultFn;
+    // Notes finished and notes known since the queue was last empty
+    typedef std::function<void(int done, int total)> ProgressFn;
+
+    // All callbacks run on the worker thread, as do thread_start and thread_stop
+    EmbedPipeline(EmbedFn embed, ResultFn on_result, ProgressFn on_progress, int max_batch, int coalesce_ms,
+                  std::function<void()> thread_start, std::function<void()> thread_stop);
+
+    // Drops pending jobs and joins the worker
+    ~EmbedPipeline();
+
+    EmbedPipeline(const EmbedPipeline&) = delete;
+    EmbedPipeline& operator=(const EmbedPipeline&) = delete;
+
+    // Queue id for embedding, replacing any pending text for it
+    void enqueue(const std::string& id, const std::string& text, int64_t version);
+
+    // Drop the pending job for id and discard an in-flight result. Returns false if id is unknown.
+    bool cancel(const std::string& id);
+
+    // Nestable. The worker yields at its next decode boundary until the matching resume().
+    void pause();
+    void resume();
+
+    // Pauses a pipeline (if any) for its lifetime
+    class PauseScope {
+    public:
+        explicit PauseScope(EmbedPipeline* pipeline) : pipeline_(pipeline) { if (pipeline_) pipeline_->pause(); }
+        ~PauseScope() { if (pipeline_) pipeline_->resume(); }
+        PauseScope(const PauseScope&) = delete;
+        PauseScope& operator=(const PauseScope&) = delete;
+    private:
+        EmbedPipeline* pipeline_;
+    };
+
+private:
+    struct Job {
+        std::string text;
+        int64_t version;
+    };
+
+    void run();
+    void report_progress(std::unique_lock<std::mutex>& lock);
+
+    EmbedFn embed_;
+    ResultFn on_result_;
+    ProgressFn on_progress_;
+    int max_batch_;
+    int coalesce_ms_;
+    std::function<void()> thread_start_;
+    std::function<void()> thread_stop_;
+
+    std::mutex mutex_; // Guards everything below except preempt_
+    std::condition_variable cv_;
+    std::deque<std::string> order_;                     // Ids in arrival order; may hold ids no longer in jobs_
+    std::unordered_map<std::string, Job> jobs_;         // Latest text per pending id
+    std::unordered_map<std::string, bool> in_flight_;   // Ids being embedded -> superseded since
+    int n_done_ = 0;
+    int n_paused_ = 0;
+    bool stopping_ = false;
+    std::atomic<bool> preempt_{false};
+
+    std::thread worker_;
+};
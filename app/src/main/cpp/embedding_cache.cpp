@@ -0,0 +1,248 @@
+#include "embedding_cache.h"
+
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+const char CACHE_MAGIC[4] = {'S', 'N', 'E', 'C'};
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t reserved;
+    uint64_t model_id;
+};
+
+uint64_t fnv1a(const std::string& text, uint64_t basis) {
+    uint64_t hash = basis;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+} // namespace
+
+std::vector<std::pair<int, int>> split_chunks(const std::string& text, size_t min_bytes, size_t max_bytes) {
+    std::vector<std::pair<int, int>> spans;
+    size_t start = std::string::npos;
+    size_t end = 0;
+    auto close_chunk = [&]() {
+        if (start == std::string::npos) return;
+        spans.emplace_back((int) start, (int) end);
+        start = std::string::npos;
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        size_t b = pos;
+        size_t e = eol;
+        while (b < e && is_blank(text[b])) b++;
+        while (e > b && is_blank(text[e - 1])) e--;
+
+        if (b == e) {
+            // Paragraph break
+            if (start != std::string::npos && end - start >= min_bytes) close_chunk();
+        } else {
+            if (start != std::string::npos && e - start > max_bytes) close_chunk();
+            if (start == std::string::npos) start = b;
+            end = e;
+        }
+        pos = eol + 1;
+    }
+    close_chunk();
+    return spans;
+}
+
+EmbeddingCache::EmbeddingCache(const std::string& path, uint64_t model_id, int dim, size_t capacity)
+    : path_(path), model_id_(model_id), dim_(dim), capacity_(capacity) {
+    if (path_.empty()) return;
+    if (load()) {
+        log_ = fopen(path_.c_str(), "ab");
+    } else {
+        start_log();
+    }
+}
+
+EmbeddingCache::~EmbeddingCache() {
+    if (log_) fclose(log_);
+}
+
+EmbeddingCache::Key EmbeddingCache::key_of(const std::string& chunk) {
+    // Two FNV-1a passes with different offset bases; the text itself is not kept
+    return {fnv1a(chunk, 1469598103934665603ULL), fnv1a(chunk, 0x9e3779b97f4a7c15ULL)};
+}
+
+bool EmbeddingCache::load() {
+    FILE* f = fopen(path_.c_str(), "rb");
+    if (!f) return false;
+
+    CacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+                 memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                 header.version == CACHE_VERSION && header.dim == (uint32_t) dim_ && header.model_id == model_id_;
+    if (valid) {
+        // Later records are more recent, so replaying the log in order rebuilds the LRU order
+        Key key;
+        std::vector<float> vec(dim_);
+        while (fread(&key, sizeof(key), 1, f) == 1 && fread(vec.data(), sizeof(float), dim_, f) == (size_t) dim_) {
+            insert(key, vec.data());
+            n_logged_++;
+        }
+    }
+    fclose(f);
+
+    // A torn record at the end would misalign every record appended after it
+    if (valid && truncate(path_.c_str(), sizeof(CacheHeader) + n_logged_ * (sizeof(Key) + dim_ * sizeof(float))) != 0) {
+        valid = false;
+    }
+    if (!valid) {
+        lru_.clear();
+        index_.clear();
+        n_logged_ = 0;
+    }
+    return valid;
+}
+
+// Rewrite the log with the header and the live entries, oldest first
+bool EmbeddingCache::start_log() {
+    if (log_) {
+        fclose(log_);
+        log_ = nullptr;
+    }
+
+    const std::string tmp_path = path_ + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+
+    CacheHeader header = {};
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.dim = dim_;
+    header.model_id = model_id_;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (auto it = lru_.rbegin(); ok && it != lru_.rend(); ++it) {
+        ok = fwrite(&it->key, sizeof(Key), 1, f) == 1 && fwrite(it->vec.data(), sizeof(float), dim_, f) == (size_t) dim_;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    n_logged_ = lru_.size();
+    log_ = fopen(path_.c_str(), "ab");
+    return log_ != nullptr;
+}
+
+void EmbeddingCache::insert(const Key& key, const float* vec) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        lru_.front().vec.assign(vec, vec + dim_);
+        return;
+    }
+
+    lru_.push_front({key, std::vector<float>(vec, vec + dim_)});
+    index_[key] = lru_.begin();
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+void EmbeddingCache::append(const Key& key, const float* vec) {
+    if (!log_) return;
+    bool ok = fwrite(&key, sizeof(Key), 1, log_) == 1 && fwrite(vec, sizeof(float), dim_, log_) == (size_t) dim_;
+    if (!ok) {
+        // Keep the file consistent: rewrite it from memory, or give up on persisting
+        if (!start_log()) return;
+    } else {
+        n_logged_++;
+    }
+    if (n_logged_ > 2 * capacity_) start_log();
+}
+
+const float* EmbeddingCache::find(const std::string& chunk) {
+    auto it = index_.find(key_of(chunk));
+    if (it == index_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return lru_.front().vec.data();
+}
+
+void EmbeddingCache::put(const std::string& chunk, const float* vec) {
+    const Key key = key_of(chunk);
+    insert(key, vec);
+    append(key, vec);
+}
+
+void EmbeddingCache::flush() {
+    if (log_) fflush(log_);
+}
+
+bool embed_texts_cached(llama_context* ctx, const llama_model* model, EmbeddingCache& cache,
+                        const std::vector<std::string>& texts, std::vector<float>& output,
+                        const std::function<bool()>& should_abort, EmbedStats* stats, int* n_cached) {
+    const int n_embd = cache.dim();
+    output.assign(texts.size() * n_embd, 0.0f);
+    if (n_cached) *n_cached = 0;
+
+    // Chunk vectors per text; cached ones are copied right away since put() may evict them
+    std::vector<std::vector<std::pair<int, int>>> spans(texts.size());
+    std::vector<std::vector<float>> windows(texts.size());
+    std::vector<std::string> missing;
+    std::unordered_map<std::string, int> missing_index;   // Chunk text -> row in missing
+    std::vector<std::pair<float*, int>> missing_targets; // Window slot -> row in missing
+    for (size_t t = 0; t < texts.size(); t++) {
+        spans[t] = split_chunks(texts[t]);
+        windows[t].resize(spans[t].size() * n_embd);
+        for (size_t c = 0; c < spans[t].size(); c++) {
+            std::string chunk = texts[t].substr(spans[t][c].first, spans[t][c].second - spans[t][c].first);
+            float* slot = windows[t].data() + c * n_embd;
+            if (const float* vec = cache.find(chunk)) {
+                memcpy(slot, vec, n_embd * sizeof(float));
+                if (n_cached) (*n_cached)++;
+                continue;
+            }
+            auto found = missing_index.find(chunk);
+            int row = found != missing_index.end() ? found->second : (int) missing.size();
+            if (found == missing_index.end()) {
+                missing_index.emplace(chunk, row);
+                missing.push_back(std::move(chunk));
+            }
+            missing_targets.emplace_back(slot, row);
+        }
+    }
+
+    if (!missing.empty()) {
+        std::vector<float> embedded;
+        if (!embed_texts(ctx, model, missing, embedded, should_abort, stats)) return false;
+        for (size_t i = 0; i < missing.size(); i++) {
+            cache.put(missing[i], embedded.data() + i * n_embd);
+        }
+        cache.flush();
+        for (const auto& target : missing_targets) {
+            memcpy(target.first, embedded.data() + (size_t) target.second * n_embd, n_embd * sizeof(float));
+        }
+    }
+
+    for (size_t t = 0; t < texts.size(); t++) {
+        if (spans[t].empty()) continue;
+        pool_windows(spans[t], windows[t], n_embd, true, output.data() + t * n_embd);
+    }
+    return true;
+}
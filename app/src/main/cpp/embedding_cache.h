@@ -0,0 +1,102 @@
+#pragma once
+
+// Content-addressed cache of chunk embeddings.
+//
+// Notes are split into chunks at paragraph boundaries and each chunk's vector is cached under a
+// 128-bit hash of its text, in one cache per embedding model. Re-embedding an edited note then only
+// decodes the chunks whose text changed; the note vector is pooled from all of them. Boundaries
+// depend only on the text around them, so an edit moves at most the chunks next to it.
+//
+// The cache file is an append-only log of fixed-size records (key + float32 vector) behind a small
+// header; a torn record at the end is ignored on open, and the log is rewritten once it holds twice
+// as many records as the cache keeps. Not thread-safe: callers serialize access.
+
+#include "inference.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A chunk is closed at the first blank line after it reaches the minimum size, or before a line
+// that would take it past the maximum. Longer single lines stay one chunk and are windowed.
+const size_t EMBED_CHUNK_MIN_BYTES = 400;
+const size_t EMBED_CHUNK_MAX_BYTES = 1600;
+
+// [start, end) byte ranges of the chunks of text, trimmed of surrounding whitespace. Empty for text
+// without any non-blank line.
+std::vector<std::pair<int, int>> split_chunks(const std::string& text, size_t min_bytes = EMBED_CHUNK_MIN_BYTES,
+                                              size_t max_bytes = EMBED_CHUNK_MAX_BYTES);
+
+class EmbeddingCache {
+public:
+    // Load path if it holds a cache for model_id and dim, otherwise start it afresh. An empty path
+    // (or a file that cannot be written) keeps the cache in memory only. capacity bounds the number
+    // of vectors held; the least recently used are dropped first.
+    EmbeddingCache(const std::string& path, uint64_t model_id, int dim, size_t capacity);
+    ~EmbeddingCache();
+
+    EmbeddingCache(const EmbeddingCache&) = delete;
+    EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+    // Vector cached for chunk, or nullptr. Valid until the next put().
+    const float* find(const std::string& chunk);
+
+    // Cache vec (dim floats) for chunk and append it to the log
+    void put(const std::string& chunk, const float* vec);
+
+    // Push appended records to the file
+    void flush();
+
+    uint64_t model_id() const { return model_id_; }
+    int dim() const { return dim_; }
+    size_t size() const { return lru_.size(); }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    struct Key {
+        uint64_t a;
+        uint64_t b;
+        bool operator==(const Key& other) const { return a == other.a && b == other.b; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return (size_t) (key.a ^ (key.b * 31)); }
+    };
+    struct Entry {
+        Key key;
+        std::vector<float> vec;
+    };
+
+    static Key key_of(const std::string& chunk);
+    bool load();
+    bool start_log();
+    void insert(const Key& key, const float* vec);
+    void append(const Key& key, const float* vec);
+
+    std::string path_;
+    uint64_t model_id_;
+    int dim_;
+    size_t capacity_;
+    FILE* log_ = nullptr;
+    size_t n_logged_ = 0; // Records in the log, superseded and evicted ones included
+
+    std::list<Entry> lru_; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+// Embed texts like embed_texts, but chunk-wise through cache: chunks found in the cache are not
+// decoded, the rest are embedded in as few decodes as possible and added to it. Each row of output
+// pools the text's chunk vectors weighted by chunk length; rows for blank texts stay zero.
+// n_cached, if set, receives how many chunks came from the cache.
+bool embed_texts_cached(llama_context* ctx, const llama_model* model, EmbeddingCache& cache,
+                        const std::vector<std::string>& texts, std::vector<float>& output,
+                        const std::function<bool()>& should_abort = nullptr, EmbedStats* stats = nullptr,
+                        int* n_cached = nullptr);
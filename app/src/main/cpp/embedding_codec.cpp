@@ -0,0 +1,79 @@
+#include "embedding_codec.h"
+#include "vector_kernels.h"
+
+#include <cstring>
+
+size_t encoded_size(EmbedEncoding encoding, int dims) {
+    switch (encoding) {
+        case EMBED_ENCODING_I8:
+            return sizeof(float) + (size_t) dims;
+        case EMBED_ENCODING_BINARY:
+            return (size_t) (dims + 7) / 8;
+        case EMBED_ENCODING_F32:
+        default:
+            return (size_t) dims * sizeof(float);
+    }
+}
+
+int truncated_dims(int n_embd, int dims) {
+    return dims <= 0 || dims >= n_embd ? n_embd : dims;
+}
+
+void truncate_embedding(const float* v, int dims, float* out) {
+    normalize_f32(v, out, dims);
+}
+
+void encode_embedding(const float* v, int dims, EmbedEncoding encoding, uint8_t* out) {
+    switch (encoding) {
+        case EMBED_ENCODING_I8: {
+            const float scale = quantize_i8(v, reinterpret_cast<int8_t*>(out + sizeof(float)), dims);
+            memcpy(out, &scale, sizeof(float));
+            break;
+        }
+        case EMBED_ENCODING_BINARY:
+            binarize_f32(v, out, dims);
+            break;
+        case EMBED_ENCODING_F32:
+        default:
+            memcpy(out, v, (size_t) dims * sizeof(float));
+            break;
+    }
+}
+
+float encoded_similarity(const uint8_t* a, const uint8_t* b, int dims, EmbedEncoding encoding) {
+    switch (encoding) {
+        case EMBED_ENCODING_I8: {
+            float scale_a, scale_b;
+            memcpy(&scale_a, a, sizeof(float));
+            memcpy(&scale_b, b, sizeof(float));
+            const int32_t dot = dot_i8(reinterpret_cast<const int8_t*>(a + sizeof(float)),
+                                       reinterpret_cast<const int8_t*>(b + sizeof(float)), dims);
+            return scale_a * scale_b * (float) dot;
+        }
+        case EMBED_ENCODING_BINARY:
+            // Padding bits of the last byte are zero in both codes
+            return dims > 0 ? 1.0f - 2.0f * (float) hamming_u8(a, b, (dims + 7) / 8) / (float) dims : 0.0f;
+        case EMBED_ENCODING_F32:
+        default: {
+            // Rows in a packed buffer need not be float aligned
+            if (((uintptr_t) a | (uintptr_t) b) % alignof(float) == 0) {
+                return dot_f32(reinterpret_cast<const float*>(a), reinterpret_cast<const float*>(b), dims);
+            }
+            float sum = 0.0f;
+            for (int i = 0; i < dims; i++) {
+                float x, y;
+                memcpy(&x, a + i * sizeof(float), sizeof(float));
+                memcpy(&y, b + i * sizeof(float), sizeof(float));
+                sum += x * y;
+            }
+            return sum;
+        }
+    }
+}
+
+void score_encoded(const uint8_t* query, const uint8_t* rows, size_t n_rows, int dims, EmbedEncoding encoding, float* scores) {
+    const size_t row_size = encoded_size(encoding, dims);
+    for (size_t i = 0; i < n_rows; i++) {
+        scores[i] = encoded_similarity(query, rows + i * row_size, dims, encoding);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Compact encodings of normalized embeddings for storing and scanning a note corpus.
+//
+// Matryoshka-trained models keep most of their quality in a prefix of the vector, so a vector can
+// be truncated to its first dims components and renormalized. The result is then stored as float32,
+// as int8 with one float scale per vector (4x smaller), or as sign bits (32x smaller). Similarity is
+// computed directly on the codes: int8 dot products rescaled, or 1 - 2 * hamming / dims for bits,
+// which ranks like the angle between the vectors and makes a fast prefilter before a float rerank.
+
+#include <cstddef>
+#include <cstdint>
+
+enum EmbedEncoding {
+    EMBED_ENCODING_F32 = 0,
+    EMBED_ENCODING_I8 = 1,
+    EMBED_ENCODING_BINARY = 2,
+};
+
+// Bytes of one encoded vector of dims components
+size_t encoded_size(EmbedEncoding encoding, int dims);
+
+// Components kept when truncating an n_embd vector to dims: all of them for dims <= 0 or >= n_embd
+int truncated_dims(int n_embd, int dims);
+
+// Write the first dims components of v, renormalized, to out (dims floats, may alias v)
+void truncate_embedding(const float* v, int dims, float* out);
+
+// Encode a normalized vector of dims components into encoded_size(encoding, dims) bytes of out.
+// int8 rows are a float scale followed by dims int8 values.
+void encode_embedding(const float* v, int dims, EmbedEncoding encoding, uint8_t* out);
+
+// Cosine similarity, or its estimate, between two encoded vectors
+float encoded_similarity(const uint8_t* a, const uint8_t* b, int dims, EmbedEncoding encoding);
+
+// Score query against n_rows rows packed back to back in rows
+void score_encoded(const uint8_t* query, const uint8_t* rows, size_t n_rows, int dims, EmbedEncoding encoding, float* scores);
@@ -0,0 +1,263 @@
+#include "gguf_inspector.h"
+#include "gguf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Bounds-checked cursor over the mapped file
+struct Reader {
+    const uint8_t* data;
+    uint64_t size;
+    uint64_t pos = 0;
+
+    bool read(void* out, uint64_t n) {
+        if (n > size - pos) return false;
+        memcpy(out, data + pos, n);
+        pos += n;
+        return true;
+    }
+
+    bool skip(uint64_t n) {
+        if (n > size - pos) return false;
+        pos += n;
+        return true;
+    }
+
+    template <typename T>
+    bool read(T& value) { return read(&value, sizeof(T)); }
+
+    bool read_string(std::string* out) {
+        uint64_t n;
+        if (!read(n) || n > size - pos) return false;
+        if (out) out->assign(reinterpret_cast<const char*>(data + pos), n);
+        pos += n;
+        return true;
+    }
+};
+
+// Size of a fixed-size gguf_type, 0 for strings, arrays and unknown types
+uint64_t scalar_size(int type) {
+    switch (type) {
+        case GGUF_TYPE_UINT8: case GGUF_TYPE_INT8: case GGUF_TYPE_BOOL: return 1;
+        case GGUF_TYPE_UINT16: case GGUF_TYPE_INT16: return 2;
+        case GGUF_TYPE_UINT32: case GGUF_TYPE_INT32: case GGUF_TYPE_FLOAT32: return 4;
+        case GGUF_TYPE_UINT64: case GGUF_TYPE_INT64: case GGUF_TYPE_FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+bool is_integer(int type) {
+    return type != GGUF_TYPE_FLOAT32 && type != GGUF_TYPE_FLOAT64 && scalar_size(type) > 0;
+}
+
+// Scalar of type at p as an integer or a float
+void decode_scalar(int type, const uint8_t* p, int64_t& i, double& f) {
+    switch (type) {
+        case GGUF_TYPE_UINT8:  { uint8_t v;  memcpy(&v, p, 1); i = v; break; }
+        case GGUF_TYPE_INT8:   { int8_t v;   memcpy(&v, p, 1); i = v; break; }
+        case GGUF_TYPE_BOOL:   { uint8_t v;  memcpy(&v, p, 1); i = v != 0; break; }
+        case GGUF_TYPE_UINT16: { uint16_t v; memcpy(&v, p, 2); i = v; break; }
+        case GGUF_TYPE_INT16:  { int16_t v;  memcpy(&v, p, 2); i = v; break; }
+        case GGUF_TYPE_UINT32: { uint32_t v; memcpy(&v, p, 4); i = v; break; }
+        case GGUF_TYPE_INT32:  { int32_t v;  memcpy(&v, p, 4); i = v; break; }
+        case GGUF_TYPE_UINT64: { uint64_t v; memcpy(&v, p, 8); i = (int64_t) v; break; }
+        case GGUF_TYPE_INT64:  { int64_t v;  memcpy(&v, p, 8); i = v; break; }
+        case GGUF_TYPE_FLOAT32: { float v;   memcpy(&v, p, 4); f = v; break; }
+        case GGUF_TYPE_FLOAT64: { double v;  memcpy(&v, p, 8); f = v; break; }
+        default: break;
+    }
+}
+
+bool read_value(Reader& r, int type, GgufValue& value) {
+    value.type = type;
+    if (type == GGUF_TYPE_STRING) return r.read_string(&value.str);
+    if (type == GGUF_TYPE_ARRAY) {
+        uint32_t array_type;
+        if (!r.read(array_type) || !r.read(value.array_n)) return false;
+        value.array_type = array_type;
+        if (array_type == GGUF_TYPE_STRING) {
+            for (uint64_t k = 0; k < value.array_n; k++) {
+                if (!r.read_string(nullptr)) return false;
+            }
+            return true;
+        }
+        const uint64_t elem = scalar_size(array_type);
+        if (elem == 0 || value.array_n > (r.size - r.pos) / elem) return false;
+        if (is_integer(array_type) && value.array_n <= GGUF_MAX_KEPT_INTS) {
+            value.ints.resize(value.array_n);
+            double unused;
+            for (uint64_t k = 0; k < value.array_n; k++) decode_scalar(array_type, r.data + r.pos + k * elem, value.ints[k], unused);
+        }
+        return r.skip(value.array_n * elem);
+    }
+    const uint64_t size = scalar_size(type);
+    if (size == 0 || size > r.size - r.pos) return false;
+    decode_scalar(type, r.data + r.pos, value.i, value.f);
+    return r.skip(size);
+}
+
+bool parse(Reader& r, GgufInfo& info) {
+    char magic[4];
+    uint64_t n_tensors, n_kv;
+    if (!r.read(magic, 4) || memcmp(magic, "GGUF", 4) != 0) {
+        info.error = "not a GGUF file";
+        return false;
+    }
+    if (!r.read(info.version) || !r.read(n_tensors) || !r.read(n_kv)) {
+        info.error = "truncated header";
+        return false;
+    }
+    if (info.version < 2 || info.version > 3) {
+        info.error = "unsupported GGUF version " + std::to_string(info.version);
+        return false;
+    }
+    // Every entry takes at least a length-prefixed key or name and a type; bounds implausible counts
+    if (n_kv > r.size / 12 || n_tensors > r.size / 24) {
+        info.error = "corrupt header counts";
+        return false;
+    }
+
+    for (uint64_t k = 0; k < n_kv; k++) {
+        std::string key;
+        uint32_t type;
+        GgufValue value;
+        if (!r.read_string(&key) || !r.read(type) || !read_value(r, type, value)) {
+            info.error = "corrupt metadata entry " + std::to_string(k);
+            return false;
+        }
+        info.kv[key] = std::move(value);
+    }
+    const int64_t alignment = info.get_int("general.alignment", 32);
+    if (alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+        info.error = "invalid alignment";
+        return false;
+    }
+    info.alignment = (uint32_t) alignment;
+
+    // Grown per parsed entry: the count is only loosely bounded, and a corrupt one in a large file
+    // must not allocate gigabytes up front
+    std::unordered_set<std::string> names;
+    for (uint64_t t = 0; t < n_tensors; t++) {
+        info.tensors.emplace_back();
+        GgufTensor& tensor = info.tensors.back();
+        uint32_t n_dims, type;
+        if (!r.read_string(&tensor.name) || !r.read(n_dims) || n_dims == 0 || n_dims > 4) {
+            info.error = "corrupt tensor info " + std::to_string(t);
+            return false;
+        }
+        if (!names.insert(tensor.name).second) {
+            info.error = "duplicate tensor " + tensor.name;
+            return false;
+        }
+        tensor.n_dims = n_dims;
+        uint64_t n_elements = 1;
+        for (uint32_t d = 0; d < n_dims; d++) {
+            if (!r.read(tensor.ne[d]) || tensor.ne[d] < 0 || (tensor.ne[d] > 0 && n_elements > (UINT64_MAX >> 1) / tensor.ne[d])) {
+                info.error = "invalid shape of " + tensor.name;
+                return false;
+            }
+            n_elements *= tensor.ne[d];
+        }
+        if (!r.read(type) || !r.read(tensor.offset)) {
+            info.error = "corrupt tensor info " + tensor.name;
+            return false;
+        }
+        // Retired quantization types have no size
+        if (type >= GGML_TYPE_COUNT || ggml_type_size((ggml_type) type) == 0 ||
+            tensor.ne[0] % ggml_blck_size((ggml_type) type) != 0) {
+            info.error = "unsupported type " + std::to_string(type) + " of " + tensor.name;
+            return false;
+        }
+        tensor.type = (ggml_type) type;
+        // An overflowed size could pass the overlap and truncation checks below
+        const uint64_t row_bytes = ggml_row_size(tensor.type, tensor.ne[0]);
+        const uint64_t n_rows = (uint64_t) tensor.ne[1] * (uint64_t) tensor.ne[2] * (uint64_t) tensor.ne[3];
+        if (n_rows > 0 && row_bytes > UINT64_MAX / n_rows) {
+            info.error = "invalid size of " + tensor.name;
+            return false;
+        }
+        tensor.bytes = row_bytes * n_rows;
+        if (tensor.offset % info.alignment != 0) {
+            info.error = "misaligned data of " + tensor.name;
+            return false;
+        }
+    }
+
+    info.data_offset = (r.pos + info.alignment - 1) / info.alignment * info.alignment;
+
+    // Tensor data must not overlap and must lie inside the file, which catches truncated downloads
+    std::vector<const GgufTensor*> by_offset;
+    for (const GgufTensor& tensor : info.tensors) by_offset.push_back(&tensor);
+    std::sort(by_offset.begin(), by_offset.end(), [](const GgufTensor* a, const GgufTensor* b) { return a->offset < b->offset; });
+    const uint64_t data_bytes = info.data_offset <= info.file_bytes ? info.file_bytes - info.data_offset : 0;
+    uint64_t end = 0;
+    for (const GgufTensor* tensor : by_offset) {
+        if (tensor->offset < end) {
+            info.error = "overlapping data of " + tensor->name;
+            return false;
+        }
+        if (tensor->offset > data_bytes || tensor->bytes > data_bytes - tensor->offset) {
+            info.error = "file truncated: " + tensor->name + " ends past the end of the file";
+            return false;
+        }
+        end = tensor->offset + tensor->bytes;
+    }
+    return true;
+}
+
+} // namespace
+
+int64_t GgufInfo::get_int(const std::string& key, int64_t fallback) const {
+    auto it = kv.find(key);
+    return it != kv.end() && is_integer(it->second.type) ? it->second.i : fallback;
+}
+
+int64_t GgufInfo::get_layer_int(const std::string& key, int layer, int64_t fallback) const {
+    auto it = kv.find(key);
+    if (it == kv.end() || it->second.type != GGUF_TYPE_ARRAY) return get_int(key, fallback);
+    const std::vector<int64_t>& values = it->second.ints;
+    return layer >= 0 && (size_t) layer < values.size() ? values[layer] : fallback;
+}
+
+std::string GgufInfo::get_string(const std::string& key) const {
+    auto it = kv.find(key);
+    return it != kv.end() && it->second.type == GGUF_TYPE_STRING ? it->second.str : "";
+}
+
+uint64_t GgufInfo::array_length(const std::string& key) const {
+    auto it = kv.find(key);
+    return it != kv.end() && it->second.type == GGUF_TYPE_ARRAY ? it->second.array_n : 0;
+}
+
+bool inspect_gguf(const std::string& path, GgufInfo& info) {
+    info = GgufInfo();
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        info.error = "cannot open file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        info.error = "empty file";
+        return false;
+    }
+    info.file_bytes = (uint64_t) st.st_size;
+    void* map = mmap(nullptr, info.file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        info.error = "cannot map file";
+        return false;
+    }
+    Reader reader = {static_cast<const uint8_t*>(map), info.file_bytes};
+    const bool ok = parse(reader, info);
+    munmap(map, info.file_bytes);
+    return ok;
+}
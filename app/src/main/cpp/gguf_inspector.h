@@ -0,0 +1,62 @@
+#pragma once
+
+// GGUF header and tensor index reader for inspecting a model file without loading it.
+//
+// The file is memory-mapped and only its header is touched: metadata, tensor names, shapes, types
+// and offsets. Large metadata arrays (the tokenizer vocabulary) are stepped over, not copied, so
+// inspecting a multi-GB model takes milliseconds. The structure is validated on the way: every read
+// in bounds, known tensor types, aligned and non-overlapping tensor data that fits in the file. That
+// catches truncated downloads and corrupted headers before a multi-second load, though not flipped
+// bits inside the tensor data.
+
+#include "ggml.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct GgufTensor {
+    std::string name;
+    ggml_type type = GGML_TYPE_F32;
+    int n_dims = 0;
+    int64_t ne[4] = {1, 1, 1, 1};
+    uint64_t offset = 0; // From the start of the data section
+    uint64_t bytes = 0;
+};
+
+// One metadata value. Arrays keep their element type and length; integer arrays of up to
+// GGUF_MAX_KEPT_INTS elements (per-layer hyperparameters) also keep their values.
+struct GgufValue {
+    int type = 0;        // gguf_type
+    int64_t i = 0;       // Integer and bool values
+    double f = 0.0;      // Float values
+    std::string str;
+    int array_type = 0;
+    uint64_t array_n = 0;
+    std::vector<int64_t> ints;
+};
+
+const uint64_t GGUF_MAX_KEPT_INTS = 4096;
+
+struct GgufInfo {
+    std::string error;   // Why the file was rejected, empty if it is valid
+    uint32_t version = 0;
+    uint64_t file_bytes = 0;
+    uint64_t data_offset = 0;
+    uint32_t alignment = 32;
+    std::unordered_map<std::string, GgufValue> kv;
+    std::vector<GgufTensor> tensors;
+
+    // Integer value of key, or fallback if it is missing or not an integer
+    int64_t get_int(const std::string& key, int64_t fallback) const;
+    // Element layer of a per-layer integer array, or the scalar value of key for every layer
+    int64_t get_layer_int(const std::string& key, int layer, int64_t fallback) const;
+    std::string get_string(const std::string& key) const;
+    // Element count of an array value, 0 if key is not an array
+    uint64_t array_length(const std::string& key) const;
+};
+
+// Parse and validate the GGUF file at path. Returns false with info.error set if it cannot be read
+// or is malformed.
+bool inspect_gguf(const std::string& path, GgufInfo& info);
@@ -0,0 +1,301 @@
+#include "inference.h"
+#include "trace.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+void batch_add(llama_batch& batch, llama_token id, llama_pos pos, int32_t seq_id, bool logits) {
+    batch.token[batch.n_tokens] = id;
+    batch.pos[batch.n_tokens] = pos;
+    batch.n_seq_id[batch.n_tokens] = 1;
+    batch.seq_id[batch.n_tokens][0] = seq_id;
+    batch.logits[batch.n_tokens] = logits ? 1 : 0;
+    batch.n_tokens++;
+}
+
+llama_context_params embedding_context_params() {
+    llama_context_params params = llama_context_default_params();
+    params.embeddings = true;
+    params.n_ctx = 2048;
+    params.n_batch = 512;
+    params.n_ubatch = 512;
+    params.n_seq_max = 16;     // Texts packed into one decode by embed_texts
+    params.kv_unified = true;  // Let each sequence use the whole context instead of n_ctx / n_seq_max
+    return params;
+}
+
+std::vector<llama_token> tokenize_text(const llama_vocab* vocab, const char* text, int32_t text_len, bool add_special) {
+    std::vector<llama_token> tokens(text_len + 100);
+    int n_tokens = llama_tokenize(vocab, text, text_len, tokens.data(), tokens.size(), add_special, true);
+    if (n_tokens < 0) {
+        tokens.resize(-n_tokens);
+        n_tokens = llama_tokenize(vocab, text, text_len, tokens.data(), tokens.size(), add_special, true);
+    }
+    tokens.resize(n_tokens > 0 ? n_tokens : 0);
+    return tokens;
+}
+
+void normalize_embedding(const float* embd, float* out, int n_embd) {
+    normalize_f32(embd, out, n_embd);
+}
+
+uint64_t compute_model_hash(const char* path) {
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](const unsigned char* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    mix(reinterpret_cast<const unsigned char*>(&file_size), sizeof(file_size));
+
+    std::vector<unsigned char> buf(1 << 20);
+    size_t n = fread(buf.data(), 1, buf.size(), f);
+    mix(buf.data(), n);
+    fclose(f);
+    return hash;
+}
+
+int kv_cells_used(llama_context* ctx) {
+    llama_memory_t mem = llama_get_memory(ctx);
+    const int n_seq = llama_n_seq_max(ctx);
+    int used = 0;
+    for (int seq = 0; seq < n_seq; seq++) {
+        used += llama_memory_seq_pos_max(mem, seq) + 1;
+    }
+    return used;
+}
+
+int trim_prompt(std::vector<llama_token>& tokens, int& n_keep, int n_max) {
+    const int n_tokens = tokens.size();
+    if (n_tokens <= n_max || n_max <= 0) return 0;
+
+    // A pinned part that leaves no room for the prompt itself is not worth keeping whole
+    n_keep = std::min(n_keep, n_max / 2);
+    const int n_drop = n_tokens - n_max;
+    tokens.erase(tokens.begin() + n_keep, tokens.begin() + n_keep + n_drop);
+    return n_drop;
+}
+
+bool kv_shift_discard(llama_context* ctx, llama_seq_id seq, int n_keep, int n_discard, std::vector<llama_token>& tokens) {
+    const int n_past = tokens.size();
+    if (n_keep < 0 || n_discard <= 0 || n_keep + n_discard > n_past) return false;
+
+    llama_memory_t mem = llama_get_memory(ctx);
+    if (!llama_memory_can_shift(mem)) return false;
+    if (!llama_memory_seq_rm(mem, seq, n_keep, n_keep + n_discard)) return false;
+    llama_memory_seq_add(mem, seq, n_keep + n_discard, n_past, -n_discard);
+    tokens.erase(tokens.begin() + n_keep, tokens.begin() + n_keep + n_discard);
+    return true;
+}
+
+bool embed_sequences(llama_context* ctx, const llama_model* model, const std::vector<std::vector<llama_token>>& inputs, std::vector<float>& output,
+                     const std::function<bool()>& should_abort, EmbedStats* stats) {
+    const int32_t n_embd = llama_model_n_embd(model);
+    const int32_t n_batch = llama_n_batch(ctx);
+    const int32_t n_seq_max = llama_n_seq_max(ctx);
+    const enum llama_pooling_type pooling = llama_pooling_type(ctx);
+
+    output.assign(inputs.size() * n_embd, 0.0f);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    std::vector<int> batch_inputs; // input index for each seq_id in the current batch
+    std::vector<int> last_index;   // batch position of each sequence's last token
+
+    auto flush = [&]() -> bool {
+        if (batch_inputs.empty()) return true;
+        if (should_abort && should_abort()) return false;
+
+        llama_memory_seq_rm(llama_get_memory(ctx), -1, -1, -1);
+        {
+            TraceSpan span("embed_decode", "embed");
+            span.arg("tokens", batch.n_tokens);
+            if (llama_decode(ctx, batch) != 0) return false;
+        }
+        if (stats) {
+            stats->n_tokens += batch.n_tokens;
+            stats->n_decodes++;
+        }
+
+        for (size_t s = 0; s < batch_inputs.size(); s++) {
+            const float* embd = pooling == LLAMA_POOLING_TYPE_NONE
+                    ? llama_get_embeddings_ith(ctx, last_index[s])
+                    : llama_get_embeddings_seq(ctx, s);
+            if (embd) {
+                normalize_embedding(embd, output.data() + (size_t) batch_inputs[s] * n_embd, n_embd);
+            }
+        }
+
+        batch.n_tokens = 0;
+        batch_inputs.clear();
+        last_index.clear();
+        return true;
+    };
+
+    bool ok = true;
+    for (size_t i = 0; i < inputs.size() && ok; i++) {
+        const std::vector<llama_token>& tokens = inputs[i];
+        if (tokens.empty()) continue;
+
+        if (batch.n_tokens + (int32_t) tokens.size() > n_batch || (int32_t) batch_inputs.size() >= n_seq_max) {
+            ok = flush();
+            if (!ok) break;
+        }
+
+        const int32_t seq_id = batch_inputs.size();
+        for (size_t j = 0; j < tokens.size(); j++) {
+            batch_add(batch, tokens[j], j, seq_id, j == tokens.size() - 1);
+        }
+        batch_inputs.push_back(i);
+        last_index.push_back(batch.n_tokens - 1);
+    }
+
+    if (ok) ok = flush();
+    llama_batch_free(batch);
+    return ok;
+}
+
+bool embed_windows(llama_context* ctx, const llama_model* model, const std::vector<llama_token>& tokens,
+                   int window, int overlap, std::vector<std::pair<int, int>>& spans, std::vector<float>& output,
+                   const std::function<bool()>& should_abort, EmbedStats* stats) {
+    const struct llama_vocab * vocab = llama_model_get_vocab(model);
+    const bool add_bos = llama_vocab_get_add_bos(vocab);
+    const bool add_eos = llama_vocab_get_add_eos(vocab);
+    const int n_special = (add_bos ? 1 : 0) + (add_eos ? 1 : 0);
+
+    const int max_window = (int) llama_n_ubatch(ctx) - n_special;
+    if (window <= 0 || window > max_window) window = max_window;
+    if (overlap < 0) overlap = 0;
+    if (overlap > window / 2) overlap = window / 2;
+    const int stride = window - overlap;
+
+    spans.clear();
+    std::vector<std::vector<llama_token>> inputs;
+    const int n_tokens = tokens.size();
+    for (int start = 0; start < n_tokens; start += stride) {
+        const int end = start + window < n_tokens ? start + window : n_tokens;
+        std::vector<llama_token> input;
+        input.reserve(end - start + n_special);
+        if (add_bos) input.push_back(llama_vocab_bos(vocab));
+        input.insert(input.end(), tokens.begin() + start, tokens.begin() + end);
+        if (add_eos) input.push_back(llama_vocab_eos(vocab));
+        inputs.push_back(std::move(input));
+        spans.emplace_back(start, end);
+        if (end == n_tokens) break;
+    }
+
+    return embed_sequences(ctx, model, inputs, output, should_abort, stats);
+}
+
+void pool_windows(const std::vector<std::pair<int, int>>& spans, const std::vector<float>& windows,
+                  int n_embd, bool weighted, float* out) {
+    std::vector<float> sum(n_embd, 0.0f);
+    for (size_t w = 0; w < spans.size(); w++) {
+        const float weight = weighted ? (float) (spans[w].second - spans[w].first) : 1.0f;
+        const float* v = windows.data() + w * n_embd;
+        for (int i = 0; i < n_embd; i++) sum[i] += weight * v[i];
+    }
+    normalize_embedding(sum.data(), out, n_embd);
+}
+
+bool embed_texts(llama_context* ctx, const llama_model* model, const std::vector<std::string>& texts, std::vector<float>& output,
+                 const std::function<bool()>& should_abort, EmbedStats* stats) {
+    const struct llama_vocab * vocab = llama_model_get_vocab(model);
+    const int32_t n_ubatch = llama_n_ubatch(ctx);
+    const int32_t n_embd = llama_model_n_embd(model);
+
+    std::vector<std::vector<llama_token>> inputs(texts.size());
+    std::vector<std::pair<int, std::vector<llama_token>>> long_inputs;
+    for (size_t i = 0; i < texts.size(); i++) {
+        inputs[i] = tokenize_text(vocab, texts[i].c_str(), texts[i].size());
+
+        // A sequence cannot be split across micro-batches for pooled embeddings
+        if ((int32_t) inputs[i].size() > n_ubatch) {
+            long_inputs.emplace_back(i, tokenize_text(vocab, texts[i].c_str(), texts[i].size(), false));
+            inputs[i].clear();
+        }
+    }
+
+    if (!embed_sequences(ctx, model, inputs, output, should_abort, stats)) return false;
+
+    for (const auto& long_input : long_inputs) {
+        std::vector<std::pair<int, int>> spans;
+        std::vector<float> windows;
+        if (!embed_windows(ctx, model, long_input.second, 0, DEFAULT_EMBED_OVERLAP, spans, windows, should_abort, stats)) return false;
+        pool_windows(spans, windows, n_embd, true, output.data() + (size_t) long_input.first * n_embd);
+    }
+    return true;
+}
+
+std::vector<llama_token> bench_tokens(const llama_vocab* vocab, int n_tokens) {
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    std::vector<llama_token> tokens(n_tokens > 0 ? n_tokens : 0);
+    for (int i = 0; i < n_tokens; i++) tokens[i] = (llama_token) ((1000 + 7919LL * i) % n_vocab);
+    return tokens;
+}
+
+namespace {
+
+llama_token argmax_token(const float* logits, int n_vocab) {
+    return (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+}
+
+} // namespace
+
+bool bench_generation(llama_context* ctx, const llama_model* model, const std::vector<llama_token>& prompt, int n_gen,
+                      GenerationBench& result) {
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+    const int n_prompt = std::min({(int) prompt.size(), (int) llama_n_batch(ctx), (int) llama_n_ctx(ctx) - n_gen - 1});
+    if (n_prompt <= 0 || n_gen < 0) return false;
+
+    llama_memory_t mem = llama_get_memory(ctx);
+    llama_memory_seq_rm(mem, -1, -1, -1);
+    llama_batch batch = llama_batch_init(n_prompt, 0, 1);
+    auto decode = [&]() -> bool {
+        if (llama_decode(ctx, batch) != 0) return false;
+        llama_synchronize(ctx);
+        return true;
+    };
+
+    batch.n_tokens = 0;
+    batch_add(batch, prompt[0], 0, 0, true);
+    bool ok = decode();
+    llama_memory_seq_rm(mem, 0, -1, -1);
+
+    batch.n_tokens = 0;
+    for (int i = 0; i < n_prompt; i++) {
+        batch_add(batch, prompt[i], i, 0, i == n_prompt - 1);
+    }
+    const int64_t t_start = monotonic_us();
+    ok = ok && decode();
+    llama_token token = ok ? argmax_token(llama_get_logits_ith(ctx, -1), n_vocab) : 0;
+    const int64_t t_first = monotonic_us();
+
+    int n_decoded = 0;
+    for (; n_decoded < n_gen && ok; n_decoded++) {
+        batch.n_tokens = 0;
+        batch_add(batch, token, n_prompt + n_decoded, 0, true);
+        ok = decode();
+        if (ok) token = argmax_token(llama_get_logits_ith(ctx, -1), n_vocab);
+    }
+    const int64_t t_end = monotonic_us();
+
+    llama_memory_seq_rm(mem, -1, -1, -1);
+    llama_batch_free(batch);
+    if (!ok) return false;
+
+    result.n_prompt = n_prompt;
+    result.n_gen = n_decoded;
+    result.ttft_ms = (t_first - t_start) / 1000.0;
+    result.prefill_tps = n_prompt * 1e6 / std::max<int64_t>(t_first - t_start, 1);
+    result.decode_tps = n_decoded * 1e6 / std::max<int64_t>(t_end - t_first, 1);
+    return true;
+}
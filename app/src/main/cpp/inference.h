@@ -0,0 +1,96 @@
+#pragma once
+
+// Platform-neutral inference helpers on top of llama.cpp: tokenization, batched embedding and a
+// fixed generation benchmark. No JNI or Android dependencies, so they also build into the host
+// benchmark (bench/). Callers own the contexts and any locking around them.
+
+#include "llama.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Token overlap between consecutive windows when the caller does not choose one
+const int DEFAULT_EMBED_OVERLAP = 64;
+
+// Work done by the embed calls below, accumulated into when the caller passes one
+struct EmbedStats {
+    int n_tokens = 0;
+    int n_decodes = 0;
+};
+
+void batch_add(llama_batch& batch, llama_token id, llama_pos pos, int32_t seq_id, bool logits);
+
+// Context parameters of the embedding model, shared by the app and the host benchmark
+llama_context_params embedding_context_params();
+
+// Tokenize text, growing the buffer if the first pass reports it was too small
+std::vector<llama_token> tokenize_text(const llama_vocab* vocab, const char* text, int32_t text_len, bool add_special = true);
+
+// L2-normalize an embedding into out
+void normalize_embedding(const float* embd, float* out, int n_embd);
+
+// FNV-1a over the file size and the leading bytes (GGUF header + metadata) of a model file.
+// Cheap enough to run on every load and stable across app restarts.
+uint64_t compute_model_hash(const char* path);
+
+// KV cells in use over every sequence of ctx (the cache is unified, so they share n_ctx)
+int kv_cells_used(llama_context* ctx);
+
+// Context shifting. The first n_keep tokens of a sequence (system prompt and template header) are
+// pinned; when the window is full the oldest tokens after them are evicted instead of stopping.
+
+// Cut a prompt longer than n_max tokens by dropping the oldest tokens after the first n_keep.
+// Returns how many tokens were dropped; n_keep is lowered to the part that actually stayed pinned.
+int trim_prompt(std::vector<llama_token>& tokens, int& n_keep, int n_max);
+
+// Evict n_discard cached tokens of seq after its first n_keep and shift the later ones back, so
+// decoding continues at position tokens.size() - n_discard without a re-prefill. tokens mirrors the
+// sequence's KV cache and is edited to match. Returns false (and changes nothing) if the memory
+// cannot shift positions, as with recurrent models.
+bool kv_shift_discard(llama_context* ctx, llama_seq_id seq, int n_keep, int n_discard, std::vector<llama_token>& tokens);
+
+// Embed token sequences with as few decodes as possible: each sequence gets its own seq_id and
+// sequences are packed into a batch until n_batch tokens or n_seq_max sequences are reached.
+// output receives inputs.size() * n_embd normalized floats; rows for empty inputs stay zero.
+// should_abort, if set, is checked before every decode and ends the call with false.
+// Clears every sequence of ctx, each time right after should_abort let the decode go ahead.
+bool embed_sequences(llama_context* ctx, const llama_model* model, const std::vector<std::vector<llama_token>>& inputs, std::vector<float>& output,
+                     const std::function<bool()>& should_abort = nullptr, EmbedStats* stats = nullptr);
+
+// Split a long token stream into overlapping windows that each fit one micro-batch, framed with the
+// model's BOS/EOS where its vocab adds them, and embed them all. spans receives [start, end) token
+// offsets of each window into the unframed stream; output holds one normalized vector per window.
+bool embed_windows(llama_context* ctx, const llama_model* model, const std::vector<llama_token>& tokens,
+                   int window, int overlap, std::vector<std::pair<int, int>>& spans, std::vector<float>& output,
+                   const std::function<bool()>& should_abort = nullptr, EmbedStats* stats = nullptr);
+
+// Pool per-window vectors into one normalized note vector. Weighted pooling scales each window by
+// its token count so a short trailing window does not count as much as a full one.
+void pool_windows(const std::vector<std::pair<int, int>>& spans, const std::vector<float>& windows,
+                  int n_embd, bool weighted, float* out);
+
+// Embed many texts with as few decodes as possible (see embed_sequences). Texts longer than a
+// micro-batch are embedded as weighted-pooled windows instead of being truncated.
+// output receives texts.size() * n_embd normalized floats; rows for empty texts stay zero.
+bool embed_texts(llama_context* ctx, const llama_model* model, const std::vector<std::string>& texts, std::vector<float>& output,
+                 const std::function<bool()>& should_abort = nullptr, EmbedStats* stats = nullptr);
+
+struct GenerationBench {
+    int n_prompt = 0;
+    int n_gen = 0;
+    double ttft_ms = 0;     // Prefill through the first greedy token
+    double prefill_tps = 0;
+    double decode_tps = 0;
+};
+
+// Token ids do not affect speed, so benchmarks use a fixed spread instead of tokenizing text
+std::vector<llama_token> bench_tokens(const llama_vocab* vocab, int n_tokens);
+
+// Prefill prompt on seq 0 in one batch, then decode up to n_gen greedy tokens one at a time. A
+// warm-up decode runs first so shader compilation and buffer allocation stay out of the numbers.
+// The prompt is cut to fit n_batch and n_ctx. Clears every sequence of ctx before and after.
+bool bench_generation(llama_context* ctx, const llama_model* model, const std::vector<llama_token>& prompt, int n_gen,
+                      GenerationBench& result);
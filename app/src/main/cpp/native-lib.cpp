@@ -5,10 +5,37 @@
 #include <sstream>
 #include <cmath>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <unordered_map>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/system_properties.h>
 #include <dlfcn.h>
 #include "llama.h"
+#include "vector_index.h"
+#include "text_index.h"
+#include "token_stream.h"
+#include "scheduler.h"
+#include "embed_pipeline.h"
+#include "offload_planner.h"
+#include "inference.h"
+#include "request_stats.h"
+#include "trace.h"
+#include "prompt_assembler.h"
+#include "embedding_cache.h"
+#include "cpu_topology.h"
+#include "embedding_codec.h"
+#include "decode_governor.h"
+#include "gguf_inspector.h"
 
 #define TAG "LLM_JNI"
 
@@ -19,40 +46,6 @@ static std::string get_system_property(const char* key) {
     return std::string(value);
 }
 
-enum GPUVendor {
-    GPU_ADRENO,      // Qualcomm
-    GPU_MALI,        // ARM
-    GPU_POWERVR,     // Imagination
-    GPU_UNKNOWN
-};
-
-static GPUVendor detect_gpu_vendor() {
-    // Try to read GPU info from system properties
-    std::string gpu_model = get_system_property("ro.hardware.vulkan");
-    std::string soc = get_system_property("ro.board.platform");
-    std::string hardware = get_system_property("ro.hardware");
-    
-    // Check for Adreno (Qualcomm Snapdragon)
-    if (soc.find("msm") != std::string::npos || 
-        soc.find("sm") != std::string::npos ||
-        soc.find("sdm") != std::string::npos ||
-        hardware.find("qcom") != std::string::npos) {
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Detected GPU: Adreno (Qualcomm)");
-        return GPU_ADRENO;
-    }
-    
-    // Check for Mali (Samsung Exynos, MediaTek)
-    if (soc.find("exynos") != std::string::npos ||
-        soc.find("mt") != std::string::npos ||
-        hardware.find("exynos") != std::string::npos) {
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Detected GPU: Mali (ARM)");
-        return GPU_MALI;
-    }
-    
-    __android_log_print(ANDROID_LOG_WARN, TAG, "Unknown GPU vendor (soc: %s, hw: %s)", soc.c_str(), hardware.c_str());
-    return GPU_UNKNOWN;
-}
-
 // Check if the device has a known problematic Vulkan driver (e.g. Snapdragon 8 Gen 1 baseline)
 static bool is_problematic_vulkan_device() {
     std::string soc = get_system_property("ro.board.platform");
@@ -76,30 +69,114 @@ static bool is_problematic_vulkan_device() {
     return false;
 }
 
-// Determine best backend based on hardware
-static int auto_select_backend() {
-    GPUVendor gpu = detect_gpu_vendor();
-    
-    // Known problematic SoCs - force CPU
-    if (is_problematic_vulkan_device()) {
-        __android_log_print(ANDROID_LOG_WARN, TAG, "Forcing CPU due to known SoC driver issues");
-        return 0; // CPU
+// Backend ids shared with BackendType on the Kotlin side
+static const int BACKEND_CPU = 0;
+static const int BACKEND_VULKAN = 1;
+static const int BACKEND_OPENCL = 2;
+static const char* BACKEND_NAMES[] = {"CPU", "Vulkan", "OpenCL"};
+
+// Devices to offload to for a backend id, as a null-terminated list for llama_model_params.devices.
+// CPU is the empty list. Returns false if no device of that backend is registered.
+static bool backend_devices(int backend_id, std::vector<ggml_backend_dev_t>& devices) {
+    devices.clear();
+    if (backend_id != BACKEND_CPU) {
+        const char* reg_name = backend_id == BACKEND_VULKAN ? "Vulkan" : "OpenCL";
+        for (size_t i = 0; i < ggml_backend_dev_count(); i++) {
+            ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+            if (ggml_backend_dev_type(dev) == GGML_BACKEND_DEVICE_TYPE_CPU) continue;
+            if (strcmp(ggml_backend_reg_name(ggml_backend_dev_backend_reg(dev)), reg_name) == 0) {
+                devices.push_back(dev);
+            }
+        }
+        if (devices.empty()) return false;
     }
-    
-    // GPU-based selection
-    if (gpu == GPU_ADRENO) {
-        // Adreno: OpenCL is most stable
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Auto-selected: OpenCL (best for Adreno)");
-        return 2; // OpenCL
-    } else if (gpu == GPU_MALI) {
-        // Mali: OpenCL generally better than Vulkan on mobile
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Auto-selected: OpenCL (best for Mali)");
-        return 2; // OpenCL
-    } else {
-        // Unknown GPU: Try OpenCL first as it's generally safer
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Auto-selected: OpenCL (default for unknown GPU)");
-        return 2; // OpenCL
+    devices.push_back(nullptr);
+    return true;
+}
+
+// Identifies one backend benchmark profile: SoC, GPU driver build and model. The vendor build
+// fingerprint changes with every vendor/driver OTA; ro.gfx.driver.1 names an updatable GPU driver.
+static std::string backend_profile_key(uint64_t model_hash) {
+    std::string soc = get_system_property("ro.board.platform");
+    if (soc.empty()) soc = get_system_property("ro.hardware");
+    std::string driver = get_system_property("ro.vendor.build.fingerprint");
+    std::string updatable_driver = get_system_property("ro.gfx.driver.1");
+    if (!updatable_driver.empty()) driver += "+" + updatable_driver;
+
+    char hash_hex[17];
+    snprintf(hash_hex, sizeof(hash_hex), "%016llx", (unsigned long long) model_hash);
+    return soc + "|" + driver + "|" + hash_hex;
+}
+
+// Weight bytes per layer and the f16 KV cache for n_ctx of an inspected model (see gguf_inspector.h)
+static bool read_model_footprint(const GgufInfo& gguf, int n_ctx, ModelFootprint& footprint) {
+    const std::string arch = gguf.get_string("general.architecture");
+    const int n_layer = (int) gguf.get_int(arch + ".block_count", 0);
+    const int64_t n_embd = gguf.get_int(arch + ".embedding_length", 0);
+    if (n_layer <= 0 || n_embd <= 0) return false;
+
+    footprint = ModelFootprint();
+    footprint.n_ctx_train = (int) gguf.get_int(arch + ".context_length", 0);
+    footprint.layer_bytes.assign(n_layer, 0);
+    footprint.layer_ffn_bytes.assign(n_layer, 0);
+    footprint.layer_kv_bytes.assign(n_layer, 0);
+    for (int i = 0; i < n_layer; i++) {
+        const int64_t n_head = gguf.get_layer_int(arch + ".attention.head_count", i, 1);
+        const int64_t n_head_kv = gguf.get_layer_int(arch + ".attention.head_count_kv", i, n_head);
+        const int64_t head_dim = n_head > 0 ? n_embd / n_head : 0;
+        const int64_t n_embd_k = gguf.get_int(arch + ".attention.key_length", head_dim) * n_head_kv;
+        const int64_t n_embd_v = gguf.get_int(arch + ".attention.value_length", head_dim) * n_head_kv;
+        footprint.layer_kv_bytes[i] = (uint64_t) n_ctx * (n_embd_k + n_embd_v) * sizeof(uint16_t);
+    }
+
+    uint64_t token_embd_bytes = 0;
+    bool has_output = false;
+    for (const GgufTensor& t : gguf.tensors) {
+        const char* name = t.name.c_str();
+        const uint64_t size = t.bytes;
+        footprint.total_bytes += size;
+        int layer = -1;
+        int name_start = 0;
+        if (sscanf(name, "blk.%d.%n", &layer, &name_start) == 1 && name_start > 0 && layer >= 0 && layer < n_layer) {
+            footprint.layer_bytes[layer] += size;
+            const char* tensor = name + name_start;
+            if (strncmp(tensor, "ffn_up", 6) == 0 || strncmp(tensor, "ffn_gate", 8) == 0 || strncmp(tensor, "ffn_down", 8) == 0) {
+                footprint.layer_ffn_bytes[layer] += size;
+            }
+        } else if (strncmp(name, "token_embd.", 11) == 0) {
+            token_embd_bytes += size;
+        } else if (strncmp(name, "output", 6) == 0) {
+            footprint.output_bytes += size;
+            if (strcmp(name, "output.weight") == 0) has_output = true;
+        }
+    }
+    // Models with tied embeddings reuse token_embd as the output head, which is then offloaded too
+    footprint.input_bytes = token_embd_bytes;
+    if (!has_output) footprint.output_bytes += token_embd_bytes;
+    return true;
+}
+
+// Memory the kernel could give us right now, from /proc/meminfo. 0 if unknown.
+static uint64_t available_system_memory() {
+    FILE* file = fopen("/proc/meminfo", "r");
+    if (!file) return 0;
+    char line[256];
+    unsigned long long kb = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) break;
     }
+    fclose(file);
+    return (uint64_t) kb * 1024;
+}
+
+// GPU memory to plan against: the device's free memory, capped by free system memory since mobile
+// GPUs share DRAM with the CPU (and drivers often report the whole of it as "free")
+static uint64_t offload_budget(ggml_backend_dev_t device) {
+    size_t free = 0, total = 0;
+    if (device) ggml_backend_dev_memory(device, &free, &total);
+    const uint64_t system = available_system_memory();
+    if (free == 0) return system;
+    return system > 0 ? std::min<uint64_t>(free, system) : free;
 }
 
 // Global state
@@ -108,8 +185,142 @@ llama_context* g_context = nullptr;
 llama_model* g_model_embed = nullptr;
 llama_context* g_context_embed = nullptr;
 bool g_gpu_enabled = false;
+int g_backend_id = BACKEND_CPU; // Backend the chat model was loaded on
 std::string g_chat_template;
 std::atomic<bool> g_stop_requested(false);
+JavaVM* g_vm = nullptr;
+
+// g_context is shared by the chat path (seq 0) and the batch scheduler (seqs 1..SCHEDULER_SLOTS).
+// Every decode or KV change on it holds g_context_mutex; clearing all sequences bumps the epoch.
+// The KV pool is split by reservation: scheduled requests together reserve at most half of it, and
+// while a chat reply runs it claims the rest through g_chat_cells (see chat_window).
+const int SCHEDULER_SLOTS = 3;
+std::mutex g_context_mutex;
+std::atomic<uint32_t> g_context_epoch(0);
+std::atomic<int> g_chat_cells(0);
+std::unique_ptr<BatchScheduler> g_scheduler;
+
+const std::vector<std::string> CHAT_STOP_SEQUENCES = {
+    "<｜User｜>", "<｜Assistant｜>", "<｜end▁of▁sentence｜>", 
+    "<|im_end|>", "<|im_start|>", 
+    "</s>", "<|endoftext|>"
+};
+
+// Guards the embedding model/context (and the chat model the embed paths fall back to) against the
+// background embedding pipeline, which runs outside the Kotlin engine lock
+std::mutex g_embed_mutex;
+// Created once by startEmbeddingPipelineNative and kept for the life of the process, so queued notes
+// survive model reloads. completion() pauses it.
+std::atomic<EmbedPipeline*> g_embed_pipeline(nullptr);
+const int EMBED_PIPELINE_BATCH = 16;        // Notes per pipeline call, one sequence each in the embed context
+const int EMBED_PIPELINE_COALESCE_MS = 500; // Debounce for bursts of saves of the same note
+const int EMBED_PIPELINE_NICE = 10;
+// Chunk vectors of the pipeline's notes, one cache file per embedding model under g_embed_cache_dir.
+// Guarded by g_embed_mutex.
+std::unique_ptr<EmbeddingCache> g_embed_cache;
+std::string g_embed_cache_dir;
+const size_t EMBED_CACHE_ENTRIES = 4096;
+// Fingerprint of the loaded embedding model, keys its chunk cache
+uint64_t g_embed_model_hash = 0;
+
+// Tokens currently held in the chat context's KV cache for seq 0 (prompt + decoded output).
+// Used to skip re-prefilling the shared prefix (system prompt, template header) between calls.
+std::vector<llama_token> g_cached_tokens;
+// Fingerprint of the loaded chat model, used to key persisted session snapshots
+uint64_t g_model_hash = 0;
+
+// Optional draft model for speculative decoding; must share the chat model's vocabulary
+llama_model* g_model_draft = nullptr;
+llama_context* g_context_draft = nullptr;
+std::vector<llama_token> g_draft_cached_tokens; // Tokens held in the draft context's KV cache
+int g_n_draft = 0;                              // Max tokens proposed per verification step
+// Speculation counters for the last completion() call
+int g_spec_drafted = 0;
+int g_spec_accepted = 0;
+// Prompt-lookup speculation: draft by copying what followed the latest match of the recent output
+// n-gram in the prompt. No extra model; used when no draft model is loaded. 0 disables it.
+int g_lookup_ngram_max = 0;
+int g_lookup_n_draft = 0;
+
+// Context shifting: instead of stopping at n_ctx, evict the oldest tokens after the pinned system
+// prompt and template header (see kv_shift_discard), and trim prompts that do not fit the window.
+bool g_context_shift = true;
+// Tokens of the formatted prompt with an empty user message; its common prefix with a real prompt
+// is pinned. Built when the chat model loads, read-only afterwards.
+std::vector<llama_token> g_pinned_prefix;
+
+// Decode governor of the chat path (see decode_governor.h), rebuilt with every chat model. Used under
+// g_context_mutex. Null while disabled.
+bool g_governor_enabled = true;
+std::unique_ptr<DecodeGovernor> g_governor;
+
+// LoRA adapters loaded against the chat model, by file path. Each is read once and kept until it is
+// unloaded or the chat model changes; llama.cpp frees the remaining ones with their model. Switching
+// the active set is then a matter of milliseconds instead of a model reload. g_lora_mutex guards the
+// map and nests inside g_context_mutex; the active set changes under g_context_mutex.
+struct LoraAdapter {
+    llama_adapter_lora* adapter = nullptr;
+    uint64_t bytes = 0;
+};
+std::mutex g_lora_mutex;
+std::unordered_map<std::string, LoraAdapter> g_lora_adapters;
+std::vector<std::pair<std::string, float>> g_lora_active; // Applied to g_context, in request order
+// Fingerprint of the active set, mixed into session snapshot names; 0 with no adapter active
+std::atomic<uint64_t> g_lora_hash(0);
+
+// RAG prompts assembled from token runs (see prompt_assembler.h), rebuilt for every chat model since
+// the template and the vocabulary change with it. Null if the template could not be split.
+std::mutex g_assembler_mutex;
+std::unique_ptr<PromptAssembler> g_prompt_assembler;
+const size_t PROMPT_CACHE_TOKENS = 64 * 1024; // Tokenized chunks kept across questions (~256 KB)
+
+// Layer split of the loaded chat model. The override pattern must outlive the load, llama.cpp keeps
+// the pointer in its model params.
+OffloadPlan g_offload_plan;
+std::string g_offload_override_pattern;
+// Headroom kept out of the offload budget for compute buffers, on top of the KQ scores of one batch
+const uint64_t OFFLOAD_COMPUTE_RESERVE = 128ull * 1024 * 1024;
+
+// Memory budget mode: with a budget set, load_chat_model sizes n_ctx and the KV cache type to fit it
+// (see plan_context) instead of taking n_ctx as given. 0 disables it.
+std::atomic<uint64_t> g_memory_budget(0);
+ContextPlan g_context_plan; // Of the loaded chat model
+const int CONTEXT_PLAN_MIN = 512;
+// Past this, prefill time rather than memory limits a phone, so the memory is left to the system
+const int CONTEXT_PLAN_MAX = 16384;
+
+// Stats of the last completion() call and the last embed call, for getLast*StatsNative.
+// Requests on the batch scheduler report theirs through LlmRequestCallback.onStats instead.
+struct EmbedCallStats {
+    int n_texts = 0;
+    EmbedStats work;
+    double total_ms = 0;
+};
+std::mutex g_stats_mutex;
+RequestStats g_last_stats;
+bool g_has_last_stats = false;
+EmbedCallStats g_last_embed_stats;
+bool g_has_last_embed_stats = false;
+
+// Stats classes, cached in JNI_OnLoad: FindClass on the scheduler's native thread cannot see app classes
+jclass g_generation_stats_class = nullptr;
+jmethodID g_generation_stats_ctor = nullptr;
+jclass g_embedding_stats_class = nullptr;
+jmethodID g_embedding_stats_ctor = nullptr;
+
+// One model load. llama.cpp polls the progress callback between tensors, and returning false from it
+// aborts the load: that is how a load is cancelled.
+struct ModelLoad {
+    std::atomic<bool> cancelled{false};
+    uint64_t total_bytes = 0;
+    int last_permille = -1;
+    jobject callback = nullptr;        // ModelLoadCallback global ref, null for synchronous loads
+    jmethodID on_progress = nullptr;
+};
+// Loads started by startModelLoadNative / startEmbeddingModelLoadNative, by handle
+std::mutex g_loads_mutex;
+std::unordered_map<jlong, std::shared_ptr<ModelLoad>> g_loads;
+jlong g_next_load_handle = 1;
 
 // Logging callback
 static void android_log_callback(ggml_log_level level, const char * text, void * user_data) {
@@ -127,271 +338,280 @@ static void android_log_callback(ggml_log_level level, const char * text, void *
     __android_log_print(android_level, "LLAMA_CPP", "%s", msg.c_str());
 }
 
-// Helper to add token to batch
-static void batch_add(llama_batch & batch, llama_token id, llama_pos pos, int32_t seq_id, bool logits) {
-    batch.token[batch.n_tokens] = id;
-    batch.pos[batch.n_tokens] = pos;
-    batch.n_seq_id[batch.n_tokens] = 1;
-    batch.seq_id[batch.n_tokens][0] = seq_id;
-    batch.logits[batch.n_tokens] = logits ? 1 : 0;
-    batch.n_tokens++;
+// NewStringUTF expects modified UTF-8 and mangles characters outside the BMP (emoji), so build
+// the string from UTF-16 instead. Invalid bytes become U+FFFD.
+static jstring new_jstring_utf8(JNIEnv* env, const std::string& text) {
+    std::vector<jchar> utf16;
+    utf16.reserve(text.size());
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    while (p < end) {
+        uint32_t cp = *p++;
+        int extra = 0;
+        if (cp >= 0xF8) { cp = 0xFFFD; }
+        else if (cp >= 0xF0) { cp &= 0x07; extra = 3; }
+        else if (cp >= 0xE0) { cp &= 0x0F; extra = 2; }
+        else if (cp >= 0xC0) { cp &= 0x1F; extra = 1; }
+        else if (cp >= 0x80) { cp = 0xFFFD; }
+        for (; extra > 0; extra--) {
+            if (p == end || (*p & 0xC0) != 0x80) { cp = 0xFFFD; break; }
+            cp = (cp << 6) | (*p++ & 0x3F);
+        }
+        if (cp >= 0x10000 && cp <= 0x10FFFF) {
+            cp -= 0x10000;
+            utf16.push_back((jchar) (0xD800 + (cp >> 10)));
+            utf16.push_back((jchar) (0xDC00 + (cp & 0x3FF)));
+        } else {
+            utf16.push_back((jchar) (cp > 0x10FFFF ? 0xFFFD : cp));
+        }
+    }
+    return env->NewString(utf16.data(), utf16.size());
 }
 
-// Forward declarations
-extern "C" {
-    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id);
-    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative(JNIEnv* env, jobject, jstring path);
-    JNIEXPORT jstring JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_completion(JNIEnv* env, jobject, jstring prompt, jobject callback);
-    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion(JNIEnv* env, jobject);
-    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_isGpuEnabled(JNIEnv* env, jobject);
-    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_isOpenCLAvailable(JNIEnv* env, jobject);
-    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstring text);
-    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_unload(JNIEnv* env, jobject);
+static std::string jstring_to_std(JNIEnv* env, jstring str) {
+    const char* cstr = env->GetStringUTFChars(str, nullptr);
+    std::string result(cstr);
+    env->ReleaseStringUTFChars(str, cstr);
+    return result;
 }
 
-extern "C" JNIEXPORT jint JNICALL
-JNI_OnLoad(JavaVM* vm, void* reserved) {
-    __android_log_print(ANDROID_LOG_INFO, TAG, "JNI_OnLoad: Initializing llama.cpp backend [Build: 2026-01-21 v5 - Dynamic Config + Stop]");
-    
-    JNIEnv* env;
-    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
-        return JNI_ERR;
-    }
-
-    // Register natives explicitly to avoid UnsatisfiedLinkError issues
-    jclass clazz = env->FindClass("com/synapsenotes/ai/core/ai/LlamaContext");
-    if (clazz == nullptr) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to find LlamaContext class");
-        return JNI_ERR;
+// Forwards load progress to the load's callback; returning false aborts a cancelled load
+static bool model_load_progress(float progress, void* user_data) {
+    ModelLoad* load = static_cast<ModelLoad*>(user_data);
+    if (load->cancelled.load()) return false;
+
+    const int permille = (int) (progress * 1000.0f);
+    if (load->callback && permille != load->last_permille) {
+        load->last_permille = permille;
+        JNIEnv* env = nullptr;
+        g_vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6);
+        env->CallVoidMethod(load->callback, load->on_progress, (jlong) (progress * load->total_bytes), (jlong) load->total_bytes);
     }
+    return true;
+}
 
-    JNINativeMethod methods[] = {
-        {"loadModelNative", "(Ljava/lang/String;Ljava/lang/String;IIZI)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative},
-        {"loadEmbeddingModelNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative},
-        {"completion", "(Ljava/lang/String;Lcom/synapsenotes/ai/core/ai/LlmCallback;)Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_completion},
-        {"stopCompletion", "()V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion},
-        {"isGpuEnabled", "()Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_isGpuEnabled},
-        {"isOpenCLAvailable", "()Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_isOpenCLAvailable},
-        {"embed", "(Ljava/lang/String;)[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embed},
-        {"unload", "()V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_unload}
-    };
+// Hook a load up to model params for progress and cancellation
+static void track_model_load(llama_model_params& params, const char* path, ModelLoad* load) {
+    if (!load) return;
+    struct stat st;
+    load->total_bytes = stat(path, &st) == 0 ? (uint64_t) st.st_size : 0;
+    params.progress_callback = model_load_progress;
+    params.progress_callback_user_data = load;
+}
 
-    if (env->RegisterNatives(clazz, methods, sizeof(methods) / sizeof(methods[0])) < 0) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to register native methods");
-        return JNI_ERR;
-    }
+static int64_t steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    llama_backend_init();
-    llama_log_set(android_log_callback, nullptr);
-    return JNI_VERSION_1_6;
+static jobject new_generation_stats(JNIEnv* env, const RequestStats& stats) {
+    const int gpu_layers = !g_gpu_enabled ? 0
+            : (g_offload_plan.n_layer > 0 ? std::min(g_offload_plan.n_gpu_layers, g_offload_plan.n_layer) : -1);
+    jstring backend = env->NewStringUTF(BACKEND_NAMES[g_backend_id]);
+    jobject result = env->NewObject(g_generation_stats_class, g_generation_stats_ctor, backend, (jint) gpu_layers,
+                                    (jint) stats.n_prompt_tokens, (jint) stats.n_cached_tokens, (jint) stats.n_generated_tokens,
+                                    (jint) stats.n_discarded_tokens,
+                                    (jint) stats.n_prefill_batches, (jint) stats.max_batch_tokens,
+                                    (jint) stats.n_drafted, (jint) stats.n_accepted, (jint) stats.kv_used, (jint) stats.n_ctx,
+                                    stats.queue_ms, stats.tokenize_ms, stats.prefill_ms, stats.ttft_ms, stats.decode_ms,
+                                    (jint) stats.governor_level, (jint) stats.n_governor_changes, (jint) stats.n_threads,
+                                    (jint) stats.prefill_chunk, stats.pacing_ms, stats.soc_celsius,
+                                    stats.cancelled ? JNI_TRUE : JNI_FALSE);
+    env->DeleteLocalRef(backend);
+    return result;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative(JNIEnv* env, jobject, jstring path) {
-    const char* model_path = env->GetStringUTFChars(path, nullptr);
+// Record the work of an embed JNI call started at start_us
+static void record_embed_stats(int n_texts, const EmbedStats& work, int64_t start_us) {
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_last_embed_stats.n_texts = n_texts;
+    g_last_embed_stats.work = work;
+    g_last_embed_stats.total_ms = (monotonic_us() - start_us) / 1000.0;
+    g_has_last_embed_stats = true;
+}
 
-    if (g_context_embed) {
-        llama_free(g_context_embed);
-        g_context_embed = nullptr;
+// Fingerprint of an active adapter set, 0 for none. It names session files, so it is FNV-1a like
+// compute_model_hash rather than std::hash, which may change between builds.
+static uint64_t lora_set_hash(const std::vector<std::pair<std::string, float>>& adapters) {
+    if (adapters.empty()) return 0;
+    uint64_t hash = 1469598103934665603ULL;
+    for (const auto& entry : adapters) {
+        char scale[32];
+        snprintf(scale, sizeof(scale), "@%g;", entry.second);
+        const std::string key = entry.first + scale;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
     }
-    if (g_model_embed) {
-        llama_model_free(g_model_embed);
-        g_model_embed = nullptr;
+    return hash;
+}
+
+// Drop the adapters of a chat model about to be freed, which frees them itself
+static void forget_lora_adapters() {
+    std::lock_guard<std::mutex> lora_lock(g_lora_mutex);
+    g_lora_adapters.clear();
+    g_lora_active.clear();
+    g_lora_hash = 0;
+}
+
+// Session snapshot file for a conversation: <dir>/<conversation id>-<model hash>.session. The hash
+// covers the active LoRA adapters, whose KV state differs from the base model's.
+static std::string session_file_path(const std::string& dir, const std::string& session_id) {
+    std::string safe_id;
+    for (char c : session_id) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+        safe_id += ok ? c : '_';
     }
+    char hash_hex[17];
+    snprintf(hash_hex, sizeof(hash_hex), "%016llx", (unsigned long long) (g_model_hash ^ g_lora_hash));
+    return dir + "/" + safe_id + "-" + hash_hex + ".session";
+}
 
-    struct llama_model_params model_params = llama_model_default_params();
-    model_params.use_mmap = false;
-    
-    // Check for known problematic SoCs - must force CPU to avoid Vulkan driver crash
-    if (is_problematic_vulkan_device()) {
-        __android_log_print(ANDROID_LOG_WARN, TAG, "Problematic SoC detected - forcing CPU for embedding model to avoid driver crash");
-        model_params.n_gpu_layers = 0;
-        setenv("GGML_VULKAN_DISABLE", "1", 1);
-        setenv("GGML_OPENCL_DISABLE", "1", 1);
-        g_model_embed = llama_model_load_from_file(model_path, model_params);
-    } else {
-        model_params.n_gpu_layers = -1; // Try GPU first
-        
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Loading embedding model with smart fallback: OpenCL → Vulkan → CPU");
-        
-        // Try OpenCL first (most stable)
-        unsetenv("GGML_VULKAN_DISABLE");
-        unsetenv("GGML_OPENCL_DISABLE");
-        setenv("GGML_VULKAN_DISABLE", "1", 1);
-        g_model_embed = llama_model_load_from_file(model_path, model_params);
-        
-        if (!g_model_embed) {
-            // Try Vulkan
-            __android_log_print(ANDROID_LOG_WARN, TAG, "OpenCL failed, trying Vulkan for embedding model...");
-            unsetenv("GGML_VULKAN_DISABLE");
-            setenv("GGML_OPENCL_DISABLE", "1", 1);
-            g_model_embed = llama_model_load_from_file(model_path, model_params);
-        }
-        
-        if (!g_model_embed) {
-            // CPU fallback
-            __android_log_print(ANDROID_LOG_WARN, TAG, "GPU failed, using CPU for embedding model...");
-            model_params.n_gpu_layers = 0;
-            setenv("GGML_VULKAN_DISABLE", "1", 1);
-            setenv("GGML_OPENCL_DISABLE", "1", 1);
-            g_model_embed = llama_model_load_from_file(model_path, model_params);
+// The context the embed paths run on: the embedding model's, or the chat model's when none is loaded.
+// Holds g_embed_mutex; borrowing the chat context also holds g_context_mutex. The first decode on
+// a borrowed chat context wipes every sequence on it, scheduled ones included, so the chat cache is
+// only invalidated then (claim()): a call served from the embedding cache or aborted before it
+// decodes leaves it intact.
+struct EmbedTarget {
+    std::lock_guard<std::mutex> embed_lock;
+    std::unique_lock<std::mutex> ctx_lock;
+    llama_context* ctx;
+    llama_model* model;
+    bool chat_borrowed = false;
+
+    EmbedTarget() : embed_lock(g_embed_mutex), ctx_lock(g_context_mutex, std::defer_lock) {
+        ctx = g_context_embed ? g_context_embed : g_context;
+        model = g_context_embed ? g_model_embed : g_model;
+        if (ctx && ctx == g_context) {
+            ctx_lock.lock();
+            chat_borrowed = true;
         }
     }
 
-    env->ReleaseStringUTFChars(path, model_path);
-
-    if (!g_model_embed) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to load embedding model with all backends");
-        return JNI_FALSE;
+    // Call right before ctx's sequences are cleared for a decode
+    void claim() {
+        if (!chat_borrowed) return;
+        chat_borrowed = false;
+        g_cached_tokens.clear();
+        g_context_epoch++;
     }
 
-    struct llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.embeddings = true;
-    ctx_params.n_ctx = 2048;
-    ctx_params.n_batch = 512;
-    
-    g_context_embed = llama_init_from_model(g_model_embed, ctx_params);
-    if (!g_context_embed) {
-         llama_model_free(g_model_embed);
-         g_model_embed = nullptr;
-         return JNI_FALSE;
+    // should_abort for the inference.h embed paths, which poll it right before clearing ctx for
+    // each decode: claims the context once a decode goes ahead
+    std::function<bool()> before_decode(std::function<bool()> should_abort = nullptr) {
+        return [this, should_abort] {
+            if (should_abort && should_abort()) return true;
+            claim();
+            return false;
+        };
     }
-    
-    __android_log_print(ANDROID_LOG_INFO, TAG, "Embedding model loaded successfully");
-    return JNI_TRUE;
+};
+
+// Stop drafting once the draft model's top token falls below this probability
+static const float DRAFT_P_MIN = 0.5f;
+
+// A draft model can only propose tokens the chat model understands
+static bool vocabs_compatible(const llama_vocab* a, const llama_vocab* b) {
+    return llama_vocab_type(a) == llama_vocab_type(b)
+        && llama_vocab_n_tokens(a) == llama_vocab_n_tokens(b)
+        && llama_vocab_bos(a) == llama_vocab_bos(b)
+        && llama_vocab_eos(a) == llama_vocab_eos(b);
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id) {
-    const char* model_path = env->GetStringUTFChars(path, nullptr);
-    
-    if (template_str != nullptr) {
-        const char* tmpl = env->GetStringUTFChars(template_str, nullptr);
-        g_chat_template = std::string(tmpl);
-        env->ReleaseStringUTFChars(template_str, tmpl);
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Loaded custom chat template");
-    } else {
-        g_chat_template = "";
+// Most likely token under logits, with its softmax probability
+static llama_token greedy_token(const float* logits, int n_vocab, float* prob) {
+    llama_token best = 0;
+    for (int i = 1; i < n_vocab; i++) {
+        if (logits[i] > logits[best]) best = i;
     }
+    double sum = 0.0;
+    for (int i = 0; i < n_vocab; i++) sum += exp(logits[i] - logits[best]);
+    *prob = (float) (1.0 / sum);
+    return best;
+}
 
-    if (g_context) {
-        llama_free(g_context);
-        g_context = nullptr;
+// Propose up to n_draft greedy continuation tokens of `tokens` with the draft model. The draft
+// context keeps its KV cache between calls, so only tokens it has not seen yet are decoded.
+static void draft_tokens(const std::vector<llama_token>& tokens, int n_draft, std::vector<llama_token>& out) {
+    out.clear();
+    if (!g_context_draft || n_draft <= 0 || tokens.empty()) return;
+    if ((int) tokens.size() + n_draft > (int) llama_n_ctx(g_context_draft)) return;
+
+    llama_memory_t mem = llama_get_memory(g_context_draft);
+    int n_past = 0;
+    while (n_past < (int) g_draft_cached_tokens.size() && n_past < (int) tokens.size() && g_draft_cached_tokens[n_past] == tokens[n_past]) {
+        n_past++;
     }
-    if (g_model) {
-        llama_model_free(g_model);
-        g_model = nullptr;
+    if (n_past >= (int) tokens.size()) {
+        n_past = tokens.size() - 1;
+    }
+    if (!llama_memory_seq_rm(mem, 0, n_past, -1)) {
+        llama_memory_seq_rm(mem, -1, -1, -1);
+        n_past = 0;
     }
+    g_draft_cached_tokens.assign(tokens.begin(), tokens.begin() + n_past);
 
-    struct llama_model_params model_params = llama_model_default_params();
-    model_params.use_mmap = (bool)use_mmap;
-    model_params.n_gpu_layers = -1; // Enable GPU
-    
-    // Auto-detect best backend based on hardware
-    int auto_backend = auto_select_backend();
-    __android_log_print(ANDROID_LOG_INFO, TAG, 
-        "Auto-detected backend: %d (user requested: %d) - Using auto-detected", auto_backend, backend_id);
-    
-    // Track which backends we've tried
-    bool tried_opencl = false;
-    bool tried_vulkan = false;
-    bool tried_cpu = false;
-    
-    // Helper lambda to try a specific backend
-    auto try_backend = [&](int backend_type) -> bool {
-        if (backend_type == 0 && !tried_cpu) { // CPU
-            tried_cpu = true;
-            __android_log_print(ANDROID_LOG_INFO, TAG, "Trying CPU backend...");
-            model_params.n_gpu_layers = 0;
-            setenv("GGML_VULKAN_DISABLE", "1", 1);
-            setenv("GGML_OPENCL_DISABLE", "1", 1);
-            g_model = llama_model_load_from_file(model_path, model_params);
-            if (g_model) {
-                __android_log_print(ANDROID_LOG_INFO, TAG, "✓ CPU backend loaded successfully");
-                g_gpu_enabled = false;
-                return true;
-            }
-        } else if (backend_type == 1 && !tried_vulkan) { // VULKAN
-            tried_vulkan = true;
-            __android_log_print(ANDROID_LOG_INFO, TAG, "Trying Vulkan backend...");
-            model_params.n_gpu_layers = -1;
-            unsetenv("GGML_VULKAN_DISABLE");
-            setenv("GGML_OPENCL_DISABLE", "1", 1);
-            g_model = llama_model_load_from_file(model_path, model_params);
-            if (g_model) {
-                __android_log_print(ANDROID_LOG_INFO, TAG, "✓ Vulkan backend loaded successfully");
-                g_gpu_enabled = true;
-                return true;
-            }
-        } else if (backend_type == 2 && !tried_opencl) { // OPENCL
-            tried_opencl = true;
-            __android_log_print(ANDROID_LOG_INFO, TAG, "Trying OpenCL backend...");
-            model_params.n_gpu_layers = -1;
-            setenv("GGML_VULKAN_DISABLE", "1", 1);
-            unsetenv("GGML_OPENCL_DISABLE");
-            g_model = llama_model_load_from_file(model_path, model_params);
-            if (g_model) {
-                __android_log_print(ANDROID_LOG_INFO, TAG, "✓ OpenCL backend loaded successfully");
-                g_gpu_enabled = true;
-                return true;
-            }
+    const int32_t n_batch = llama_n_batch(g_context_draft);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    for (int i = n_past; i < (int) tokens.size(); i += n_batch) {
+        const int n_chunk = std::min(n_batch, (int32_t) tokens.size() - i);
+        batch.n_tokens = 0;
+        for (int j = 0; j < n_chunk; j++) {
+            batch_add(batch, tokens[i + j], i + j, 0, i + j == (int) tokens.size() - 1);
         }
-        return false;
-    };
-    
-    // Step 1: Try auto-detected backend first
-    if (!try_backend(auto_backend)) {
-        __android_log_print(ANDROID_LOG_WARN, TAG, "Auto-detected backend failed, trying fallbacks...");
-        
-        // Step 2: Fallback priority order (skip what we already tried)
-        // Priority: OpenCL → Vulkan → CPU
-        if (!try_backend(2)) {  // OpenCL
-            if (!try_backend(1)) {  // Vulkan
-                try_backend(0);  // CPU
-            }
+        if (llama_decode(g_context_draft, batch) != 0) {
+            llama_memory_seq_rm(mem, -1, -1, -1);
+            g_draft_cached_tokens.clear();
+            llama_batch_free(batch);
+            return;
         }
+        g_draft_cached_tokens.insert(g_draft_cached_tokens.end(), tokens.begin() + i, tokens.begin() + i + n_chunk);
     }
 
-    env->ReleaseStringUTFChars(path, model_path);
-
-    if (!g_model) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to load model with all backends");
-        return JNI_FALSE;
-    }
+    const llama_vocab* vocab = llama_model_get_vocab(g_model_draft);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    for (int j = 0; j < n_draft; j++) {
+        float prob = 0.0f;
+        llama_token token = greedy_token(llama_get_logits_ith(g_context_draft, -1), n_vocab, &prob);
+        if (prob < DRAFT_P_MIN) break;
+        out.push_back(token);
+        if (j + 1 == n_draft || llama_vocab_is_eog(vocab, token)) break;
 
-    struct llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = n_ctx; 
-    ctx_params.n_batch = n_batch;
-    
-    g_context = llama_init_from_model(g_model, ctx_params);
-    if (!g_context) {
-         llama_model_free(g_model);
-         g_model = nullptr;
-         return JNI_FALSE;
+        batch.n_tokens = 0;
+        batch_add(batch, token, g_draft_cached_tokens.size(), 0, true);
+        if (llama_decode(g_context_draft, batch) != 0) {
+            llama_memory_seq_rm(mem, -1, -1, -1);
+            g_draft_cached_tokens.clear();
+            break;
+        }
+        g_draft_cached_tokens.push_back(token);
     }
-
-    return JNI_TRUE;
+    llama_batch_free(batch);
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion(JNIEnv* env, jobject) {
-    g_stop_requested = true;
-    __android_log_print(ANDROID_LOG_INFO, TAG, "Stop requested");
+// Shortest n-gram worth matching; single tokens match too often to predict a continuation
+static const int LOOKUP_NGRAM_MIN = 2;
+
+// Propose up to n_draft tokens by finding the trailing n-gram of `recent` in the prompt, longest
+// n-gram first and latest occurrence first, and copying the tokens that followed it
+static void lookup_draft(const std::vector<llama_token>& prompt, const std::vector<llama_token>& recent,
+                         int ngram_max, int n_draft, std::vector<llama_token>& out) {
+    out.clear();
+    for (int n = std::min(ngram_max, (int) recent.size()); n >= LOOKUP_NGRAM_MIN; n--) {
+        const llama_token* ngram = recent.data() + recent.size() - n;
+        for (int i = (int) prompt.size() - n - 1; i >= 0; i--) {
+            if (std::equal(ngram, ngram + n, prompt.begin() + i)) {
+                const int start = i + n;
+                const int end = std::min((int) prompt.size(), start + n_draft);
+                out.assign(prompt.begin() + start, prompt.begin() + end);
+                return;
+            }
+        }
+    }
 }
 
-extern "C" JNIEXPORT jstring JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_completion(JNIEnv* env, jobject, jstring prompt, jobject callback) {
-    if (!g_context) return env->NewStringUTF("Error: Model not loaded");
-    
-    g_stop_requested = false;
-    
-    jclass callbackClass = env->GetObjectClass(callback);
-    jmethodID onTokenMethod = env->GetMethodID(callbackClass, "onToken", "(Ljava/lang/String;)V");
-    
-    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
-    std::string user_prompt(prompt_cstr);
-    env->ReleaseStringUTFChars(prompt, prompt_cstr);
-
+// Wrap a user prompt in the system prompt and the chat template (custom, built-in, or ChatML)
+static std::string format_chat_prompt(const std::string& user_prompt) {
     // Prepare messages for template
     std::vector<llama_chat_message> messages;
     std::string system_content = "You are a helpful AI assistant integrated into a notes app. Use the provided context to answer questions accurately.\n\nIMPORTANT: If the user asks in Turkish, answer in Turkish. You must wrap your internal reasoning and thought process inside <think> and </think> tags. The final answer should be outside these tags.";
@@ -434,117 +654,1619 @@ Java_com_synapsenotes_ai_core_ai_LlamaContext_completion(JNIEnv* env, jobject, j
         final_prompt_str = ss.str();
     }
 
-    __android_log_print(ANDROID_LOG_INFO, TAG, "Final Prompt sent to tokenize: %s", final_prompt_str.substr(0, 500).c_str());
-
-    const char* final_prompt = final_prompt_str.c_str();
-    int prompt_length = final_prompt_str.length();
-
-    const struct llama_vocab * vocab = llama_model_get_vocab(g_model);
+    return final_prompt_str;
+}
 
-    std::vector<llama_token> tokens_list;
-    tokens_list.resize(prompt_length + 100); 
-    int n_tokens = llama_tokenize(vocab, final_prompt, prompt_length, tokens_list.data(), tokens_list.size(), true, true);
-    if (n_tokens < 0) {
-        tokens_list.resize(-n_tokens);
-        n_tokens = llama_tokenize(vocab, final_prompt, prompt_length, tokens_list.data(), tokens_list.size(), true, true);
+// Leading tokens of a formatted prompt that context shifting must keep: the system prompt and the
+// template up to the user's text
+static int pinned_token_count(const std::vector<llama_token>& tokens) {
+    size_t n_keep = 0;
+    while (n_keep < g_pinned_prefix.size() && n_keep < tokens.size() && g_pinned_prefix[n_keep] == tokens[n_keep]) {
+        n_keep++;
     }
-    tokens_list.resize(n_tokens);
+    return n_keep;
+}
 
-    llama_memory_seq_rm(llama_get_memory(g_context), -1, -1, -1);
+// Split the chat template around a placeholder user message, so prompts can be assembled from tokens
+static std::unique_ptr<PromptAssembler> make_prompt_assembler() {
+    static const std::string marker = "@@USER_MESSAGE@@";
+    const std::string templated = format_chat_prompt(marker);
+    const size_t at = templated.find(marker);
+    if (at == std::string::npos) {
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Chat template rewrites the user message, prompt assembly disabled");
+        return nullptr;
+    }
+    PromptLayout layout;
+    layout.prefix = templated.substr(0, at);
+    layout.suffix = templated.substr(at + marker.size());
+    return std::unique_ptr<PromptAssembler>(new PromptAssembler(llama_model_get_vocab(g_model), layout, PROMPT_CACHE_TOKENS));
+}
 
-    llama_batch batch = llama_batch_init(2048, 0, 1);
+// A prompt trimmed to fit leaves this share of the window for the answer
+static int max_prompt_tokens(int n_ctx) {
+    return n_ctx - n_ctx / 4;
+}
 
-    // Dynamic batch size from context
-    const int32_t n_batch = llama_n_batch(g_context);
+// KV cells all scheduled requests together may reserve; the rest of the pool is the chat's
+static int scheduler_cells(int n_ctx) {
+    return n_ctx / 2;
+}
 
-    for (int i = 0; i < n_tokens; i += n_batch) {
-        int n_chunk = n_tokens - i;
-        if (n_chunk > n_batch) n_chunk = n_batch;
-        
-        batch.n_tokens = 0;
-        for (int j = 0; j < n_chunk; j++) {
-            batch_add(batch, tokens_list[i + j], i + j, 0, false);
-        }
-        
-        if (i + n_chunk == n_tokens) {
-            batch.logits[batch.n_tokens - 1] = 1;
-        }
+// Cells the chat may use for a reply now: whatever running scheduled requests have not reserved.
+// Claims them for the scheduler's admission until release_chat_cells. Call with g_context_mutex held.
+static int chat_window() {
+    const int n_ctx = llama_n_ctx(g_context);
+    const int n_window = n_ctx - (g_scheduler ? g_scheduler->reserved_cells() : 0);
+    g_chat_cells = n_window;
+    return n_window;
+}
 
-        if (llama_decode(g_context, batch) != 0) {
-            llama_batch_free(batch);
-            return env->NewStringUTF("Error: llama_decode failed during prompt processing");
+// Drop the chat's claim. Between replies seq 0 keeps at most its own share of the pool cached, so
+// scheduled requests always find theirs. Call with g_context_mutex held.
+static void release_chat_cells() {
+    const int n_ctx = llama_n_ctx(g_context);
+    const int n_keep = n_ctx - scheduler_cells(n_ctx);
+    if ((int) g_cached_tokens.size() > n_keep) {
+        llama_memory_t mem = llama_get_memory(g_context);
+        if (llama_memory_seq_rm(mem, 0, n_keep, -1)) {
+            g_cached_tokens.resize(n_keep);
+        } else {
+            llama_memory_seq_rm(mem, 0, -1, -1);
+            g_cached_tokens.clear();
         }
     }
+    g_chat_cells = 0;
+    if (g_scheduler) g_scheduler->wake();
+}
 
-    struct llama_sampler_chain_params sparams = llama_sampler_chain_default_params();
-    struct llama_sampler * sampler = llama_sampler_chain_init(sparams);
-    
-    llama_sampler_chain_add(sampler, llama_sampler_init_top_k(40));
-    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(0.9f, 1));
-    llama_sampler_chain_add(sampler, llama_sampler_init_temp(0.7f));
-    llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
-
-    std::string result_str = "";
-    int n_cur = n_tokens;
-    int n_decode = 0;
-    const int max_tokens = 2048; 
-    
-    const std::vector<std::string> stop_sequences = {
-        "<｜User｜>", "<｜Assistant｜>", "<｜end▁of▁sentence｜>", 
-        "<|im_end|>", "<|im_start|>", 
-        "</s>", "<|endoftext|>"
-    };
+// Fail a chat reply: completion() throws instead of returning a partial answer as if it were whole
+static jstring throw_generation_error(JNIEnv* env, const char* message) {
+    __android_log_print(ANDROID_LOG_ERROR, TAG, "%s", message);
+    env->ThrowNew(env->FindClass("java/lang/IllegalStateException"), message);
+    return nullptr;
+}
 
-    while (n_decode < max_tokens && n_cur < llama_n_ctx(g_context)) {
-        if (g_stop_requested) {
-            __android_log_print(ANDROID_LOG_INFO, TAG, "Generation stopped by user.");
-            break;
-        }
+// Forward declarations
+extern "C" {
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id);
+    JNIEXPORT jstring JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getBackendProfileKeyNative(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_benchmarkBackendNative(JNIEnv* env, jobject);
+    JNIEXPORT jlongArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getOffloadPlanNative(JNIEnv* env, jobject);
+    JNIEXPORT jlong JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_startModelLoadNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id, jobject callback);
+    JNIEXPORT jlong JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingModelLoadNative(JNIEnv* env, jobject, jstring path, jboolean use_mmap, jobject callback);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelModelLoadNative(JNIEnv* env, jobject, jlong handle);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadDraftModelNative(JNIEnv* env, jobject, jstring path, jint n_draft);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadDraftModelNative(JNIEnv* env, jobject);
+    JNIEXPORT jintArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getSpeculativeStats(JNIEnv* env, jobject);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_setPromptLookupNative(JNIEnv* env, jobject, jint ngram_max, jint n_draft);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_setContextShiftNative(JNIEnv* env, jobject, jboolean enabled);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_setDecodeGovernorNative(JNIEnv* env, jobject, jboolean enabled);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_loadLoraAdapterNative(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_setLoraAdaptersNative(JNIEnv* env, jobject, jobjectArray paths, jfloatArray scales);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadLoraAdapterNative(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT jobject JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_inspectModelNative(JNIEnv* env, jobject, jstring path, jint n_ctx);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_setMemoryBudgetNative(JNIEnv* env, jobject, jlong budget_bytes);
+    JNIEXPORT jlongArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getMemoryPlanNative(JNIEnv* env, jobject);
+    JNIEXPORT jobject JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastGenerationStatsNative(JNIEnv* env, jobject);
+    JNIEXPORT jobject JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastEmbeddingStatsNative(JNIEnv* env, jobject);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_startTraceNative(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_stopTraceNative(JNIEnv* env, jobject);
+    JNIEXPORT jstring JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_completion(JNIEnv* env, jobject, jstring prompt, jobject callback);
+    JNIEXPORT jobject JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_assemblePromptNative(JNIEnv* env, jobject, jstring query, jobjectArray chunks, jint budget_tokens);
+    JNIEXPORT jstring JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_completionTokens(JNIEnv* env, jobject, jintArray tokens, jobject callback);
+    JNIEXPORT jlong JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_submitNative(JNIEnv* env, jobject, jstring prompt, jint max_tokens, jobject callback);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelNative(JNIEnv* env, jobject, jlong handle);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_saveSessionNative(JNIEnv* env, jobject, jstring dir, jstring session_id);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_restoreSessionNative(JNIEnv* env, jobject, jstring dir, jstring session_id);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion(JNIEnv* env, jobject);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_isGpuEnabled(JNIEnv* env, jobject);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_isOpenCLAvailable(JNIEnv* env, jobject);
+    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstring text);
+    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatch(JNIEnv* env, jobject, jobjectArray texts);
+    JNIEXPORT jbyteArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embedEncoded(JNIEnv* env, jobject, jstring text, jint dims, jint encoding);
+    JNIEXPORT jbyteArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatchEncoded(JNIEnv* env, jobject, jobjectArray texts, jint dims, jint encoding);
+    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_scoreEncoded(JNIEnv* env, jobject, jbyteArray query, jbyteArray rows, jint dims, jint encoding);
+    JNIEXPORT jobjectArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embedChunks(JNIEnv* env, jobject, jstring text, jint window_tokens, jint overlap_tokens);
+    JNIEXPORT jfloatArray JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_embedPooled(JNIEnv* env, jobject, jstring text, jint window_tokens, jint overlap_tokens, jboolean weighted);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingPipelineNative(JNIEnv* env, jobject, jobject callback, jstring cacheDir);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_enqueueEmbeddingNative(JNIEnv* env, jobject, jstring id, jstring text, jlong version);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelEmbeddingNative(JNIEnv* env, jobject, jstring id);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_LlamaContext_unload(JNIEnv* env, jobject);
 
-        llama_token new_token_id = llama_sampler_sample(sampler, g_context, -1);
+    JNIEXPORT jlong JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeOpen(JNIEnv* env, jobject, jstring path, jint dim, jboolean quantized);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeAdd(JNIEnv* env, jobject, jlong handle, jstring id, jfloatArray vector);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeRemove(JNIEnv* env, jobject, jlong handle, jstring id);
+    JNIEXPORT jobjectArray JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSearch(JNIEnv* env, jobject, jlong handle, jfloatArray query, jint k, jfloatArray scores_out);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSave(JNIEnv* env, jobject, jlong handle, jstring path);
+    JNIEXPORT jint JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSize(JNIEnv* env, jobject, jlong handle);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeClose(JNIEnv* env, jobject, jlong handle);
+    JNIEXPORT jlong JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeOpen(JNIEnv* env, jobject, jstring path);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeAdd(JNIEnv* env, jobject, jlong handle, jstring id, jstring text);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeRemove(JNIEnv* env, jobject, jlong handle, jstring id);
+    JNIEXPORT jobjectArray JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearch(JNIEnv* env, jobject, jlong handle, jstring query, jint k, jfloatArray scores_out);
+    JNIEXPORT jobjectArray JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearchHybrid(JNIEnv* env, jobject, jlong handle, jstring query, jint k, jobjectArray vector_ids, jfloatArray vector_scores, jfloat alpha, jfloatArray scores_out);
+    JNIEXPORT jboolean JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSave(JNIEnv* env, jobject, jlong handle, jstring path);
+    JNIEXPORT jint JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSize(JNIEnv* env, jobject, jlong handle);
+    JNIEXPORT void JNICALL Java_com_synapsenotes_ai_core_ai_TextIndex_nativeClose(JNIEnv* env, jobject, jlong handle);
+}
 
-        if (llama_vocab_is_eog(vocab, new_token_id)) {
-            break;
-        }
+extern "C" JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM* vm, void* reserved) {
+    __android_log_print(ANDROID_LOG_INFO, TAG, "JNI_OnLoad: Initializing llama.cpp backend [Build: 2026-01-21 v5 - Dynamic Config + Stop]");
+    
+    JNIEnv* env;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    g_vm = vm;
+
+    // Register natives explicitly to avoid UnsatisfiedLinkError issues
+    jclass clazz = env->FindClass("com/synapsenotes/ai/core/ai/LlamaContext");
+    if (clazz == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to find LlamaContext class");
+        return JNI_ERR;
+    }
+
+    JNINativeMethod methods[] = {
+        {"loadModelNative", "(Ljava/lang/String;Ljava/lang/String;IIZI)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative},
+        {"getBackendProfileKeyNative", "(Ljava/lang/String;)Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getBackendProfileKeyNative},
+        {"benchmarkBackendNative", "()[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_benchmarkBackendNative},
+        {"getOffloadPlanNative", "()[J", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getOffloadPlanNative},
+        {"startModelLoadNative", "(Ljava/lang/String;Ljava/lang/String;IIZILcom/synapsenotes/ai/core/ai/ModelLoadCallback;)J", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_startModelLoadNative},
+        {"startEmbeddingModelLoadNative", "(Ljava/lang/String;ZLcom/synapsenotes/ai/core/ai/ModelLoadCallback;)J", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingModelLoadNative},
+        {"cancelModelLoadNative", "(J)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelModelLoadNative},
+        {"loadEmbeddingModelNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative},
+        {"loadDraftModelNative", "(Ljava/lang/String;I)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadDraftModelNative},
+        {"unloadDraftModelNative", "()V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadDraftModelNative},
+        {"getSpeculativeStats", "()[I", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getSpeculativeStats},
+        {"setPromptLookupNative", "(II)V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_setPromptLookupNative},
+        {"setContextShiftNative", "(Z)V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_setContextShiftNative},
+        {"setDecodeGovernorNative", "(Z)V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_setDecodeGovernorNative},
+        {"loadLoraAdapterNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_loadLoraAdapterNative},
+        {"setLoraAdaptersNative", "([Ljava/lang/String;[F)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_setLoraAdaptersNative},
+        {"unloadLoraAdapterNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadLoraAdapterNative},
+        {"inspectModelNative", "(Ljava/lang/String;I)Lcom/synapsenotes/ai/core/ai/ModelInfo;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_inspectModelNative},
+        {"setMemoryBudgetNative", "(J)V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_setMemoryBudgetNative},
+        {"getMemoryPlanNative", "()[J", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getMemoryPlanNative},
+        {"getLastGenerationStatsNative", "()Lcom/synapsenotes/ai/core/ai/GenerationStats;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastGenerationStatsNative},
+        {"getLastEmbeddingStatsNative", "()Lcom/synapsenotes/ai/core/ai/EmbeddingStats;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastEmbeddingStatsNative},
+        {"startTraceNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_startTraceNative},
+        {"stopTraceNative", "()Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_stopTraceNative},
+        {"completion", "(Ljava/lang/String;Lcom/synapsenotes/ai/core/ai/LlmCallback;)Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_completion},
+        {"assemblePromptNative", "(Ljava/lang/String;[Ljava/lang/String;I)Lcom/synapsenotes/ai/core/ai/AssembledPrompt;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_assemblePromptNative},
+        {"completionTokens", "([ILcom/synapsenotes/ai/core/ai/LlmCallback;)Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_completionTokens},
+        {"submitNative", "(Ljava/lang/String;ILcom/synapsenotes/ai/core/ai/LlmRequestCallback;)J", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_submitNative},
+        {"cancelNative", "(J)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelNative},
+        {"saveSessionNative", "(Ljava/lang/String;Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_saveSessionNative},
+        {"restoreSessionNative", "(Ljava/lang/String;Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_restoreSessionNative},
+        {"stopCompletion", "()V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion},
+        {"isGpuEnabled", "()Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_isGpuEnabled},
+        {"isOpenCLAvailable", "()Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_isOpenCLAvailable},
+        {"embed", "(Ljava/lang/String;)[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embed},
+        {"embedBatch", "([Ljava/lang/String;)[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatch},
+        {"embedEncoded", "(Ljava/lang/String;II)[B", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embedEncoded},
+        {"embedBatchEncoded", "([Ljava/lang/String;II)[B", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatchEncoded},
+        {"scoreEncoded", "([B[BII)[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_scoreEncoded},
+        {"embedChunks", "(Ljava/lang/String;II)[Lcom/synapsenotes/ai/core/ai/EmbeddingChunk;", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embedChunks},
+        {"embedPooled", "(Ljava/lang/String;IIZ)[F", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_embedPooled},
+        {"startEmbeddingPipelineNative", "(Lcom/synapsenotes/ai/core/ai/EmbeddingPipelineCallback;Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingPipelineNative},
+        {"enqueueEmbeddingNative", "(Ljava/lang/String;Ljava/lang/String;J)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_enqueueEmbeddingNative},
+        {"cancelEmbeddingNative", "(Ljava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelEmbeddingNative},
+        {"unload", "()V", (void*)Java_com_synapsenotes_ai_core_ai_LlamaContext_unload}
+    };
+
+    if (env->RegisterNatives(clazz, methods, sizeof(methods) / sizeof(methods[0])) < 0) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to register native methods");
+        return JNI_ERR;
+    }
+
+    jclass generationStatsClazz = env->FindClass("com/synapsenotes/ai/core/ai/GenerationStats");
+    jclass embeddingStatsClazz = env->FindClass("com/synapsenotes/ai/core/ai/EmbeddingStats");
+    if (generationStatsClazz == nullptr || embeddingStatsClazz == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to find stats classes");
+        return JNI_ERR;
+    }
+    g_generation_stats_class = (jclass) env->NewGlobalRef(generationStatsClazz);
+    g_generation_stats_ctor = env->GetMethodID(generationStatsClazz, "<init>", "(Ljava/lang/String;IIIIIIIIIIIDDDDDIIIIDDZ)V");
+    g_embedding_stats_class = (jclass) env->NewGlobalRef(embeddingStatsClazz);
+    g_embedding_stats_ctor = env->GetMethodID(embeddingStatsClazz, "<init>", "(IIID)V");
+
+    jclass indexClazz = env->FindClass("com/synapsenotes/ai/core/ai/VectorIndex");
+    if (indexClazz == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to find VectorIndex class");
+        return JNI_ERR;
+    }
+
+    JNINativeMethod indexMethods[] = {
+        {"nativeOpen", "(Ljava/lang/String;IZ)J", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeOpen},
+        {"nativeAdd", "(JLjava/lang/String;[F)V", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeAdd},
+        {"nativeRemove", "(JLjava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeRemove},
+        {"nativeSearch", "(J[FI[F)[Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSearch},
+        {"nativeSave", "(JLjava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSave},
+        {"nativeSize", "(J)I", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSize},
+        {"nativeClose", "(J)V", (void*)Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeClose}
+    };
+
+    if (env->RegisterNatives(indexClazz, indexMethods, sizeof(indexMethods) / sizeof(indexMethods[0])) < 0) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to register VectorIndex native methods");
+        return JNI_ERR;
+    }
+
+    jclass textIndexClazz = env->FindClass("com/synapsenotes/ai/core/ai/TextIndex");
+    if (textIndexClazz == nullptr) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to find TextIndex class");
+        return JNI_ERR;
+    }
+
+    JNINativeMethod textIndexMethods[] = {
+        {"nativeOpen", "(Ljava/lang/String;)J", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeOpen},
+        {"nativeAdd", "(JLjava/lang/String;Ljava/lang/String;)V", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeAdd},
+        {"nativeRemove", "(JLjava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeRemove},
+        {"nativeSearch", "(JLjava/lang/String;I[F)[Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearch},
+        {"nativeSearchHybrid", "(JLjava/lang/String;I[Ljava/lang/String;[FF[F)[Ljava/lang/String;", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearchHybrid},
+        {"nativeSave", "(JLjava/lang/String;)Z", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSave},
+        {"nativeSize", "(J)I", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSize},
+        {"nativeClose", "(J)V", (void*)Java_com_synapsenotes_ai_core_ai_TextIndex_nativeClose}
+    };
+
+    if (env->RegisterNatives(textIndexClazz, textIndexMethods, sizeof(textIndexMethods) / sizeof(textIndexMethods[0])) < 0) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to register TextIndex native methods");
+        return JNI_ERR;
+    }
+
+    llama_backend_init();
+    llama_log_set(android_log_callback, nullptr);
+    return JNI_VERSION_1_6;
+}
+
+// CPU thread layout of this device (see cpu_topology.h), read once
+static const ThreadPlan& thread_plan() {
+    static const ThreadPlan plan = [] {
+        const CpuTopology topology = read_cpu_topology();
+        ThreadPlan p = plan_threads(topology);
+        __android_log_print(ANDROID_LOG_INFO, TAG, "CPU topology: %s; decode %d threads, prefill %d threads",
+                            describe_topology(topology).c_str(), p.n_threads_decode, p.n_threads_batch);
+        return p;
+    }();
+    return plan;
+}
+
+// ggml CPU thread pools, created on first use and kept for the life of the process; contexts only
+// borrow them. Decode threads are pinned one per performance core and spin briefly between tokens;
+// prefill and embedding spread over every core. Embedding is background work, so its pool runs
+// SCHED_BATCH.
+struct ThreadPools {
+    ggml_threadpool_t decode = nullptr;
+    ggml_threadpool_t batch = nullptr;
+    ggml_threadpool_t embed = nullptr;
+};
+
+static const ThreadPools& thread_pools() {
+    static const ThreadPools pools = [] {
+        const ThreadPlan& plan = thread_plan();
+        ThreadPools p;
+        p.decode = make_threadpool(plan.decode_cpus, plan.n_threads_decode, true, GGML_SCHED_PRIO_NORMAL, 50);
+        p.batch = make_threadpool(plan.batch_cpus, plan.n_threads_batch, false, GGML_SCHED_PRIO_NORMAL, 0);
+        p.embed = make_threadpool(plan.batch_cpus, plan.n_threads_batch, false, GGML_SCHED_PRIO_LOW, 0);
+        if (!p.decode || !p.batch || !p.embed) {
+            __android_log_print(ANDROID_LOG_WARN, TAG, "Could not create CPU thread pools, using ggml's defaults");
+        }
+        return p;
+    }();
+    return pools;
+}
+
+// Governor for the loaded chat context, starting from its full thread count and batch size
+static std::unique_ptr<DecodeGovernor> make_governor() {
+    if (!g_governor_enabled || !g_context) return nullptr;
+    GovernorConfig config;
+    config.max_threads = thread_plan().n_threads_decode;
+    config.min_threads = std::min(2, config.max_threads);
+    config.max_batch = llama_n_batch(g_context);
+    std::unique_ptr<DecodeGovernor> governor(new DecodeGovernor(config));
+    if (!governor->has_sensor()) {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Decode governor: no thermal zone readable, pacing on latency alone");
+    }
+    return governor;
+}
+
+// Put the governor's thread count into effect. It applies to scheduled requests on the shared
+// context too, which run on the same overheating cores. With strict placement the threads dropped
+// are those on the highest-numbered cores, the prime cores on current SoCs. GPU backends keep theirs.
+static void apply_governor(const char* reason) {
+    if (!g_gpu_enabled) {
+        llama_set_n_threads(g_context, g_governor->n_threads(), thread_plan().n_threads_batch);
+    }
+    TraceRecorder::global().counter("governor_level", g_governor->level());
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Decode governor (%s): level %d, %d threads, prefill chunk %d, %.1f C",
+                        reason, g_governor->level(), g_governor->n_threads(), g_governor->n_batch(), g_governor->temperature());
+}
+
+// Memory-mapped, the embedding model's weights stay file-backed page cache: pages come in on first use
+// (llama.cpp advises WILLNEED over the mapping) and can be evicted under pressure instead of pinning
+// a private copy of the file. With GPU offload the uploaded ranges are unmapped after the copy.
+static bool load_embedding_model(const char* model_path, bool use_mmap, ModelLoad* load) {
+    std::lock_guard<std::mutex> embed_lock(g_embed_mutex);
+    g_embed_cache.reset();
+    g_embed_model_hash = compute_model_hash(model_path);
+
+    if (g_context_embed) {
+        llama_free(g_context_embed);
+        g_context_embed = nullptr;
+    }
+    if (g_model_embed) {
+        llama_model_free(g_model_embed);
+        g_model_embed = nullptr;
+    }
+
+    struct llama_model_params model_params = llama_model_default_params();
+    model_params.use_mmap = use_mmap;
+    track_model_load(model_params, model_path, load);
+
+    // OpenCL, then Vulkan, then CPU, each picked through model_params.devices like the chat model.
+    // Hiding backends with GGML_*_DISABLE instead would be process-wide and could leak into a chat
+    // model load running at the same time. Known problematic SoCs go straight to CPU.
+    static const int EMBED_BACKENDS[] = {BACKEND_OPENCL, BACKEND_VULKAN, BACKEND_CPU};
+    const bool cpu_only = is_problematic_vulkan_device();
+    if (cpu_only) {
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Problematic SoC detected - forcing CPU for embedding model to avoid driver crash");
+    }
+    std::vector<ggml_backend_dev_t> devices;
+    for (int backend_id : EMBED_BACKENDS) {
+        if (cpu_only && backend_id != BACKEND_CPU) continue;
+        if (!backend_devices(backend_id, devices)) continue;
+        model_params.devices = devices.data();
+        model_params.n_gpu_layers = backend_id == BACKEND_CPU ? 0 : -1;
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Loading embedding model on %s", BACKEND_NAMES[backend_id]);
+        g_model_embed = llama_model_load_from_file(model_path, model_params);
+        if (g_model_embed || (load && load->cancelled)) break;
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Embedding model failed on %s", BACKEND_NAMES[backend_id]);
+    }
+
+    if (!g_model_embed) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, load && load->cancelled ? "Embedding model load cancelled" : "Failed to load embedding model with all backends");
+        return false;
+    }
+
+    struct llama_context_params ctx_params = embedding_context_params();
+    ctx_params.n_threads = thread_plan().n_threads_batch; // Embedding is all batch work
+    ctx_params.n_threads_batch = thread_plan().n_threads_batch;
+    g_context_embed = llama_init_from_model(g_model_embed, ctx_params);
+    if (!g_context_embed) {
+         llama_model_free(g_model_embed);
+         g_model_embed = nullptr;
+         return false;
+    }
+    llama_attach_threadpool(g_context_embed, thread_pools().embed, thread_pools().embed);
+    
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Embedding model loaded successfully");
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_loadEmbeddingModelNative(JNIEnv* env, jobject, jstring path) {
+    std::string model_path = jstring_to_std(env, path);
+    return load_embedding_model(model_path.c_str(), true, nullptr) ? JNI_TRUE : JNI_FALSE;
+}
+
+static ggml_type kv_cache_ggml_type(KvCacheType type) {
+    switch (type) {
+        case KV_CACHE_Q8_0: return GGML_TYPE_Q8_0;
+        case KV_CACHE_Q4_0: return GGML_TYPE_Q4_0;
+        default:            return GGML_TYPE_F16;
+    }
+}
+
+// Call with g_context_mutex held
+static void free_draft_model() {
+    if (g_context_draft) {
+        llama_free(g_context_draft);
+        g_context_draft = nullptr;
+    }
+    if (g_model_draft) {
+        llama_model_free(g_model_draft);
+        g_model_draft = nullptr;
+    }
+    g_draft_cached_tokens.clear();
+    g_n_draft = 0;
+}
+
+// Load a small model that proposes n_draft tokens per step for the chat model to verify.
+// Uses the backend devices, KV cache type and flash attention setting the chat model ended up
+// with; the chat model must be loaded first.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_loadDraftModelNative(JNIEnv* env, jobject, jstring path, jint n_draft) {
+    {
+        std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+        free_draft_model();
+    }
+    if (!g_model || !g_context || n_draft <= 0) return JNI_FALSE;
+
+    // Only the chat model's devices: llama.cpp would otherwise offload to every GPU device,
+    // including a backend the ranking rejected or that crashes on this SoC
+    std::vector<ggml_backend_dev_t> devices;
+    if (!backend_devices(g_gpu_enabled ? g_backend_id : BACKEND_CPU, devices)) return JNI_FALSE;
+
+    // Loaded outside the lock, which scheduled requests need meanwhile, and swapped in under it
+    const char* model_path = env->GetStringUTFChars(path, nullptr);
+    struct llama_model_params model_params = llama_model_default_params();
+    model_params.devices = devices.data();
+    model_params.n_gpu_layers = g_gpu_enabled ? -1 : 0;
+    llama_model* model = llama_model_load_from_file(model_path, model_params);
+    env->ReleaseStringUTFChars(path, model_path);
+
+    if (!model) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to load draft model");
+        return JNI_FALSE;
+    }
+    if (!vocabs_compatible(llama_model_get_vocab(g_model), llama_model_get_vocab(model))) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Draft model vocabulary does not match the chat model");
+        llama_model_free(model);
+        return JNI_FALSE;
+    }
+
+    struct llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = llama_n_ctx(g_context);
+    ctx_params.n_batch = llama_n_batch(g_context);
+    ctx_params.n_threads = thread_plan().n_threads_decode;
+    ctx_params.n_threads_batch = thread_plan().n_threads_batch;
+    // Quantized like the chat's, so the draft KV cache stays in proportion to the memory plan
+    if (g_context_plan.n_ctx > 0) {
+        ctx_params.type_k = kv_cache_ggml_type(g_context_plan.kv_type);
+        ctx_params.type_v = kv_cache_ggml_type(g_context_plan.kv_type);
+        if (g_context_plan.flash_attn) ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    }
+
+    llama_context* ctx = llama_init_from_model(model, ctx_params);
+    if (!ctx) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to create the draft model context");
+        llama_model_free(model);
+        return JNI_FALSE;
+    }
+    // Drafting and verification alternate on one thread, so the chat model's pools can be shared
+    llama_attach_threadpool(ctx, thread_pools().decode, thread_pools().batch);
+
+    {
+        std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+        g_model_draft = model;
+        g_context_draft = ctx;
+        g_n_draft = n_draft;
+    }
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Draft model loaded, proposing up to %d tokens per step", n_draft);
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadDraftModelNative(JNIEnv* env, jobject) {
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    free_draft_model();
+}
+
+// Configure prompt-lookup speculation for following completions; ngram_max <= 0 disables it
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_setPromptLookupNative(JNIEnv* env, jobject, jint ngram_max, jint n_draft) {
+    g_lookup_ngram_max = ngram_max > 0 ? ngram_max : 0;
+    g_lookup_n_draft = n_draft > 0 ? n_draft : 0;
+}
+
+// Enable or disable context shifting for following completions and submitted requests
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_setContextShiftNative(JNIEnv* env, jobject, jboolean enabled) {
+    g_context_shift = enabled == JNI_TRUE;
+}
+
+// Enable or disable the decode governor for following completions; disabling restores the full
+// decode thread count
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_setDecodeGovernorNative(JNIEnv* env, jobject, jboolean enabled) {
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    g_governor_enabled = enabled == JNI_TRUE;
+    if (!g_context) return;
+    if (g_governor_enabled) {
+        if (!g_governor) g_governor = make_governor();
+    } else if (g_governor) {
+        g_governor.reset();
+        llama_set_n_threads(g_context, thread_plan().n_threads_decode, thread_plan().n_threads_batch);
+    }
+}
+
+// Load the LoRA adapter at path against the chat model, unless it is loaded already. It does not
+// take effect until activated with setLoraAdaptersNative.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_loadLoraAdapterNative(JNIEnv* env, jobject, jstring path) {
+    if (!g_model) return JNI_FALSE;
+    const std::string adapter_path = jstring_to_std(env, path);
+
+    std::lock_guard<std::mutex> lora_lock(g_lora_mutex);
+    if (g_lora_adapters.count(adapter_path)) return JNI_TRUE;
+
+    const int64_t t_start = monotonic_us();
+    llama_adapter_lora* adapter = llama_adapter_lora_init(g_model, adapter_path.c_str());
+    if (!adapter) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to load LoRA adapter %s", adapter_path.c_str());
+        return JNI_FALSE;
+    }
+    struct stat st;
+    LoraAdapter& entry = g_lora_adapters[adapter_path];
+    entry.adapter = adapter;
+    entry.bytes = stat(adapter_path.c_str(), &st) == 0 ? (uint64_t) st.st_size : 0;
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Loaded LoRA adapter %s (%.1f MB) in %.1f ms", adapter_path.c_str(),
+                        entry.bytes / (1024.0 * 1024.0), (monotonic_us() - t_start) / 1000.0);
+    return JNI_TRUE;
+}
+
+// Activate the loaded adapters at paths with the given scales, replacing the active set; empty
+// arrays return to the base model. Unless the set is unchanged this drops the KV cache, since cached
+// tokens were computed with other weights, and scheduled requests re-prefill under the new set.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_setLoraAdaptersNative(JNIEnv* env, jobject, jobjectArray paths, jfloatArray scales) {
+    if (!g_context) return JNI_FALSE;
+    const int n_adapters = env->GetArrayLength(paths);
+    if (env->GetArrayLength(scales) != n_adapters) return JNI_FALSE;
+
+    // A zero scale leaves the adapter out
+    std::vector<std::pair<std::string, float>> requested;
+    std::vector<float> scale_values(n_adapters);
+    env->GetFloatArrayRegion(scales, 0, n_adapters, scale_values.data());
+    for (int i = 0; i < n_adapters; i++) {
+        jstring path = (jstring) env->GetObjectArrayElement(paths, i);
+        if (scale_values[i] != 0.0f) requested.emplace_back(jstring_to_std(env, path), scale_values[i]);
+        env->DeleteLocalRef(path);
+    }
+
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    std::lock_guard<std::mutex> lora_lock(g_lora_mutex);
+    if (requested == g_lora_active) return JNI_TRUE;
+    for (const auto& entry : requested) {
+        if (!g_lora_adapters.count(entry.first)) {
+            __android_log_print(ANDROID_LOG_ERROR, TAG, "LoRA adapter %s is not loaded", entry.first.c_str());
+            return JNI_FALSE;
+        }
+    }
+
+    llama_clear_adapter_lora(g_context);
+    bool ok = true;
+    for (const auto& entry : requested) {
+        if (llama_set_adapter_lora(g_context, g_lora_adapters[entry.first].adapter, entry.second) != 0) {
+            // Fall back to the base model rather than run a partial set
+            __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to activate LoRA adapter %s", entry.first.c_str());
+            llama_clear_adapter_lora(g_context);
+            requested.clear();
+            ok = false;
+            break;
+        }
+    }
+    g_lora_active = requested;
+    g_lora_hash = lora_set_hash(g_lora_active);
+
+    llama_memory_seq_rm(llama_get_memory(g_context), -1, -1, -1);
+    g_cached_tokens.clear();
+    g_context_epoch++;
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Active LoRA adapters: %zu", g_lora_active.size());
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+// Free a loaded adapter, deactivating it first if it is active
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_unloadLoraAdapterNative(JNIEnv* env, jobject, jstring path) {
+    const std::string adapter_path = jstring_to_std(env, path);
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    std::lock_guard<std::mutex> lora_lock(g_lora_mutex);
+    auto it = g_lora_adapters.find(adapter_path);
+    if (it == g_lora_adapters.end()) return JNI_FALSE;
+
+    auto active = std::find_if(g_lora_active.begin(), g_lora_active.end(),
+                               [&](const std::pair<std::string, float>& e) { return e.first == adapter_path; });
+    if (active != g_lora_active.end()) {
+        if (g_context) {
+            llama_rm_adapter_lora(g_context, it->second.adapter);
+            llama_memory_seq_rm(llama_get_memory(g_context), -1, -1, -1);
+            g_cached_tokens.clear();
+            g_context_epoch++;
+        }
+        g_lora_active.erase(active);
+        g_lora_hash = lora_set_hash(g_lora_active);
+    }
+    llama_adapter_lora_free(it->second.adapter);
+    g_lora_adapters.erase(it);
+    return JNI_TRUE;
+}
+
+// Metadata, tensor type breakdown and memory estimate of the model at path, read from its GGUF header
+// without loading it (see gguf_inspector.h). kvCacheBytes is the f16 cache for n_ctx, or for the
+// training context length when n_ctx <= 0. A damaged file yields a ModelInfo with valid false and
+// the reason in error. Needs no loaded model.
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_inspectModelNative(JNIEnv* env, jobject, jstring path, jint n_ctx) {
+    const int64_t t_start = monotonic_us();
+    const std::string model_path = jstring_to_std(env, path);
+    GgufInfo gguf;
+    const bool valid = inspect_gguf(model_path, gguf);
+
+    const std::string arch = gguf.get_string("general.architecture");
+    const int n_ctx_train = (int) gguf.get_int(arch + ".context_length", 0);
+    const int n_head = (int) gguf.get_layer_int(arch + ".attention.head_count", 0, 0);
+    const int n_ctx_estimate = n_ctx > 0 ? n_ctx : n_ctx_train;
+    ModelFootprint footprint;
+    uint64_t kv_bytes = 0;
+    if (valid && n_ctx_estimate > 0 && read_model_footprint(gguf, n_ctx_estimate, footprint)) {
+        for (uint64_t bytes : footprint.layer_kv_bytes) kv_bytes += bytes;
+    }
+
+    // Weight bytes per tensor type, largest first
+    uint64_t weight_bytes = 0;
+    std::vector<std::pair<uint64_t, ggml_type>> by_type;
+    for (const GgufTensor& tensor : gguf.tensors) {
+        weight_bytes += tensor.bytes;
+        auto it = std::find_if(by_type.begin(), by_type.end(), [&](const std::pair<uint64_t, ggml_type>& e) { return e.second == tensor.type; });
+        if (it == by_type.end()) {
+            by_type.emplace_back(tensor.bytes, tensor.type);
+        } else {
+            it->first += tensor.bytes;
+        }
+    }
+    std::sort(by_type.rbegin(), by_type.rend());
+
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray typeNames = env->NewObjectArray(by_type.size(), stringClass, nullptr);
+    std::vector<jlong> type_bytes(by_type.size());
+    for (size_t i = 0; i < by_type.size(); i++) {
+        jstring name = env->NewStringUTF(ggml_type_name(by_type[i].second));
+        env->SetObjectArrayElement(typeNames, i, name);
+        env->DeleteLocalRef(name);
+        type_bytes[i] = (jlong) by_type[i].first;
+    }
+    jlongArray typeBytes = env->NewLongArray(type_bytes.size());
+    env->SetLongArrayRegion(typeBytes, 0, type_bytes.size(), type_bytes.data());
+
+    const std::string chat_template = gguf.get_string("tokenizer.chat_template");
+    jstring jArch = env->NewStringUTF(arch.c_str());
+    jstring jName = new_jstring_utf8(env, gguf.get_string("general.name"));
+    jstring jTemplate = chat_template.empty() ? nullptr : new_jstring_utf8(env, chat_template);
+    jstring jError = env->NewStringUTF(gguf.error.c_str());
+
+    jclass infoClass = env->FindClass("com/synapsenotes/ai/core/ai/ModelInfo");
+    jmethodID infoCtor = env->GetMethodID(infoClass, "<init>",
+            "(ZLjava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;IIIIIII[Ljava/lang/String;[JJJIJ)V");
+    jobject info = env->NewObject(infoClass, infoCtor, valid ? JNI_TRUE : JNI_FALSE, jError, jArch, jName, jTemplate,
+                                  (jint) n_ctx_train, (jint) gguf.get_int(arch + ".block_count", 0),
+                                  (jint) gguf.get_int(arch + ".embedding_length", 0), (jint) n_head,
+                                  (jint) gguf.get_layer_int(arch + ".attention.head_count_kv", 0, n_head),
+                                  (jint) gguf.array_length("tokenizer.ggml.tokens"), (jint) gguf.tensors.size(),
+                                  typeNames, typeBytes, (jlong) weight_bytes, (jlong) kv_bytes, (jint) n_ctx_estimate,
+                                  (jlong) gguf.file_bytes);
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Inspected %s in %.1f ms: %s", model_path.c_str(),
+                        (monotonic_us() - t_start) / 1000.0, valid ? arch.c_str() : gguf.error.c_str());
+    return info;
+}
+
+// GenerationStats of the last completion() call, or null if there is none
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastGenerationStatsNative(JNIEnv* env, jobject) {
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    if (!g_has_last_stats) return nullptr;
+    return new_generation_stats(env, g_last_stats);
+}
+
+// EmbeddingStats of the last embed, embedBatch, embedChunks or embedPooled call, or null
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getLastEmbeddingStatsNative(JNIEnv* env, jobject) {
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    if (!g_has_last_embed_stats) return nullptr;
+    const EmbedCallStats& stats = g_last_embed_stats;
+    return env->NewObject(g_embedding_stats_class, g_embedding_stats_ctor, (jint) stats.n_texts,
+                          (jint) stats.work.n_tokens, (jint) stats.work.n_decodes, stats.total_ms);
+}
+
+// Record trace events (see trace.h) until stopTraceNative, which writes them to path
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_startTraceNative(JNIEnv* env, jobject, jstring path) {
+    std::string trace_path = jstring_to_std(env, path);
+    if (!TraceRecorder::global().start(trace_path)) return JNI_FALSE;
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Trace recording to %s", trace_path.c_str());
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_stopTraceNative(JNIEnv* env, jobject) {
+    return TraceRecorder::global().stop() ? JNI_TRUE : JNI_FALSE;
+}
+
+// [drafted, accepted] token counts of the last completion() call
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getSpeculativeStats(JNIEnv* env, jobject) {
+    jint stats[2] = {g_spec_drafted, g_spec_accepted};
+    jintArray result = env->NewIntArray(2);
+    env->SetIntArrayRegion(result, 0, 2, stats);
+    return result;
+}
+
+// Context size and KV cache type for the chat model. footprint holds the KV cache of one token. The
+// budget is shared with the embedding model, if loaded. Without a budget, n_ctx is kept with an
+// f16 cache as before.
+static ContextPlan plan_chat_context(const ModelFootprint& footprint, int n_batch, int n_ctx, bool allow_quantized) {
+    const uint64_t reserve = OFFLOAD_COMPUTE_RESERVE + (g_model_embed ? llama_model_size(g_model_embed) : 0);
+    const uint64_t reserve_per_ctx = (uint64_t) n_batch * sizeof(float);
+    const uint64_t budget = g_memory_budget.load();
+    if (budget == 0) {
+        ContextPlan plan = plan_context(footprint, UINT64_MAX, reserve, reserve_per_ctx, n_ctx, n_ctx, n_ctx, false);
+        plan.budget_bytes = 0;
+        return plan;
+    }
+    const int n_ctx_max = footprint.n_ctx_train > 0 ? std::min(footprint.n_ctx_train, CONTEXT_PLAN_MAX) : CONTEXT_PLAN_MAX;
+    return plan_context(footprint, budget, reserve, reserve_per_ctx, n_ctx, CONTEXT_PLAN_MIN, n_ctx_max, allow_quantized);
+}
+
+static void log_context_plan(const ContextPlan& plan) {
+    static const char* KV_TYPE_NAMES[] = {"f16", "q8_0", "q4_0"};
+    __android_log_print(plan.fits || plan.budget_bytes == 0 ? ANDROID_LOG_INFO : ANDROID_LOG_WARN, TAG,
+                        "Context plan: n_ctx %d, %s KV cache (%.0f MB), flash attention %s, weights %.0f MB, reserved %.0f MB, budget %.0f MB%s",
+                        plan.n_ctx, KV_TYPE_NAMES[plan.kv_type], plan.kv_bytes / 1048576.0, plan.flash_attn ? "on" : "auto",
+                        plan.weight_bytes / 1048576.0, plan.reserved_bytes / 1048576.0, plan.budget_bytes / 1048576.0,
+                        plan.fits ? "" : " (over budget)");
+}
+
+// Stop the batch scheduler, then free the chat model and its context under g_context_mutex, which
+// submitNative checks them under. The scheduler is destroyed outside the lock: its worker takes
+// the lock until it has exited.
+static void free_chat_model() {
+    std::unique_ptr<BatchScheduler> scheduler;
+    {
+        std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+        scheduler = std::move(g_scheduler);
+    }
+    scheduler.reset();
+
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    free_draft_model();
+    if (g_context) {
+        llama_free(g_context);
+        g_context = nullptr;
+    }
+    if (g_model) {
+        llama_model_free(g_model);
+        g_model = nullptr;
+    }
+    g_cached_tokens.clear();
+    g_pinned_prefix.clear();
+}
+
+static bool load_chat_model(const char* model_path, const char* chat_template, int n_batch, int n_ctx, bool use_mmap, int backend_id, ModelLoad* load) {
+    // The embedding pipeline falls back to the chat model when no embedding model is loaded
+    std::lock_guard<std::mutex> embed_lock(g_embed_mutex);
+    if (chat_template != nullptr) {
+        g_chat_template = chat_template;
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Loaded custom chat template");
+    } else {
+        g_chat_template = "";
+    }
+
+    free_chat_model();
+    {
+        std::lock_guard<std::mutex> assembler_lock(g_assembler_mutex);
+        g_prompt_assembler.reset();
+    }
+    g_model_hash = compute_model_hash(model_path);
+    g_governor.reset();
+    forget_lora_adapters();
+
+    // Load on exactly the requested backend. Choosing and falling back between backends is the
+    // caller's job (LlmEngine ranks them by measured speed), so a failure costs one load, not three.
+    if (backend_id < BACKEND_CPU || backend_id > BACKEND_OPENCL) backend_id = BACKEND_CPU;
+    if (backend_id != BACKEND_CPU && is_problematic_vulkan_device()) {
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Refusing %s backend on a SoC with known GPU driver crashes", BACKEND_NAMES[backend_id]);
+        return false;
+    }
+
+    std::vector<ggml_backend_dev_t> devices;
+    if (!backend_devices(backend_id, devices)) {
+        __android_log_print(ANDROID_LOG_WARN, TAG, "No %s device available", BACKEND_NAMES[backend_id]);
+        return false;
+    }
+
+    // A damaged or truncated file fails here in milliseconds instead of partway through the load
+    GgufInfo gguf;
+    if (!inspect_gguf(model_path, gguf)) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Cannot load %s: %s", model_path, gguf.error.c_str());
+        return false;
+    }
+
+    struct llama_model_params model_params = llama_model_default_params();
+    model_params.use_mmap = use_mmap;
+    model_params.devices = devices.data();
+    model_params.n_gpu_layers = backend_id == BACKEND_CPU ? 0 : -1;
+
+    // Offload only what fits: a model larger than GPU memory would otherwise fail to load or get
+    // the app killed. Without a readable header, fall back to a full offload as before.
+    static llama_model_tensor_buft_override ffn_overrides[] = {{nullptr, nullptr}, {nullptr, nullptr}};
+    ModelFootprint token_footprint; // KV cache of one token, kept for re-planning
+    ModelFootprint footprint;
+    g_offload_plan = OffloadPlan();
+    g_context_plan = ContextPlan();
+    if (read_model_footprint(gguf, 1, token_footprint)) {
+        g_context_plan = plan_chat_context(token_footprint, n_batch, n_ctx, true);
+        n_ctx = g_context_plan.n_ctx;
+        log_context_plan(g_context_plan);
+        footprint = token_footprint;
+        apply_context_plan(footprint, g_context_plan);
+
+        if (backend_id == BACKEND_CPU) {
+            g_offload_plan = plan_cpu_only(footprint);
+        } else {
+            const uint64_t reserve = OFFLOAD_COMPUTE_RESERVE + (g_context_plan.flash_attn ? 0 : (uint64_t) n_batch * n_ctx * sizeof(float));
+            g_offload_plan = plan_offload(footprint, offload_budget(devices[0]), reserve, true);
+            model_params.n_gpu_layers = g_offload_plan.n_gpu_layers;
+            if (g_offload_plan.n_cpu_ffn_layers > 0) {
+                g_offload_override_pattern = ffn_override_pattern(g_offload_plan.n_cpu_ffn_layers);
+                ffn_overrides[0] = {g_offload_override_pattern.c_str(), ggml_backend_cpu_buffer_type()};
+                model_params.tensor_buft_overrides = ffn_overrides;
+            }
+        }
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Offload plan: %d/%d layers on GPU (%d with CPU FFN), %.0f MB GPU, %.0f MB CPU, %.0f MB KV, budget %.0f MB",
+                            g_offload_plan.n_gpu_layers, g_offload_plan.n_layer, g_offload_plan.n_cpu_ffn_layers,
+                            g_offload_plan.gpu_bytes / 1048576.0, g_offload_plan.cpu_bytes / 1048576.0,
+                            g_offload_plan.kv_bytes / 1048576.0, g_offload_plan.budget_bytes / 1048576.0);
+    }
+
+    track_model_load(model_params, model_path, load);
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Loading model on %s backend...", BACKEND_NAMES[backend_id]);
+    g_model = llama_model_load_from_file(model_path, model_params);
+    g_gpu_enabled = g_model && backend_id != BACKEND_CPU && model_params.n_gpu_layers != 0;
+    g_backend_id = backend_id;
+
+    if (!g_model) {
+        if (load && load->cancelled) {
+            __android_log_print(ANDROID_LOG_INFO, TAG, "Model load cancelled");
+        } else {
+            __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to load model on %s backend", BACKEND_NAMES[backend_id]);
+        }
+        return false;
+    }
+
+    struct llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = n_ctx; 
+    ctx_params.n_batch = n_batch;
+    ctx_params.n_seq_max = 1 + SCHEDULER_SLOTS; // seq 0 for chat, the rest for scheduled requests
+    ctx_params.kv_unified = true;               // Sequences share one n_ctx pool instead of n_ctx / n_seq_max each
+    ctx_params.n_threads = thread_plan().n_threads_decode;
+    ctx_params.n_threads_batch = thread_plan().n_threads_batch;
+    if (g_context_plan.n_ctx > 0) {
+        ctx_params.type_k = kv_cache_ggml_type(g_context_plan.kv_type);
+        ctx_params.type_v = kv_cache_ggml_type(g_context_plan.kv_type);
+        if (g_context_plan.flash_attn) ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    }
+    
+    llama_context* ctx = llama_init_from_model(g_model, ctx_params);
+    if (!ctx && g_context_plan.kv_type != KV_CACHE_F16) {
+        // Not every backend has flash attention or quantized KV kernels
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Quantized KV cache unavailable on %s, retrying with f16", BACKEND_NAMES[backend_id]);
+        g_context_plan = plan_chat_context(token_footprint, n_batch, n_ctx, false);
+        log_context_plan(g_context_plan);
+        ctx_params.n_ctx = g_context_plan.n_ctx;
+        ctx_params.type_k = GGML_TYPE_F16;
+        ctx_params.type_v = GGML_TYPE_F16;
+        ctx_params.flash_attn_type = llama_context_default_params().flash_attn_type;
+        ctx = llama_init_from_model(g_model, ctx_params);
+    }
+    if (!ctx) {
+         llama_model_free(g_model);
+         g_model = nullptr;
+         g_gpu_enabled = false;
+         return false;
+    }
+    llama_attach_threadpool(ctx, thread_pools().decode, thread_pools().batch);
+
+    const std::string empty_prompt = format_chat_prompt("");
+    g_pinned_prefix = tokenize_text(llama_model_get_vocab(g_model), empty_prompt.c_str(), empty_prompt.size());
+    {
+        // Published together, so a submit sees either no model or a scheduler for this context
+        std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+        g_context = ctx;
+        g_scheduler.reset(new BatchScheduler(
+            g_context, g_context_mutex, g_context_epoch, g_chat_cells, 1, SCHEDULER_SLOTS,
+            scheduler_cells(llama_n_ctx(g_context)), CHAT_STOP_SEQUENCES,
+            [] {
+                set_thread_affinity(thread_plan().decode_cpus);
+                JNIEnv* thread_env = nullptr;
+                g_vm->AttachCurrentThread(&thread_env, nullptr);
+            },
+            [] { g_vm->DetachCurrentThread(); }));
+    }
+    g_governor = make_governor();
+
+    std::lock_guard<std::mutex> assembler_lock(g_assembler_mutex);
+    g_prompt_assembler = make_prompt_assembler();
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_loadModelNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id) {
+    std::string model_path = jstring_to_std(env, path);
+    std::string chat_template = template_str != nullptr ? jstring_to_std(env, template_str) : "";
+    return load_chat_model(model_path.c_str(), template_str != nullptr ? chat_template.c_str() : nullptr,
+                           n_batch, n_ctx, use_mmap, backend_id, nullptr) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Run a load on its own thread. callback gets onProgress(loadedBytes, totalBytes) while tensors are
+// read and exactly one onComplete(success, cancelled). Returns the handle for cancelModelLoadNative.
+static jlong start_model_load(JNIEnv* env, jobject callback, std::function<bool(ModelLoad*)> run) {
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onCompleteMethod = env->GetMethodID(callbackClass, "onComplete", "(ZZ)V");
+    std::shared_ptr<ModelLoad> load = std::make_shared<ModelLoad>();
+    load->on_progress = env->GetMethodID(callbackClass, "onProgress", "(JJ)V");
+    load->callback = env->NewGlobalRef(callback);
+
+    jlong handle;
+    {
+        std::lock_guard<std::mutex> lock(g_loads_mutex);
+        handle = g_next_load_handle++;
+        g_loads[handle] = load;
+    }
+
+    std::thread([load, handle, onCompleteMethod, run] {
+        JNIEnv* thread_env = nullptr;
+        g_vm->AttachCurrentThread(&thread_env, nullptr);
+        const bool success = run(load.get());
+        {
+            std::lock_guard<std::mutex> lock(g_loads_mutex);
+            g_loads.erase(handle);
+        }
+        thread_env->CallVoidMethod(load->callback, onCompleteMethod, success ? JNI_TRUE : JNI_FALSE,
+                                   !success && load->cancelled ? JNI_TRUE : JNI_FALSE);
+        thread_env->DeleteGlobalRef(load->callback);
+        g_vm->DetachCurrentThread();
+    }).detach();
+    return handle;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_startModelLoadNative(JNIEnv* env, jobject, jstring path, jstring template_str, jint n_batch, jint n_ctx, jboolean use_mmap, jint backend_id, jobject callback) {
+    std::string model_path = jstring_to_std(env, path);
+    const bool has_template = template_str != nullptr;
+    std::string chat_template = has_template ? jstring_to_std(env, template_str) : "";
+    return start_model_load(env, callback, [=](ModelLoad* load) {
+        return load_chat_model(model_path.c_str(), has_template ? chat_template.c_str() : nullptr,
+                               n_batch, n_ctx, use_mmap, backend_id, load);
+    });
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingModelLoadNative(JNIEnv* env, jobject, jstring path, jboolean use_mmap, jobject callback) {
+    std::string model_path = jstring_to_std(env, path);
+    return start_model_load(env, callback, [=](ModelLoad* load) {
+        return load_embedding_model(model_path.c_str(), use_mmap, load);
+    });
+}
+
+// Abort a load started by startModelLoadNative / startEmbeddingModelLoadNative. Takes effect at the
+// next tensor; false if the load already finished.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelModelLoadNative(JNIEnv* env, jobject, jlong handle) {
+    std::lock_guard<std::mutex> lock(g_loads_mutex);
+    auto it = g_loads.find(handle);
+    if (it == g_loads.end()) return JNI_FALSE;
+    it->second->cancelled = true;
+    return JNI_TRUE;
+}
+
+// [n_gpu_layers, n_layer, n_cpu_ffn_layers, gpu_bytes, cpu_bytes, kv_bytes, budget_bytes] of the loaded
+// chat model; empty if no model is loaded or its header could not be read
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getOffloadPlanNative(JNIEnv* env, jobject) {
+    if (!g_model || g_offload_plan.n_layer == 0) return env->NewLongArray(0);
+    const OffloadPlan& plan = g_offload_plan;
+    jlong values[7] = {plan.n_gpu_layers, plan.n_layer, plan.n_cpu_ffn_layers, (jlong) plan.gpu_bytes,
+                       (jlong) plan.cpu_bytes, (jlong) plan.kv_bytes, (jlong) plan.budget_bytes};
+    jlongArray result = env->NewLongArray(7);
+    env->SetLongArrayRegion(result, 0, 7, values);
+    return result;
+}
+
+// Memory budget for the next chat model loads (see g_memory_budget); <= 0 takes n_ctx as given
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_setMemoryBudgetNative(JNIEnv* env, jobject, jlong budget_bytes) {
+    g_memory_budget = budget_bytes > 0 ? (uint64_t) budget_bytes : 0;
+}
+
+// [n_ctx, kv_type, flash_attn, fits, kv_bytes, weight_bytes, reserved_bytes, budget_bytes] of the loaded
+// chat model; empty if no model is loaded or its header could not be read
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getMemoryPlanNative(JNIEnv* env, jobject) {
+    if (!g_model || g_context_plan.n_ctx == 0) return env->NewLongArray(0);
+    const ContextPlan& plan = g_context_plan;
+    jlong values[8] = {plan.n_ctx, plan.kv_type, plan.flash_attn ? 1 : 0, plan.fits ? 1 : 0, (jlong) plan.kv_bytes,
+                       (jlong) plan.weight_bytes, (jlong) plan.reserved_bytes, (jlong) plan.budget_bytes};
+    jlongArray result = env->NewLongArray(8);
+    env->SetLongArrayRegion(result, 0, 8, values);
+    return result;
+}
+
+// Key under which LlmEngine stores backend benchmarks for the model at path on this device
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_getBackendProfileKeyNative(JNIEnv* env, jobject, jstring path) {
+    std::string model_path = jstring_to_std(env, path);
+    return env->NewStringUTF(backend_profile_key(compute_model_hash(model_path.c_str())).c_str());
+}
+
+// Fixed microbenchmark workload used to rank backends
+static const int BENCH_PROMPT_TOKENS = 128;
+static const int BENCH_GEN_TOKENS = 32;
+
+// Benchmark the loaded chat model on whatever backend it was loaded with (see bench_generation):
+// one prefill of BENCH_PROMPT_TOKENS, then BENCH_GEN_TOKENS single-token decodes. Clears the KV cache.
+// Returns {prefill tokens/s, decode tokens/s}, or an empty array on failure.
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_benchmarkBackendNative(JNIEnv* env, jobject) {
+    if (!g_context) return env->NewFloatArray(0);
+
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    g_cached_tokens.clear();
+    g_context_epoch++;
+    AffinityScope affinity(thread_plan().decode_cpus);
+
+    GenerationBench bench;
+    std::vector<llama_token> prompt = bench_tokens(llama_model_get_vocab(g_model), BENCH_PROMPT_TOKENS);
+    if (!bench_generation(g_context, g_model, prompt, BENCH_GEN_TOKENS, bench)) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Backend benchmark failed");
+        return env->NewFloatArray(0);
+    }
+
+    float result[2] = {(float) bench.prefill_tps, (float) bench.decode_tps};
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Backend benchmark (%s): prefill %.1f tok/s, decode %.1f tok/s, TTFT %.1f ms",
+                        g_gpu_enabled ? "GPU" : "CPU", result[0], result[1], bench.ttft_ms);
+    jfloatArray array = env->NewFloatArray(2);
+    env->SetFloatArrayRegion(array, 0, 2, result);
+    return array;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_stopCompletion(JNIEnv* env, jobject) {
+    g_stop_requested = true;
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Stop requested");
+}
+
+// Generate the chat reply to a templated, tokenized prompt on seq 0, streaming it to callback.onToken.
+// t_start is when the request began, for the stats.
+static jstring generate_reply(JNIEnv* env, std::vector<llama_token> tokens_list, jobject callback, int64_t t_start) {
+    g_stop_requested = false;
+    RequestStats stats;
+    int n_tokens = tokens_list.size();
+    const struct llama_vocab * vocab = llama_model_get_vocab(g_model);
+
+    // Background embedding yields the CPU/GPU to interactive generation until this call returns
+    EmbedPipeline::PauseScope pause_embedding(g_embed_pipeline.load());
+    // This thread computes as thread 0 of the decode pool
+    AffinityScope affinity(thread_plan().decode_cpus);
+    
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onTokenMethod = env->GetMethodID(callbackClass, "onToken", "(Ljava/lang/String;)V");
+
+    const int64_t t_tokenized = monotonic_us();
+    stats.tokenize_ms = (t_tokenized - t_start) / 1000.0;
+
+    // The chat sequence shares g_context with scheduled requests; hold the lock for every decode
+    std::unique_lock<std::mutex> ctx_lock(g_context_mutex);
+    const int64_t t_locked = monotonic_us();
+    stats.queue_ms = (t_locked - t_tokenized) / 1000.0;
+    if (g_governor && g_governor->begin(t_locked)) {
+        apply_governor("start");
+        stats.n_governor_changes++;
+    }
+
+    // Too long for the cells scheduled requests left: keep the system prompt and the most recent part
+    // of the user turn. trim_prompt lowers n_keep when the pinned part alone would take more than
+    // half the budget.
+    const int n_window = chat_window();
+    int n_keep = g_context_shift ? pinned_token_count(tokens_list) : 0;
+    if (g_context_shift && n_tokens > max_prompt_tokens(n_window)) {
+        stats.n_discarded_tokens = trim_prompt(tokens_list, n_keep, max_prompt_tokens(n_window));
+        n_tokens = tokens_list.size();
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Prompt trimmed by %d tokens to fit a %d-token window", stats.n_discarded_tokens, n_window);
+    }
+    if (n_tokens >= n_window) {
+        release_chat_cells();
+        return throw_generation_error(env, "Prompt does not fit in the context window");
+    }
+
+    // Reuse the longest common prefix with the previous call's tokens and drop the rest of the KV cache.
+    // At least one token is always re-decoded so that fresh logits exist for sampling.
+    llama_memory_t mem = llama_get_memory(g_context);
+    int n_past = 0;
+    while (n_past < (int) g_cached_tokens.size() && n_past < n_tokens && g_cached_tokens[n_past] == tokens_list[n_past]) {
+        n_past++;
+    }
+    if (n_past >= n_tokens) {
+        n_past = n_tokens - 1;
+    }
+    if (n_past < 0 || !llama_memory_seq_rm(mem, 0, n_past, -1)) {
+        // Partial removal is not supported by every memory type (e.g. recurrent models)
+        llama_memory_seq_rm(mem, 0, -1, -1);
+        n_past = 0;
+    }
+    g_cached_tokens.assign(tokens_list.begin(), tokens_list.begin() + n_past);
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Prompt tokens: %d, reused from cache: %d", n_tokens, n_past);
+    stats.n_prompt_tokens = n_tokens;
+    stats.n_cached_tokens = n_past;
+
+    // Dynamic batch size from context; the governor shrinks prefill chunks while throttling
+    const int32_t n_batch = llama_n_batch(g_context);
+    const int32_t n_prefill_chunk = g_governor ? std::min(n_batch, (int32_t) g_governor->n_batch()) : n_batch;
+
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+
+    for (int i = n_past; i < n_tokens; i += n_prefill_chunk) {
+        int n_chunk = n_tokens - i;
+        if (n_chunk > n_prefill_chunk) n_chunk = n_prefill_chunk;
+        
+        batch.n_tokens = 0;
+        for (int j = 0; j < n_chunk; j++) {
+            batch_add(batch, tokens_list[i + j], i + j, 0, false);
+        }
+        
+        if (i + n_chunk == n_tokens) {
+            batch.logits[batch.n_tokens - 1] = 1;
+        }
+
+        TraceSpan span("prefill", "chat");
+        span.arg("tokens", n_chunk);
+        if (llama_decode(g_context, batch) != 0) {
+            llama_batch_free(batch);
+            llama_memory_seq_rm(mem, 0, -1, -1);
+            g_cached_tokens.clear();
+            release_chat_cells();
+            return throw_generation_error(env, "llama_decode failed during prompt processing");
+        }
+        stats.n_prefill_batches++;
+        stats.max_batch_tokens = std::max(stats.max_batch_tokens, n_chunk);
+        g_cached_tokens.insert(g_cached_tokens.end(), tokens_list.begin() + i, tokens_list.begin() + i + n_chunk);
+    }
+
+    struct llama_sampler_chain_params sparams = llama_sampler_chain_default_params();
+    struct llama_sampler * sampler = llama_sampler_chain_init(sparams);
+    
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_k(40));
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(0.9f, 1));
+    llama_sampler_chain_add(sampler, llama_sampler_init_temp(0.7f));
+    llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+
+    int n_cur = n_tokens;
+    int n_decode = 0;
+    const int max_tokens = 2048; 
+    bool decode_failed = false;
+    
+    // Text reaches Java in UTF-8-complete chunks, at most every STREAM_FLUSH_MS unless STREAM_FLUSH_BYTES pile up
+    const size_t STREAM_FLUSH_BYTES = 256;
+    const int64_t STREAM_FLUSH_MS = 33;
+    TokenStream stream(CHAT_STOP_SEQUENCES, STREAM_FLUSH_BYTES, STREAM_FLUSH_MS);
+    std::string chunk;
+    auto deliver = [&](const std::string& text) {
+        jstring jChunk = new_jstring_utf8(env, text);
+        env->CallVoidMethod(callback, onTokenMethod, jChunk);
+        env->DeleteLocalRef(jChunk);
+    };
+
+    // Stream a sampled token. Returns false when generation should end (EOG or a stop sequence).
+    std::vector<char> piece(256);
+    auto emit_token = [&](llama_token token_id) -> bool {
+        if (llama_vocab_is_eog(vocab, token_id)) {
+            return false;
+        }
+
+        int n = llama_token_to_piece(vocab, token_id, piece.data(), piece.size(), 0, true);
+        if (n < 0) {
+            piece.resize(-n);
+            n = llama_token_to_piece(vocab, token_id, piece.data(), piece.size(), 0, true);
+        }
+        const bool stopped = n > 0 && stream.push(piece.data(), n);
+        if (stream.take_ready(steady_now_ms(), chunk)) {
+            deliver(chunk);
+        }
+        return !stopped;
+    };
+
+    // Each step decodes the last sampled token together with any draft tokens in one batch, then
+    // samples the chat model at every position: draft tokens are accepted while they match what the
+    // chat model samples itself, so the output distribution is unchanged. Drafts come from the draft
+    // model if one is loaded, otherwise from prompt lookup. Without either this is the plain
+    // one-token-per-decode loop. Rejected drafts are rolled back, which recurrent models cannot do.
+    g_spec_drafted = 0;
+    g_spec_accepted = 0;
+    const bool can_rollback = !llama_model_is_recurrent(g_model);
+    const bool use_draft_model = can_rollback && g_context_draft && vocabs_compatible(vocab, llama_model_get_vocab(g_model_draft));
+    const bool use_lookup = can_rollback && !use_draft_model && g_lookup_ngram_max > 0;
+    const int n_draft_max = use_draft_model ? g_n_draft : (use_lookup ? g_lookup_n_draft : 0);
+    std::vector<llama_token> draft;
+    std::vector<llama_token> recent;
+    llama_token new_token_id;
+    {
+        TraceSpan span("sample", "chat");
+        new_token_id = llama_sampler_sample(sampler, g_context, -1);
+    }
+    const int64_t t_first = monotonic_us();
+    stats.prefill_ms = (t_first - t_locked) / 1000.0;
+    stats.ttft_ms = (t_first - t_start) / 1000.0;
+    ctx_lock.unlock();
+
+    while (n_decode < max_tokens) {
+        if (g_stop_requested) {
+            __android_log_print(ANDROID_LOG_INFO, TAG, "Generation stopped by user.");
+            break;
+        }
+
+        if (!emit_token(new_token_id)) break;
+
+        // Window full: evict half of the unpinned tokens and keep going, or stop as before
+        if (n_cur >= n_window) {
+            const int n_discard = (n_cur - n_keep) / 2;
+            ctx_lock.lock();
+            const bool shifted = g_context_shift && kv_shift_discard(g_context, 0, n_keep, n_discard, g_cached_tokens);
+            ctx_lock.unlock();
+            if (!shifted) break;
+            n_cur -= n_discard;
+            stats.n_discarded_tokens += n_discard;
+            __android_log_print(ANDROID_LOG_INFO, TAG, "Context shift: evicted %d tokens after %d pinned", n_discard, n_keep);
+        }
+
+        // Drafting reads the draft model, which is only swapped under the lock
+        ctx_lock.lock();
+        draft.clear();
+        const int n_draft = std::min({n_draft_max, n_window - n_cur - 1, max_tokens - n_decode - 1, n_batch - 1});
+        if (use_draft_model && n_draft > 0) {
+            std::vector<llama_token> context_tokens(g_cached_tokens);
+            context_tokens.push_back(new_token_id);
+            draft_tokens(context_tokens, n_draft, draft);
+        } else if (use_lookup && n_draft > 0) {
+            const size_t n_tail = std::min(g_cached_tokens.size(), (size_t) g_lookup_ngram_max - 1);
+            recent.assign(g_cached_tokens.end() - n_tail, g_cached_tokens.end());
+            recent.push_back(new_token_id);
+            lookup_draft(tokens_list, recent, g_lookup_ngram_max, n_draft, draft);
+        }
+
+        batch.n_tokens = 0;
+        batch_add(batch, new_token_id, n_cur, 0, true);
+        for (size_t i = 0; i < draft.size(); i++) {
+            batch_add(batch, draft[i], n_cur + 1 + i, 0, true);
+        }
+
+        int decode_status;
+        const int64_t t_step = monotonic_us();
+        {
+            TraceSpan span("decode", "chat");
+            span.arg("tokens", batch.n_tokens);
+            decode_status = llama_decode(g_context, batch);
+        }
+        if (decode_status != 0) {
+            // KV state is uncertain after a failed decode, force a full prefill next time
+            llama_memory_seq_rm(mem, 0, -1, -1);
+            g_cached_tokens.clear();
+            decode_failed = true;
+            break;
+        }
+        int64_t pause_us = 0;
+        if (g_governor) {
+            const int64_t t_done = monotonic_us();
+            if (g_governor->on_step(t_done - t_step, t_done)) {
+                apply_governor("decode");
+                stats.n_governor_changes++;
+            }
+            pause_us = g_governor->pause_us(t_done - t_step);
+        }
+        stats.max_batch_tokens = std::max(stats.max_batch_tokens, (int) batch.n_tokens);
+        g_cached_tokens.push_back(new_token_id);
+        n_cur++;
+        n_decode++;
 
-        char buf[256];
-        int n = llama_token_to_piece(vocab, new_token_id, buf, sizeof(buf), 0, true);
-        if (n > 0) {
-            std::string piece(buf, n);
-            result_str += piece;
-            
-            jstring jPiece = env->NewStringUTF(piece.c_str());
-            env->CallVoidMethod(callback, onTokenMethod, jPiece);
-            env->DeleteLocalRef(jPiece);
-            
-            bool stop = false;
-            for (const auto& seq : stop_sequences) {
-                if (result_str.length() >= seq.length()) {
-                    if (result_str.substr(result_str.length() - seq.length()) == seq) {
-                        stop = true;
-                        break;
-                    }
-                    if (piece.find(seq) != std::string::npos) {
-                        stop = true;
-                        break;
-                    }
-                }
+        bool done = false;
+        size_t n_accepted = 0;
+        TraceSpan sample_span("sample", "chat");
+        for (size_t i = 0; i <= draft.size(); i++) {
+            llama_token token_id = llama_sampler_sample(sampler, g_context, i);
+            if (i == draft.size() || token_id != draft[i]) {
+                new_token_id = token_id;
+                break;
+            }
+            n_accepted++;
+            if (!emit_token(token_id)) {
+                done = true;
+                break;
             }
-            if (stop) break;
+            g_cached_tokens.push_back(token_id);
+            n_cur++;
+            n_decode++;
         }
+        g_spec_drafted += draft.size();
+        g_spec_accepted += n_accepted;
 
-        batch.n_tokens = 0;
-        batch_add(batch, new_token_id, n_cur, 0, true);
-        n_cur++;
-        n_decode++;
+        // Drop rejected draft tokens from the KV cache
+        if (!draft.empty() && !llama_memory_seq_rm(mem, 0, n_cur, -1)) {
+            llama_memory_seq_rm(mem, 0, -1, -1);
+            g_cached_tokens.clear();
+            break;
+        }
+        ctx_lock.unlock();
+        if (done) break;
+        if (pause_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+            stats.pacing_ms += pause_us / 1000.0;
+        }
+    }
+    stats.decode_ms = (monotonic_us() - t_first) / 1000.0;
+    if (!ctx_lock.owns_lock()) {
+        ctx_lock.lock();
+    }
+    stats.kv_used = kv_cells_used(g_context);
+    if (g_governor) {
+        stats.governor_level = g_governor->level();
+        stats.n_threads = g_gpu_enabled ? 0 : g_governor->n_threads();
+        stats.prefill_chunk = g_governor->n_batch();
+        stats.soc_celsius = g_governor->temperature();
+    } else {
+        stats.n_threads = g_gpu_enabled ? 0 : thread_plan().n_threads_decode;
+        stats.prefill_chunk = n_batch;
+    }
+    release_chat_cells();
+    ctx_lock.unlock();
+    TraceRecorder::global().counter("kv_used", stats.kv_used);
+
+    if (g_spec_drafted > 0) {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Speculative decoding: %d/%d draft tokens accepted (%.1f%%)",
+                            g_spec_accepted, g_spec_drafted, 100.0f * g_spec_accepted / g_spec_drafted);
+    }
 
-        if (llama_decode(g_context, batch) != 0) break;
+    stream.finish(chunk);
+    if (!chunk.empty()) {
+        deliver(chunk);
     }
 
     llama_sampler_free(sampler);
     llama_batch_free(batch);
-    
-    return env->NewStringUTF(result_str.c_str());
+
+    stats.n_generated_tokens = n_decode;
+    stats.n_drafted = g_spec_drafted;
+    stats.n_accepted = g_spec_accepted;
+    stats.n_ctx = n_window;
+    stats.cancelled = g_stop_requested;
+    {
+        std::lock_guard<std::mutex> stats_lock(g_stats_mutex);
+        g_last_stats = stats;
+        g_has_last_stats = true;
+    }
+
+    if (decode_failed) {
+        return throw_generation_error(env, "llama_decode failed during generation");
+    }
+    return new_jstring_utf8(env, stream.text());
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_completion(JNIEnv* env, jobject, jstring prompt, jobject callback) {
+    if (!g_context) return env->NewStringUTF("Error: Model not loaded");
+    const int64_t t_start = monotonic_us();
+
+    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    std::string user_prompt(prompt_cstr);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+
+    std::string final_prompt_str;
+    {
+        TraceSpan span("template", "chat");
+        final_prompt_str = format_chat_prompt(user_prompt);
+    }
+
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Final Prompt sent to tokenize: %s", final_prompt_str.substr(0, 500).c_str());
+
+    const char* final_prompt = final_prompt_str.c_str();
+    int prompt_length = final_prompt_str.length();
+
+    const struct llama_vocab * vocab = llama_model_get_vocab(g_model);
+
+    std::vector<llama_token> tokens_list;
+    int n_tokens;
+    {
+        TraceSpan span("tokenize", "chat");
+        tokens_list.resize(prompt_length + 100);
+        n_tokens = llama_tokenize(vocab, final_prompt, prompt_length, tokens_list.data(), tokens_list.size(), true, true);
+        if (n_tokens < 0) {
+            tokens_list.resize(-n_tokens);
+            n_tokens = llama_tokenize(vocab, final_prompt, prompt_length, tokens_list.data(), tokens_list.size(), true, true);
+        }
+        tokens_list.resize(n_tokens);
+        span.arg("tokens", n_tokens);
+    }
+
+    return generate_reply(env, std::move(tokens_list), callback, t_start);
+}
+
+// Build the chat prompt for query from ranked context chunks within budget_tokens (<= 0: the most a
+// prompt may use of the window). Returns an AssembledPrompt with the prompt tokens for
+// completionTokens and the indices of the chunks that fit, or null if prompts cannot be assembled
+// for the loaded template.
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_assemblePromptNative(JNIEnv* env, jobject, jstring query, jobjectArray chunks, jint budget_tokens) {
+    if (!g_context) return nullptr;
+    TraceSpan span("assemble", "chat");
+
+    const std::string query_text = jstring_to_std(env, query);
+    const int n_chunks = env->GetArrayLength(chunks);
+    std::vector<std::string> chunk_texts(n_chunks);
+    for (int i = 0; i < n_chunks; i++) {
+        jstring chunk = (jstring) env->GetObjectArrayElement(chunks, i);
+        chunk_texts[i] = jstring_to_std(env, chunk);
+        env->DeleteLocalRef(chunk);
+    }
+
+    const int max_budget = max_prompt_tokens(llama_n_ctx(g_context));
+    const int budget = budget_tokens > 0 ? std::min((int) budget_tokens, max_budget) : max_budget;
+    std::vector<llama_token> tokens;
+    std::vector<int> included;
+    {
+        std::lock_guard<std::mutex> assembler_lock(g_assembler_mutex);
+        if (!g_prompt_assembler) return nullptr;
+        tokens = g_prompt_assembler->assemble(query_text, chunk_texts, budget, included);
+    }
+    span.arg("tokens", tokens.size());
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Assembled prompt: %zu tokens of %d, %zu/%d chunks",
+                        tokens.size(), budget, included.size(), n_chunks);
+
+    jintArray jTokens = env->NewIntArray(tokens.size());
+    env->SetIntArrayRegion(jTokens, 0, tokens.size(), reinterpret_cast<const jint*>(tokens.data()));
+    jintArray jIncluded = env->NewIntArray(included.size());
+    env->SetIntArrayRegion(jIncluded, 0, included.size(), reinterpret_cast<const jint*>(included.data()));
+
+    jclass promptClass = env->FindClass("com/synapsenotes/ai/core/ai/AssembledPrompt");
+    jmethodID promptCtor = env->GetMethodID(promptClass, "<init>", "([I[I)V");
+    return env->NewObject(promptClass, promptCtor, jTokens, jIncluded);
+}
+
+// Completion for a prompt built by assemblePromptNative, skipping template and tokenization
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_completionTokens(JNIEnv* env, jobject, jintArray tokens, jobject callback) {
+    if (!g_context) return env->NewStringUTF("Error: Model not loaded");
+    const int64_t t_start = monotonic_us();
+
+    const int n_tokens = env->GetArrayLength(tokens);
+    std::vector<llama_token> tokens_list(n_tokens);
+    env->GetIntArrayRegion(tokens, 0, n_tokens, reinterpret_cast<jint*>(tokens_list.data()));
+
+    // Assembled for a model that has since been replaced
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(g_model));
+    if (n_tokens == 0 || std::any_of(tokens_list.begin(), tokens_list.end(), [n_vocab](llama_token t) { return t < 0 || t >= n_vocab; })) {
+        return env->NewStringUTF("Error: Invalid prompt tokens");
+    }
+    return generate_reply(env, std::move(tokens_list), callback, t_start);
+}
+
+// JNIEnv of the scheduler worker, which is attached to the VM for its whole lifetime
+static JNIEnv* worker_env() {
+    JNIEnv* env = nullptr;
+    g_vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6);
+    return env;
+}
+
+// Queue a generation on the batch scheduler. Runs concurrently with completion() and other
+// submitted requests; callback receives onToken chunks and exactly one onComplete on a native thread.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_submitNative(JNIEnv* env, jobject, jstring prompt, jint max_tokens, jobject callback) {
+    // Bypasses LlmEngine's mutex, so the model can be swapped or unloaded meanwhile; that happens
+    // under this lock
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    if (!g_context || !g_scheduler) return 0;
+
+    const int64_t t_start = monotonic_us();
+    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    std::string final_prompt = format_chat_prompt(prompt_cstr);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+
+    GenerationRequest request;
+    request.prompt = tokenize_text(llama_model_get_vocab(g_model), final_prompt.c_str(), final_prompt.size());
+    request.max_tokens = max_tokens > 0 ? max_tokens : 512;
+    if (g_context_shift) {
+        // Scheduled requests stop at their reservation rather than shifting, but a long prompt is still trimmed
+        int n_keep = pinned_token_count(request.prompt);
+        trim_prompt(request.prompt, n_keep, max_prompt_tokens(scheduler_cells(llama_n_ctx(g_context))));
+    }
+    request.tokenize_ms = (monotonic_us() - t_start) / 1000.0;
+
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onTokenMethod = env->GetMethodID(callbackClass, "onToken", "(Ljava/lang/String;)V");
+    jmethodID onCompleteMethod = env->GetMethodID(callbackClass, "onComplete", "(Ljava/lang/String;Z)V");
+    jmethodID onStatsMethod = env->GetMethodID(callbackClass, "onStats", "(Lcom/synapsenotes/ai/core/ai/GenerationStats;)V");
+    jmethodID onErrorMethod = env->GetMethodID(callbackClass, "onError", "(Ljava/lang/String;)V");
+    jobject callbackRef = env->NewGlobalRef(callback);
+
+    request.on_text = [callbackRef, onTokenMethod](const std::string& text) {
+        JNIEnv* thread_env = worker_env();
+        jstring jChunk = new_jstring_utf8(thread_env, text);
+        thread_env->CallVoidMethod(callbackRef, onTokenMethod, jChunk);
+        thread_env->DeleteLocalRef(jChunk);
+    };
+    request.on_done = [callbackRef, onCompleteMethod, onStatsMethod, onErrorMethod](const std::string& text, bool cancelled,
+                                                                                   const char* error, const RequestStats& stats) {
+        JNIEnv* thread_env = worker_env();
+        jobject jStats = new_generation_stats(thread_env, stats);
+        thread_env->CallVoidMethod(callbackRef, onStatsMethod, jStats);
+        thread_env->DeleteLocalRef(jStats);
+        if (error) {
+            jstring jError = thread_env->NewStringUTF(error);
+            thread_env->CallVoidMethod(callbackRef, onErrorMethod, jError);
+            thread_env->DeleteLocalRef(jError);
+        }
+        jstring jText = new_jstring_utf8(thread_env, text);
+        thread_env->CallVoidMethod(callbackRef, onCompleteMethod, jText, cancelled ? JNI_TRUE : JNI_FALSE);
+        thread_env->DeleteLocalRef(jText);
+        thread_env->DeleteGlobalRef(callbackRef);
+    };
+
+    return g_scheduler->submit(std::move(request));
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelNative(JNIEnv* env, jobject, jlong handle) {
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    return g_scheduler && g_scheduler->cancel(handle) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_saveSessionNative(JNIEnv* env, jobject, jstring dir, jstring session_id) {
+    if (!g_context) return JNI_FALSE;
+
+    const char* dir_cstr = env->GetStringUTFChars(dir, nullptr);
+    const char* id_cstr = env->GetStringUTFChars(session_id, nullptr);
+    std::string file_path = session_file_path(dir_cstr, id_cstr);
+    env->ReleaseStringUTFChars(dir, dir_cstr);
+    env->ReleaseStringUTFChars(session_id, id_cstr);
+
+    // g_cached_tokens is only stable under the lock: borrowed embeddings and adapter changes clear it
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    if (g_cached_tokens.empty()) return JNI_FALSE;
+
+    // Write to a temp file first so a process kill mid-write never leaves a truncated snapshot
+    std::string tmp_path = file_path + ".tmp";
+    size_t written = llama_state_seq_save_file(g_context, tmp_path.c_str(), 0, g_cached_tokens.data(), g_cached_tokens.size());
+    if (written == 0 || rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to save session to %s", file_path.c_str());
+        remove(tmp_path.c_str());
+        return JNI_FALSE;
+    }
+
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Saved session (%zu tokens, %zu bytes) to %s", g_cached_tokens.size(), written, file_path.c_str());
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_restoreSessionNative(JNIEnv* env, jobject, jstring dir, jstring session_id) {
+    if (!g_context) return JNI_FALSE;
+
+    const char* dir_cstr = env->GetStringUTFChars(dir, nullptr);
+    const char* id_cstr = env->GetStringUTFChars(session_id, nullptr);
+    std::string file_path = session_file_path(dir_cstr, id_cstr);
+    env->ReleaseStringUTFChars(dir, dir_cstr);
+    env->ReleaseStringUTFChars(session_id, id_cstr);
+
+    FILE* f = fopen(file_path.c_str(), "rb");
+    if (!f) return JNI_FALSE;
+    fclose(f);
+
+    std::lock_guard<std::mutex> ctx_lock(g_context_mutex);
+    llama_memory_seq_rm(llama_get_memory(g_context), 0, -1, -1);
+    g_cached_tokens.clear();
+
+    std::vector<llama_token> tokens(llama_n_ctx(g_context));
+    size_t n_token_count = 0;
+    size_t read = llama_state_seq_load_file(g_context, file_path.c_str(), 0, tokens.data(), tokens.size(), &n_token_count);
+    if (read == 0) {
+        __android_log_print(ANDROID_LOG_WARN, TAG, "Failed to restore session from %s, discarding", file_path.c_str());
+        llama_memory_seq_rm(llama_get_memory(g_context), 0, -1, -1);
+        remove(file_path.c_str());
+        return JNI_FALSE;
+    }
+
+    // The restored tokens become the prefix cache, so the next completion only prefills what changed
+    g_cached_tokens.assign(tokens.begin(), tokens.begin() + n_token_count);
+    release_chat_cells();
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Restored session (%zu tokens) from %s", n_token_count, file_path.c_str());
+    return JNI_TRUE;
 }
 
 extern "C" JNIEXPORT jboolean JNICALL
@@ -581,29 +2303,41 @@ Java_com_synapsenotes_ai_core_ai_LlamaContext_isOpenCLAvailable(JNIEnv* env, job
     return JNI_FALSE;
 }
 
-extern "C" JNIEXPORT jfloatArray JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstring text) {
-    if (!g_context_embed && !g_context) return nullptr;
-    
-    llama_context* ctx = g_context_embed ? g_context_embed : g_context;
-    llama_model* model = g_context_embed ? g_model_embed : g_model;
-    
+// Normalized embedding of text into out (empty for a text without tokens). Texts too long for a
+// single decode are embedded as overlapping windows pooled into one vector.
+static bool embed_text(JNIEnv* env, jstring text, EmbedTarget& target, std::vector<float>& out) {
+    llama_context* ctx = target.ctx;
+    llama_model* model = target.model;
+    const int64_t t_start = monotonic_us();
     const char* text_cstr = env->GetStringUTFChars(text, nullptr);
     const struct llama_vocab * vocab = llama_model_get_vocab(model);
 
-    std::vector<llama_token> tokens;
-    tokens.resize(strlen(text_cstr) + 100);
-    int n_tokens = llama_tokenize(vocab, text_cstr, strlen(text_cstr), tokens.data(), tokens.size(), true, true);
-    if (n_tokens < 0) {
-        tokens.resize(-n_tokens);
-        n_tokens = llama_tokenize(vocab, text_cstr, strlen(text_cstr), tokens.data(), tokens.size(), true, true);
+    std::vector<llama_token> tokens = tokenize_text(vocab, text_cstr, strlen(text_cstr));
+    int n_tokens = tokens.size();
+    const int32_t n_embd = llama_model_n_embd(model);
+    out.clear();
+
+    // Too long for a single decode: embed overlapping windows and pool them into one vector
+    if (n_tokens > (int) llama_n_ubatch(ctx)) {
+        std::vector<llama_token> raw_tokens = tokenize_text(vocab, text_cstr, strlen(text_cstr), false);
+        env->ReleaseStringUTFChars(text, text_cstr);
+
+        std::vector<std::pair<int, int>> spans;
+        std::vector<float> windows;
+        EmbedStats work;
+        if (!embed_windows(ctx, model, raw_tokens, 0, DEFAULT_EMBED_OVERLAP, spans, windows, target.before_decode(), &work)) return false;
+
+        out.resize(n_embd);
+        pool_windows(spans, windows, n_embd, true, out.data());
+        record_embed_stats(1, work, t_start);
+        return true;
     }
-    tokens.resize(n_tokens);
     env->ReleaseStringUTFChars(text, text_cstr);
 
-    if (n_tokens == 0) return env->NewFloatArray(0);
+    if (n_tokens == 0) return true;
 
     // Clear context for embedding
+    target.claim();
     llama_memory_seq_rm(llama_get_memory(ctx), -1, -1, -1);
 
     llama_batch batch = llama_batch_init(n_tokens, 0, 1);
@@ -611,12 +2345,15 @@ Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstrin
         batch_add(batch, tokens[i], i, 0, (i == n_tokens - 1));
     }
 
-    if (llama_decode(ctx, batch) != 0) {
-        llama_batch_free(batch);
-        return nullptr;
+    {
+        TraceSpan span("embed_decode", "embed");
+        span.arg("tokens", n_tokens);
+        if (llama_decode(ctx, batch) != 0) {
+            llama_batch_free(batch);
+            return false;
+        }
     }
 
-    int32_t n_embd = llama_model_n_embd(model);
     float* embeddings = llama_get_embeddings_seq(ctx, 0); // seq_id 0
     
     if (!embeddings) {
@@ -625,34 +2362,314 @@ Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstrin
 
     if (!embeddings) {
         llama_batch_free(batch);
-        return nullptr;
+        return false;
     }
 
-    // Normalize
-    float norm = 0.0f;
-    for (int i = 0; i < n_embd; i++) norm += embeddings[i] * embeddings[i];
-    norm = sqrt(norm);
-    
-    std::vector<float> norm_embd(n_embd);
-    for (int i = 0; i < n_embd; i++) norm_embd[i] = embeddings[i] / norm;
-
-    jfloatArray result = env->NewFloatArray(n_embd);
-    env->SetFloatArrayRegion(result, 0, n_embd, norm_embd.data());
+    out.resize(n_embd);
+    normalize_embedding(embeddings, out.data(), n_embd);
+    EmbedStats work;
+    work.n_tokens = n_tokens;
+    work.n_decodes = 1;
+    record_embed_stats(1, work, t_start);
 
     llama_batch_free(batch);
+    return true;
+}
+
+// Truncate each n_embd row of vectors to dims components and encode it; rows are packed back to back
+static jbyteArray encode_rows(JNIEnv* env, std::vector<float>& vectors, int n_embd, int dims, EmbedEncoding encoding) {
+    const size_t n_rows = n_embd > 0 ? vectors.size() / n_embd : 0;
+    const size_t row_size = encoded_size(encoding, dims);
+    std::vector<uint8_t> codes(n_rows * row_size);
+    for (size_t r = 0; r < n_rows; r++) {
+        float* row = vectors.data() + r * n_embd;
+        truncate_embedding(row, dims, row);
+        encode_embedding(row, dims, encoding, codes.data() + r * row_size);
+    }
+    jbyteArray result = env->NewByteArray(codes.size());
+    env->SetByteArrayRegion(result, 0, codes.size(), reinterpret_cast<const jbyte*>(codes.data()));
     return result;
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_synapsenotes_ai_core_ai_LlamaContext_unload(JNIEnv* env, jobject) {
-    if (g_context) {
-        llama_free(g_context);
-        g_context = nullptr;
+static bool valid_encoding(jint encoding) {
+    return encoding == EMBED_ENCODING_F32 || encoding == EMBED_ENCODING_I8 || encoding == EMBED_ENCODING_BINARY;
+}
+
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embed(JNIEnv* env, jobject, jstring text) {
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    std::vector<float> vector;
+    if (!embed_text(env, text, target, vector)) return nullptr;
+
+    jfloatArray result = env->NewFloatArray(vector.size());
+    env->SetFloatArrayRegion(result, 0, vector.size(), vector.data());
+    return result;
+}
+
+// Embed text, truncated to dims components (<= 0: all) and renormalized, in the given encoding
+// (see EmbedEncoding). Empty for a text without tokens.
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embedEncoded(JNIEnv* env, jobject, jstring text, jint dims, jint encoding) {
+    if (!valid_encoding(encoding)) return nullptr;
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    std::vector<float> vector;
+    if (!embed_text(env, text, target, vector)) return nullptr;
+    if (vector.empty()) return env->NewByteArray(0);
+
+    const int n_embd = vector.size();
+    return encode_rows(env, vector, n_embd, truncated_dims(n_embd, dims), (EmbedEncoding) encoding);
+}
+
+// Embed many texts with one JNI call (see embed_texts).
+// Returns texts.length * n_embd normalized floats; rows for empty texts are left as zeros.
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatch(JNIEnv* env, jobject, jobjectArray texts) {
+    const int64_t t_start = monotonic_us();
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    llama_context* ctx = target.ctx;
+    llama_model* model = target.model;
+
+    const int n_texts = env->GetArrayLength(texts);
+    std::vector<std::string> inputs(n_texts);
+    for (int i = 0; i < n_texts; i++) {
+        jstring text = (jstring) env->GetObjectArrayElement(texts, i);
+        inputs[i] = jstring_to_std(env, text);
+        env->DeleteLocalRef(text);
     }
-    if (g_model) {
-        llama_model_free(g_model);
-        g_model = nullptr;
+
+    std::vector<float> output;
+    EmbedStats work;
+    if (!embed_texts(ctx, model, inputs, output, target.before_decode(), &work)) return nullptr;
+    record_embed_stats(n_texts, work, t_start);
+
+    jfloatArray result = env->NewFloatArray(output.size());
+    env->SetFloatArrayRegion(result, 0, output.size(), output.data());
+    return result;
+}
+
+// embedBatch in the given encoding: texts.length rows of encoded_size(encoding, dims) bytes each.
+// Rows for empty texts encode a zero vector.
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embedBatchEncoded(JNIEnv* env, jobject, jobjectArray texts, jint dims, jint encoding) {
+    if (!valid_encoding(encoding)) return nullptr;
+    const int64_t t_start = monotonic_us();
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    const int n_texts = env->GetArrayLength(texts);
+    std::vector<std::string> inputs(n_texts);
+    for (int i = 0; i < n_texts; i++) {
+        jstring text = (jstring) env->GetObjectArrayElement(texts, i);
+        inputs[i] = jstring_to_std(env, text);
+        env->DeleteLocalRef(text);
+    }
+
+    std::vector<float> output;
+    EmbedStats work;
+    if (!embed_texts(target.ctx, target.model, inputs, output, target.before_decode(), &work)) return nullptr;
+    record_embed_stats(n_texts, work, t_start);
+
+    const int n_embd = llama_model_n_embd(target.model);
+    return encode_rows(env, output, n_embd, truncated_dims(n_embd, dims), (EmbedEncoding) encoding);
+}
+
+// Similarity of query to each row of rows, all in the same encoding and dims. Needs no model.
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_scoreEncoded(JNIEnv* env, jobject, jbyteArray query, jbyteArray rows, jint dims, jint encoding) {
+    if (!valid_encoding(encoding) || dims <= 0) return nullptr;
+    const size_t row_size = encoded_size((EmbedEncoding) encoding, dims);
+    const jsize query_len = env->GetArrayLength(query);
+    const jsize rows_len = env->GetArrayLength(rows);
+    if ((size_t) query_len != row_size || rows_len % row_size != 0) return nullptr;
+    const size_t n_rows = rows_len / row_size;
+
+    std::vector<uint8_t> q(row_size);
+    env->GetByteArrayRegion(query, 0, query_len, reinterpret_cast<jbyte*>(q.data()));
+    std::vector<float> scores(n_rows);
+    const uint8_t* r = static_cast<const uint8_t*>(env->GetPrimitiveArrayCritical(rows, nullptr));
+    score_encoded(q.data(), r, n_rows, dims, (EmbedEncoding) encoding, scores.data());
+    env->ReleasePrimitiveArrayCritical(rows, (void*) r, JNI_ABORT);
+
+    jfloatArray result = env->NewFloatArray(n_rows);
+    env->SetFloatArrayRegion(result, 0, n_rows, scores.data());
+    return result;
+}
+
+// Embed a long text as overlapping windows. Returns one EmbeddingChunk per window carrying its
+// [start, end) token offsets and normalized vector. window_tokens <= 0 uses the largest window.
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embedChunks(JNIEnv* env, jobject, jstring text, jint window_tokens, jint overlap_tokens) {
+    const int64_t t_start = monotonic_us();
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    llama_context* ctx = target.ctx;
+    llama_model* model = target.model;
+
+    const char* text_cstr = env->GetStringUTFChars(text, nullptr);
+    std::vector<llama_token> tokens = tokenize_text(llama_model_get_vocab(model), text_cstr, strlen(text_cstr), false);
+    env->ReleaseStringUTFChars(text, text_cstr);
+
+    std::vector<std::pair<int, int>> spans;
+    std::vector<float> windows;
+    EmbedStats work;
+    if (!embed_windows(ctx, model, tokens, window_tokens, overlap_tokens, spans, windows, target.before_decode(), &work)) return nullptr;
+    record_embed_stats(1, work, t_start);
+
+    jclass chunkClass = env->FindClass("com/synapsenotes/ai/core/ai/EmbeddingChunk");
+    jmethodID chunkCtor = env->GetMethodID(chunkClass, "<init>", "(II[F)V");
+    const int32_t n_embd = llama_model_n_embd(model);
+
+    jobjectArray result = env->NewObjectArray(spans.size(), chunkClass, nullptr);
+    for (size_t w = 0; w < spans.size(); w++) {
+        jfloatArray vector = env->NewFloatArray(n_embd);
+        env->SetFloatArrayRegion(vector, 0, n_embd, windows.data() + w * n_embd);
+        jobject chunk = env->NewObject(chunkClass, chunkCtor, (jint) spans[w].first, (jint) spans[w].second, vector);
+        env->SetObjectArrayElement(result, w, chunk);
+        env->DeleteLocalRef(chunk);
+        env->DeleteLocalRef(vector);
+    }
+    return result;
+}
+
+// Embed a long text as overlapping windows and pool them into one normalized note vector
+// (mean, or weighted by window token count).
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_embedPooled(JNIEnv* env, jobject, jstring text, jint window_tokens, jint overlap_tokens, jboolean weighted) {
+    const int64_t t_start = monotonic_us();
+    EmbedTarget target;
+    if (!target.ctx) return nullptr;
+
+    llama_context* ctx = target.ctx;
+    llama_model* model = target.model;
+
+    const char* text_cstr = env->GetStringUTFChars(text, nullptr);
+    std::vector<llama_token> tokens = tokenize_text(llama_model_get_vocab(model), text_cstr, strlen(text_cstr), false);
+    env->ReleaseStringUTFChars(text, text_cstr);
+
+    if (tokens.empty()) return env->NewFloatArray(0);
+
+    std::vector<std::pair<int, int>> spans;
+    std::vector<float> windows;
+    EmbedStats work;
+    if (!embed_windows(ctx, model, tokens, window_tokens, overlap_tokens, spans, windows, target.before_decode(), &work)) return nullptr;
+
+    const int32_t n_embd = llama_model_n_embd(model);
+    std::vector<float> pooled(n_embd);
+    pool_windows(spans, windows, n_embd, weighted, pooled.data());
+    record_embed_stats(1, work, t_start);
+
+    jfloatArray result = env->NewFloatArray(n_embd);
+    env->SetFloatArrayRegion(result, 0, n_embd, pooled.data());
+    return result;
+}
+
+// Chunk cache for the model the embed paths run on, reopened when the model or its width changes.
+// Called with g_embed_mutex held.
+static EmbeddingCache* embed_cache_for(uint64_t model_id, int dim) {
+    if (!g_embed_cache || g_embed_cache->model_id() != model_id || g_embed_cache->dim() != dim) {
+        std::string path;
+        if (!g_embed_cache_dir.empty()) {
+            char hash_hex[17];
+            snprintf(hash_hex, sizeof(hash_hex), "%016llx", (unsigned long long) model_id);
+            path = g_embed_cache_dir + "/" + hash_hex + ".ecache";
+        }
+        g_embed_cache.reset(new EmbeddingCache(path, model_id, dim, EMBED_CACHE_ENTRIES));
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Embedding cache opened with %zu vectors", g_embed_cache->size());
+    }
+    return g_embed_cache.get();
+}
+
+// Start the background embedding pipeline (see embed_pipeline.h) on a low-priority thread attached to
+// the VM. callback receives onEmbedded(id, version, vector or null) and onProgress(done, total) on that
+// thread, version being the one the note was enqueued with.
+// Notes are embedded chunk-wise through a cache persisted in cacheDir (see embedding_cache.h), so an
+// edit only re-embeds the chunks it changed. The pipeline lives for the rest of the process; later
+// calls are no-ops.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_startEmbeddingPipelineNative(JNIEnv* env, jobject, jobject callback, jstring cacheDir) {
+    static std::mutex start_mutex;
+    std::lock_guard<std::mutex> start_lock(start_mutex);
+    if (g_embed_pipeline.load()) return JNI_TRUE;
+
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onEmbeddedMethod = env->GetMethodID(callbackClass, "onEmbedded", "(Ljava/lang/String;J[F)V");
+    jmethodID onProgressMethod = env->GetMethodID(callbackClass, "onProgress", "(II)V");
+    if (!onEmbeddedMethod || !onProgressMethod) return JNI_FALSE;
+    jobject callbackRef = env->NewGlobalRef(callback);
+    {
+        std::lock_guard<std::mutex> embed_lock(g_embed_mutex);
+        g_embed_cache_dir = cacheDir ? jstring_to_std(env, cacheDir) : "";
     }
+
+    auto embed = [](const std::vector<std::string>& texts, const std::function<bool()>& should_abort,
+                    std::vector<float>& out, int& dim) -> bool {
+        EmbedTarget target;
+        if (!target.ctx) return false;
+
+        dim = llama_model_n_embd(target.model);
+        EmbeddingCache* cache = embed_cache_for(target.ctx == g_context_embed ? g_embed_model_hash : g_model_hash, dim);
+        int n_cached = 0;
+        const size_t n_misses = cache->misses();
+        if (!embed_texts_cached(target.ctx, target.model, *cache, texts, out, target.before_decode(should_abort), nullptr, &n_cached)) return false;
+        __android_log_print(ANDROID_LOG_DEBUG, TAG, "Embedded %zu notes: %d chunks cached, %zu not",
+                            texts.size(), n_cached, cache->misses() - n_misses);
+        return true;
+    };
+    auto on_result = [callbackRef, onEmbeddedMethod](const std::string& id, int64_t version, const float* vec, int dim) {
+        JNIEnv* thread_env = worker_env();
+        jstring jId = new_jstring_utf8(thread_env, id);
+        jfloatArray jVec = nullptr;
+        if (vec) {
+            jVec = thread_env->NewFloatArray(dim);
+            thread_env->SetFloatArrayRegion(jVec, 0, dim, vec);
+        }
+        thread_env->CallVoidMethod(callbackRef, onEmbeddedMethod, jId, (jlong) version, jVec);
+        thread_env->DeleteLocalRef(jId);
+        if (jVec) thread_env->DeleteLocalRef(jVec);
+    };
+    auto on_progress = [callbackRef, onProgressMethod](int done, int total) {
+        worker_env()->CallVoidMethod(callbackRef, onProgressMethod, (jint) done, (jint) total);
+    };
+
+    g_embed_pipeline = new EmbedPipeline(
+        embed, on_result, on_progress, EMBED_PIPELINE_BATCH, EMBED_PIPELINE_COALESCE_MS,
+        [] {
+            // Linux nice values are per thread. This one computes as thread 0 of the embedding pool,
+            // whose own threads run SCHED_BATCH.
+            setpriority(PRIO_PROCESS, gettid(), EMBED_PIPELINE_NICE);
+            JNIEnv* thread_env = nullptr;
+            g_vm->AttachCurrentThread(&thread_env, nullptr);
+        },
+        [] { g_vm->DetachCurrentThread(); });
+    __android_log_print(ANDROID_LOG_INFO, TAG, "Embedding pipeline started");
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_enqueueEmbeddingNative(JNIEnv* env, jobject, jstring id, jstring text, jlong version) {
+    EmbedPipeline* pipeline = g_embed_pipeline.load();
+    if (!pipeline) return JNI_FALSE;
+    pipeline->enqueue(jstring_to_std(env, id), jstring_to_std(env, text), version);
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_cancelEmbeddingNative(JNIEnv* env, jobject, jstring id) {
+    EmbedPipeline* pipeline = g_embed_pipeline.load();
+    return pipeline && pipeline->cancel(jstring_to_std(env, id)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_LlamaContext_unload(JNIEnv* env, jobject) {
+    std::lock_guard<std::mutex> embed_lock(g_embed_mutex);
+    free_chat_model();
     if (g_context_embed) {
         llama_free(g_context_embed);
         g_context_embed = nullptr;
@@ -661,5 +2678,201 @@ Java_com_synapsenotes_ai_core_ai_LlamaContext_unload(JNIEnv* env, jobject) {
         llama_model_free(g_model_embed);
         g_model_embed = nullptr;
     }
+    g_embed_cache.reset();
+    g_governor.reset();
+    forget_lora_adapters();
+    {
+        std::lock_guard<std::mutex> assembler_lock(g_assembler_mutex);
+        g_prompt_assembler.reset();
+    }
     g_gpu_enabled = false;
+    g_offload_plan = OffloadPlan();
+    g_context_plan = ContextPlan();
+    std::lock_guard<std::mutex> stats_lock(g_stats_mutex);
+    g_has_last_stats = false;
+    g_has_last_embed_stats = false;
+}
+
+// Index search results as an id array, best first; scores are written to scores_out when it is large enough
+static jobjectArray to_id_array(JNIEnv* env, const std::vector<std::pair<std::string, float>>& results, jfloatArray scores_out) {
+    jobjectArray ids = env->NewObjectArray(results.size(), env->FindClass("java/lang/String"), nullptr);
+    std::vector<float> scores(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        jstring id = env->NewStringUTF(results[i].first.c_str());
+        env->SetObjectArrayElement(ids, i, id);
+        env->DeleteLocalRef(id);
+        scores[i] = results[i].second;
+    }
+    if (scores_out && env->GetArrayLength(scores_out) >= (jsize) scores.size()) {
+        env->SetFloatArrayRegion(scores_out, 0, scores.size(), scores.data());
+    }
+    return ids;
+}
+
+// Vector index (see vector_index.h). Handles are VectorIndex pointers owned by the Kotlin wrapper,
+// which serializes calls on a handle.
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeOpen(JNIEnv* env, jobject, jstring path, jint dim, jboolean quantized) {
+    const char* path_cstr = env->GetStringUTFChars(path, nullptr);
+    VectorIndex* index = VectorIndex::open(path_cstr, dim, quantized);
+    if (index) {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Mapped vector index %s (%u vectors)", path_cstr, index->size());
+    } else {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "No usable vector index at %s, starting empty", path_cstr);
+        index = new VectorIndex(dim, quantized);
+    }
+    env->ReleaseStringUTFChars(path, path_cstr);
+    return reinterpret_cast<jlong>(index);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeAdd(JNIEnv* env, jobject, jlong handle, jstring id, jfloatArray vector) {
+    VectorIndex* index = reinterpret_cast<VectorIndex*>(handle);
+    if (!index || env->GetArrayLength(vector) != index->dim()) return;
+
+    const char* id_cstr = env->GetStringUTFChars(id, nullptr);
+    std::string note_id(id_cstr);
+    env->ReleaseStringUTFChars(id, id_cstr);
+
+    std::vector<float> values(index->dim());
+    env->GetFloatArrayRegion(vector, 0, index->dim(), values.data());
+    index->add(note_id, values.data());
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeRemove(JNIEnv* env, jobject, jlong handle, jstring id) {
+    VectorIndex* index = reinterpret_cast<VectorIndex*>(handle);
+    if (!index) return JNI_FALSE;
+
+    const char* id_cstr = env->GetStringUTFChars(id, nullptr);
+    bool removed = index->remove(id_cstr);
+    env->ReleaseStringUTFChars(id, id_cstr);
+    return removed ? JNI_TRUE : JNI_FALSE;
+}
+
+// Returns up to k note ids, best first; their similarities are written to scores_out
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSearch(JNIEnv* env, jobject, jlong handle, jfloatArray query, jint k, jfloatArray scores_out) {
+    VectorIndex* index = reinterpret_cast<VectorIndex*>(handle);
+    std::vector<std::pair<std::string, float>> results;
+    if (!index || env->GetArrayLength(query) != index->dim()) {
+        return to_id_array(env, results, scores_out);
+    }
+
+    float* query_data = static_cast<float*>(env->GetPrimitiveArrayCritical(query, nullptr));
+    index->search(query_data, k, results);
+    env->ReleasePrimitiveArrayCritical(query, query_data, JNI_ABORT);
+    return to_id_array(env, results, scores_out);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSave(JNIEnv* env, jobject, jlong handle, jstring path) {
+    VectorIndex* index = reinterpret_cast<VectorIndex*>(handle);
+    if (!index) return JNI_FALSE;
+
+    const char* path_cstr = env->GetStringUTFChars(path, nullptr);
+    bool ok = index->save(path_cstr);
+    if (!ok) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to save vector index to %s", path_cstr);
+    }
+    env->ReleaseStringUTFChars(path, path_cstr);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeSize(JNIEnv* env, jobject, jlong handle) {
+    VectorIndex* index = reinterpret_cast<VectorIndex*>(handle);
+    return index ? (jint) index->size() : 0;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_VectorIndex_nativeClose(JNIEnv* env, jobject, jlong handle) {
+    delete reinterpret_cast<VectorIndex*>(handle);
+}
+
+// Text index (see text_index.h). Same handle ownership as the vector index.
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeOpen(JNIEnv* env, jobject, jstring path) {
+    std::string index_path = jstring_to_std(env, path);
+    TextIndex* index = TextIndex::load(index_path);
+    if (index) {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "Loaded text index %s (%u documents)", index_path.c_str(), index->size());
+    } else {
+        __android_log_print(ANDROID_LOG_INFO, TAG, "No usable text index at %s, starting empty", index_path.c_str());
+        index = new TextIndex();
+    }
+    return reinterpret_cast<jlong>(index);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeAdd(JNIEnv* env, jobject, jlong handle, jstring id, jstring text) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    if (!index) return;
+    index->add(jstring_to_std(env, id), jstring_to_std(env, text));
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeRemove(JNIEnv* env, jobject, jlong handle, jstring id) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    if (!index) return JNI_FALSE;
+    return index->remove(jstring_to_std(env, id)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearch(JNIEnv* env, jobject, jlong handle, jstring query, jint k, jfloatArray scores_out) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    std::vector<std::pair<std::string, float>> results;
+    if (index) {
+        index->search(jstring_to_std(env, query), k, results);
+    }
+    return to_id_array(env, results, scores_out);
+}
+
+// vector_ids/vector_scores are hits from VectorIndex.search for the same query
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSearchHybrid(JNIEnv* env, jobject, jlong handle, jstring query, jint k,
+                                                              jobjectArray vector_ids, jfloatArray vector_scores, jfloat alpha, jfloatArray scores_out) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    std::vector<std::pair<std::string, float>> results;
+    if (index) {
+        const jsize n_hits = std::min(env->GetArrayLength(vector_ids), env->GetArrayLength(vector_scores));
+        std::vector<float> scores(n_hits);
+        env->GetFloatArrayRegion(vector_scores, 0, n_hits, scores.data());
+
+        std::vector<std::pair<std::string, float>> vector_hits;
+        vector_hits.reserve(n_hits);
+        for (jsize i = 0; i < n_hits; i++) {
+            jstring id = (jstring) env->GetObjectArrayElement(vector_ids, i);
+            vector_hits.emplace_back(jstring_to_std(env, id), scores[i]);
+            env->DeleteLocalRef(id);
+        }
+        index->search_hybrid(jstring_to_std(env, query), k, vector_hits, alpha, results);
+    }
+    return to_id_array(env, results, scores_out);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSave(JNIEnv* env, jobject, jlong handle, jstring path) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    if (!index) return JNI_FALSE;
+
+    std::string index_path = jstring_to_std(env, path);
+    bool ok = index->save(index_path);
+    if (!ok) {
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to save text index to %s", index_path.c_str());
+    }
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeSize(JNIEnv* env, jobject, jlong handle) {
+    TextIndex* index = reinterpret_cast<TextIndex*>(handle);
+    return index ? (jint) index->size() : 0;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_synapsenotes_ai_core_ai_TextIndex_nativeClose(JNIEnv* env, jobject, jlong handle) {
+    delete reinterpret_cast<TextIndex*>(handle);
 }
@@ -0,0 +1,142 @@
+#include "offload_planner.h"
+
+#include <algorithm>
+
+namespace {
+
+uint64_t sum(const std::vector<uint64_t>& values) {
+    uint64_t total = 0;
+    for (uint64_t v : values) total += v;
+    return total;
+}
+
+// Fill in the byte totals of a plan from its layer counts
+OffloadPlan finish_plan(const ModelFootprint& model, int n_gpu_layers, int n_cpu_ffn_layers) {
+    const int n_layer = model.layer_bytes.size();
+    OffloadPlan plan;
+    plan.n_layer = n_layer;
+    plan.n_gpu_layers = n_gpu_layers;
+    plan.n_cpu_ffn_layers = n_cpu_ffn_layers;
+    plan.kv_bytes = sum(model.layer_kv_bytes);
+
+    const int first_gpu_layer = n_gpu_layers >= n_layer ? 0 : n_layer - n_gpu_layers;
+    for (int i = 0; i < n_layer; i++) {
+        const uint64_t layer = model.layer_bytes[i] + model.layer_kv_bytes[i];
+        if (i < first_gpu_layer) {
+            plan.cpu_bytes += layer;
+        } else if (i < n_cpu_ffn_layers) {
+            plan.gpu_bytes += layer - model.layer_ffn_bytes[i];
+            plan.cpu_bytes += model.layer_ffn_bytes[i];
+            plan.gpu_kv_bytes += model.layer_kv_bytes[i];
+        } else {
+            plan.gpu_bytes += layer;
+            plan.gpu_kv_bytes += model.layer_kv_bytes[i];
+        }
+    }
+    (n_gpu_layers > n_layer ? plan.gpu_bytes : plan.cpu_bytes) += model.output_bytes;
+    plan.cpu_bytes += model.input_bytes;
+    return plan;
+}
+
+} // namespace
+
+OffloadPlan plan_full_offload(const ModelFootprint& model) {
+    return finish_plan(model, model.layer_bytes.size() + 1, 0);
+}
+
+OffloadPlan plan_cpu_only(const ModelFootprint& model) {
+    return finish_plan(model, 0, 0);
+}
+
+OffloadPlan plan_offload(const ModelFootprint& model, uint64_t budget_bytes, uint64_t reserve_bytes, bool allow_overrides) {
+    const int n_layer = model.layer_bytes.size();
+    const uint64_t available = budget_bytes > reserve_bytes ? budget_bytes - reserve_bytes : 0;
+
+    // Layer split: trailing layers first, the output head only on top of all of them
+    uint64_t used = 0;
+    int n_gpu_layers = 0;
+    for (int i = n_layer - 1; i >= 0; i--) {
+        const uint64_t need = model.layer_bytes[i] + model.layer_kv_bytes[i];
+        if (used + need > available) break;
+        used += need;
+        n_gpu_layers++;
+    }
+    if (n_gpu_layers == n_layer && used + model.output_bytes <= available) {
+        n_gpu_layers = n_layer + 1;
+    }
+    OffloadPlan best = finish_plan(model, n_gpu_layers, 0);
+    best.budget_bytes = budget_bytes;
+    if (n_gpu_layers > n_layer || !allow_overrides) return best;
+
+    // FFN overrides: everything but the FFN matrices must fit, then FFN layers from the back
+    uint64_t base = model.output_bytes + sum(model.layer_kv_bytes);
+    for (int i = 0; i < n_layer; i++) base += model.layer_bytes[i] - model.layer_ffn_bytes[i];
+    if (base > available) return best;
+
+    int n_cpu_ffn_layers = n_layer;
+    used = base;
+    while (n_cpu_ffn_layers > 0 && used + model.layer_ffn_bytes[n_cpu_ffn_layers - 1] <= available) {
+        used += model.layer_ffn_bytes[n_cpu_ffn_layers - 1];
+        n_cpu_ffn_layers--;
+    }
+
+    OffloadPlan overrides = finish_plan(model, n_layer + 1, n_cpu_ffn_layers);
+    overrides.budget_bytes = budget_bytes;
+    const uint64_t split_weights = best.gpu_bytes - best.gpu_kv_bytes;
+    const uint64_t override_weights = overrides.gpu_bytes - overrides.gpu_kv_bytes;
+    return override_weights > split_weights ? overrides : best;
+}
+
+std::string ffn_override_pattern(int n_layers) {
+    std::string pattern = "^blk\\.(";
+    for (int i = 0; i < n_layers; i++) {
+        if (i > 0) pattern += "|";
+        pattern += std::to_string(i);
+    }
+    pattern += ")\\.ffn_(up|gate|down)";
+    return pattern;
+}
+
+double kv_cache_type_bytes(KvCacheType type) {
+    switch (type) {
+        case KV_CACHE_Q8_0: return 34.0 / 32; // 32 int8 values + an f16 scale per block
+        case KV_CACHE_Q4_0: return 18.0 / 32; // 32 nibbles + an f16 scale per block
+        default:            return 2.0;
+    }
+}
+
+ContextPlan plan_context(const ModelFootprint& model, uint64_t budget_bytes, uint64_t reserve_bytes, uint64_t reserve_per_ctx,
+                         int n_ctx_target, int n_ctx_min, int n_ctx_max, bool allow_quantized) {
+    const int CTX_ALIGN = 256; // llama.cpp pads the KV cache to this anyway
+    const uint64_t kv_token_f16 = sum(model.layer_kv_bytes);
+    const uint64_t fixed = model.total_bytes + reserve_bytes;
+    const uint64_t available = budget_bytes > fixed ? budget_bytes - fixed : 0;
+    if (n_ctx_max < n_ctx_min) n_ctx_max = n_ctx_min;
+
+    ContextPlan plan;
+    const KvCacheType types[] = {KV_CACHE_F16, KV_CACHE_Q8_0, KV_CACHE_Q4_0};
+    const int n_types = allow_quantized ? 3 : 1;
+    for (int t = 0; t < n_types; t++) {
+        const bool flash_attn = types[t] != KV_CACHE_F16;
+        const double per_token = kv_token_f16 * kv_cache_type_bytes(types[t]) / 2.0 + (flash_attn ? 0 : reserve_per_ctx);
+        int n_ctx = per_token > 0 ? (int) std::min<double>(n_ctx_max, available / per_token) : n_ctx_max;
+        n_ctx = n_ctx / CTX_ALIGN * CTX_ALIGN;
+
+        plan.kv_type = types[t];
+        plan.flash_attn = flash_attn;
+        plan.fits = n_ctx >= n_ctx_min;
+        plan.n_ctx = std::max(n_ctx, n_ctx_min);
+        plan.reserved_bytes = reserve_bytes + (flash_attn ? 0 : reserve_per_ctx * plan.n_ctx);
+        if (n_ctx >= std::min(n_ctx_target, n_ctx_max)) break;
+    }
+
+    plan.kv_bytes = (uint64_t) (kv_token_f16 * kv_cache_type_bytes(plan.kv_type) / 2.0 * plan.n_ctx);
+    plan.weight_bytes = model.total_bytes;
+    plan.budget_bytes = budget_bytes;
+    return plan;
+}
+
+void apply_context_plan(ModelFootprint& model, const ContextPlan& plan) {
+    const double scale = plan.n_ctx * kv_cache_type_bytes(plan.kv_type) / 2.0;
+    for (uint64_t& bytes : model.layer_kv_bytes) bytes = (uint64_t) (bytes * scale);
+}
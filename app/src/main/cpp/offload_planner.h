@@ -0,0 +1,80 @@
+#pragma once
+
+// Partial GPU offload planning for a memory budget.
+//
+// llama.cpp offloads the last n_gpu_layers repeating layers (with their KV cache), and the output
+// head only once every layer is offloaded. Two plans are considered and the one that keeps more
+// weight bytes on the GPU wins:
+//  - layer split: as many trailing layers as fit, the rest on the CPU
+//  - FFN overrides: every layer offloaded, but the FFN matrices (the largest tensors) of the first
+//    layers kept in CPU memory through tensor buffer overrides, so attention and the KV cache of
+//    every layer still run on the GPU
+// Pure arithmetic: the caller measures the model and the budget.
+//
+// Before that, plan_context sizes the context for a whole-memory budget: the KV cache type and the
+// largest n_ctx that fit next to the weights (see below).
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ModelFootprint {
+    std::vector<uint64_t> layer_bytes;     // Weights per repeating layer
+    std::vector<uint64_t> layer_ffn_bytes; // Part of layer_bytes in ffn_up/gate/down matrices
+    std::vector<uint64_t> layer_kv_bytes;  // KV cache per layer at the planned n_ctx
+    uint64_t output_bytes = 0;             // Output head and final norm
+    uint64_t input_bytes = 0;              // Token embeddings, always kept on the CPU
+    uint64_t total_bytes = 0;              // Every tensor once (tied output heads are counted above twice)
+    int n_ctx_train = 0;                   // Context length the model was trained with, 0 if unknown
+};
+
+struct OffloadPlan {
+    int n_layer = 0;
+    int n_gpu_layers = 0;      // For llama_model_params.n_gpu_layers (n_layer + 1 includes the output head)
+    int n_cpu_ffn_layers = 0;  // Leading layers whose FFN matrices stay on the CPU, 0 for a plain split
+    uint64_t gpu_bytes = 0;    // Weights + KV cache planned on the GPU
+    uint64_t cpu_bytes = 0;    // Weights + KV cache left on the CPU
+    uint64_t kv_bytes = 0;     // Total KV cache
+    uint64_t gpu_kv_bytes = 0; // Part of gpu_bytes that is KV cache
+    uint64_t budget_bytes = 0;
+};
+
+// Plan for budget bytes of GPU memory, of which reserve_bytes are kept for compute buffers
+OffloadPlan plan_offload(const ModelFootprint& model, uint64_t budget_bytes, uint64_t reserve_bytes, bool allow_overrides);
+
+// Everything on the GPU (budget unknown or ample)
+OffloadPlan plan_full_offload(const ModelFootprint& model);
+
+// Everything on the CPU
+OffloadPlan plan_cpu_only(const ModelFootprint& model);
+
+// KV cache element types, best quality first. Quantized V caches need flash attention.
+enum KvCacheType { KV_CACHE_F16, KV_CACHE_Q8_0, KV_CACHE_Q4_0 };
+
+// Bytes per cached element, block scales included
+double kv_cache_type_bytes(KvCacheType type);
+
+struct ContextPlan {
+    int n_ctx = 0;
+    KvCacheType kv_type = KV_CACHE_F16;
+    bool flash_attn = false;    // Forced on; otherwise llama.cpp decides per device
+    bool fits = false;          // False if even n_ctx_min with the smallest cache exceeds the budget
+    uint64_t kv_bytes = 0;
+    uint64_t weight_bytes = 0;
+    uint64_t reserved_bytes = 0; // Compute buffers and other models sharing the budget
+    uint64_t budget_bytes = 0;
+};
+
+// Pick the KV cache type and n_ctx for budget_bytes of memory holding the weights, reserve_bytes and
+// the KV cache. model.layer_kv_bytes must be the f16 cache of one token (read at n_ctx 1). Without
+// flash attention the attention scores take another reserve_per_ctx bytes per context token.
+// The best-quality cache type that still reaches n_ctx_target wins, with the largest n_ctx it fits
+// up to n_ctx_max (rounded down to 256); if none does, the smallest type with as much as fits.
+ContextPlan plan_context(const ModelFootprint& model, uint64_t budget_bytes, uint64_t reserve_bytes, uint64_t reserve_per_ctx,
+                         int n_ctx_target, int n_ctx_min, int n_ctx_max, bool allow_quantized);
+
+// Scale the one-token layer_kv_bytes of model to plan's n_ctx and cache type
+void apply_context_plan(ModelFootprint& model, const ContextPlan& plan);
+
+// tensor_buft_overrides regex matching the FFN matrices of layers [0, n_layers)
+std::string ffn_override_pattern(int n_layers);
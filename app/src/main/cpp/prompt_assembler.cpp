@@ -0,0 +1,98 @@
+#include "prompt_assembler.h"
+#include "inference.h"
+
+namespace {
+
+uint64_t fnv1a(const std::string& text) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void append(std::vector<llama_token>& out, const std::vector<llama_token>& tokens) {
+    out.insert(out.end(), tokens.begin(), tokens.end());
+}
+
+} // namespace
+
+PromptAssembler::PromptAssembler(const llama_vocab* vocab, PromptLayout layout, size_t cache_tokens)
+    : vocab_(vocab), cache_capacity_(cache_tokens) {
+    prefix_ = tokenize(layout.prefix, true);
+    suffix_ = tokenize(layout.suffix, false);
+    context_header_ = tokenize(layout.context_header, false);
+    chunk_separator_ = tokenize(layout.chunk_separator, false);
+    query_separator_ = tokenize(layout.query_separator, false);
+}
+
+std::vector<llama_token> PromptAssembler::tokenize(const std::string& text, bool add_special) const {
+    if (text.empty()) return {};
+    return tokenize_text(vocab_, text.c_str(), text.size(), add_special);
+}
+
+const std::vector<llama_token>& PromptAssembler::chunk_tokens(const std::string& text) {
+    const uint64_t key = fnv1a(text);
+    auto it = index_.find(key);
+    if (it != index_.end() && it->second->text == text) {
+        hits_++;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return lru_.front().tokens;
+    }
+
+    misses_++;
+    if (it != index_.end()) {
+        cache_size_ -= it->second->tokens.size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front({key, text, tokenize(text, false)});
+    index_[key] = lru_.begin();
+    cache_size_ += lru_.front().tokens.size();
+
+    // Evict from the cold end, but never the entry just added
+    while (cache_size_ > cache_capacity_ && lru_.size() > 1) {
+        cache_size_ -= lru_.back().tokens.size();
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+    return lru_.front().tokens;
+}
+
+std::vector<llama_token> PromptAssembler::assemble(const std::string& query, const std::vector<std::string>& chunks, int budget,
+                                                   std::vector<int>& included) {
+    const std::vector<llama_token> query_tokens = tokenize(query, false);
+    included.clear();
+
+    const int n_fixed = prefix_.size() + query_tokens.size() + suffix_.size();
+    const int n_context_fixed = context_header_.size() + query_separator_.size();
+    int remaining = budget - n_fixed - n_context_fixed;
+
+    // Copies are taken as chunks are chosen: later lookups may evict earlier entries from the cache
+    std::vector<std::vector<llama_token>> packed;
+    for (size_t i = 0; i < chunks.size() && remaining > 0; i++) {
+        if (chunks[i].empty()) continue;
+        const std::vector<llama_token>& tokens = chunk_tokens(chunks[i]);
+        const int cost = tokens.size() + (packed.empty() ? 0 : chunk_separator_.size());
+        if (cost > remaining) continue;
+        packed.push_back(tokens);
+        included.push_back(i);
+        remaining -= cost;
+    }
+
+    std::vector<llama_token> prompt;
+    prompt.reserve(budget > 0 ? budget : n_fixed);
+    append(prompt, prefix_);
+    if (!packed.empty()) {
+        append(prompt, context_header_);
+        for (size_t i = 0; i < packed.size(); i++) {
+            if (i > 0) append(prompt, chunk_separator_);
+            append(prompt, packed[i]);
+        }
+        append(prompt, query_separator_);
+    }
+    append(prompt, query_tokens);
+    append(prompt, suffix_);
+    return prompt;
+}
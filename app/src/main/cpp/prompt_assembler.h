@@ -0,0 +1,65 @@
+#pragma once
+
+// Token-budgeted RAG prompt assembly.
+//
+// The chat template is applied once per model to a placeholder user message and split around it, so
+// a prompt is built by concatenating token runs: template prefix, context header, the packed chunks,
+// the query, template suffix. Chunks are tokenized once and kept in an LRU cache keyed by their text,
+// so the same notes retrieved again for a follow-up question cost nothing to measure or tokenize.
+// Not thread-safe; callers serialize access.
+
+#include "llama.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PromptLayout {
+    std::string prefix;                        // Template text before the user message (system prompt, headers)
+    std::string suffix;                        // Template text after it (end of turn, assistant header)
+    std::string context_header = "Context:\n";
+    std::string chunk_separator = "\n\n";
+    std::string query_separator = "\n\n\n";
+};
+
+class PromptAssembler {
+public:
+    // cache_tokens bounds the total size of the cached chunk tokenizations
+    PromptAssembler(const llama_vocab* vocab, PromptLayout layout, size_t cache_tokens);
+
+    // Build the prompt for query with as many chunks as fit in budget tokens, taken in rank order; a
+    // chunk that does not fit is skipped in favour of later, shorter ones. included receives the
+    // indices of the packed chunks. Without any chunk the context header is left out too.
+    std::vector<llama_token> assemble(const std::string& query, const std::vector<std::string>& chunks, int budget,
+                                      std::vector<int>& included);
+
+    size_t cache_hits() const { return hits_; }
+    size_t cache_misses() const { return misses_; }
+
+private:
+    struct CacheEntry {
+        uint64_t key;
+        std::string text; // Guards against hash collisions
+        std::vector<llama_token> tokens;
+    };
+
+    const std::vector<llama_token>& chunk_tokens(const std::string& text);
+    std::vector<llama_token> tokenize(const std::string& text, bool add_special) const;
+
+    const llama_vocab* vocab_;
+    std::vector<llama_token> prefix_;
+    std::vector<llama_token> suffix_;
+    std::vector<llama_token> context_header_;
+    std::vector<llama_token> chunk_separator_;
+    std::vector<llama_token> query_separator_;
+
+    size_t cache_capacity_;
+    size_t cache_size_ = 0; // Tokens held by lru_
+    std::list<CacheEntry> lru_; // Most recently used first
+    std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> index_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// Per-request performance counters of one generation, filled by the chat path (completion()) and by
+// the batch scheduler, and handed to Kotlin as a GenerationStats object.
+
+struct RequestStats {
+    int n_prompt_tokens = 0;
+    int n_cached_tokens = 0;    // Prompt tokens reused from the KV cache instead of prefilled
+    int n_generated_tokens = 0;
+    int n_discarded_tokens = 0; // Evicted by context shifting (prompt trimming and KV shifts)
+    int n_prefill_batches = 0;  // Decodes that carried prompt tokens of this request
+    int max_batch_tokens = 0;   // Largest batch this request's tokens were decoded in
+    int n_drafted = 0;          // Speculative draft tokens proposed / accepted
+    int n_accepted = 0;
+    int kv_used = 0;            // KV cells in use over all sequences when the request ended
+    int n_ctx = 0;
+    double queue_ms = 0;        // Waiting for the context: the chat lock or a free scheduler slot
+    double tokenize_ms = 0;     // Chat template and tokenization
+    double prefill_ms = 0;
+    double ttft_ms = 0;         // From the start of the request to the first sampled token
+    double decode_ms = 0;       // Token-by-token decoding after the first token
+    int governor_level = 0;     // Decode governor throttle level when the request ended (chat path only)
+    int n_governor_changes = 0; // Level changes during the request
+    int n_threads = 0;          // Decode threads in effect at the end, 0 on GPU backends
+    int prefill_chunk = 0;      // Prefill chunk size in effect at the end
+    double pacing_ms = 0;       // Pauses inserted between decode steps to hold the rate
+    double soc_celsius = 0;     // SoC temperature at the end, 0 without a readable sensor
+    bool cancelled = false;
+};
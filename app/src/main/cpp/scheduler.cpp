@@ -0,0 +1,352 @@
+#include "scheduler.h"
+#include "inference.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Same sampling as the chat path
+llama_sampler* make_sampler() {
+    llama_sampler* sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_k(40));
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(0.9f, 1));
+    llama_sampler_chain_add(sampler, llama_sampler_init_temp(0.7f));
+    llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    return sampler;
+}
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const size_t STREAM_FLUSH_BYTES = 256;
+const int64_t STREAM_FLUSH_MS = 33;
+
+} // namespace
+
+BatchScheduler::BatchScheduler(llama_context* ctx, std::mutex& ctx_mutex, const std::atomic<uint32_t>& ctx_epoch,
+                               const std::atomic<int>& external_cells, llama_seq_id first_seq, int n_slots, int n_cells,
+                               std::vector<std::string> stop_sequences,
+                               std::function<void()> thread_start, std::function<void()> thread_stop)
+    : ctx_(ctx),
+      vocab_(llama_model_get_vocab(llama_get_model(ctx))),
+      ctx_mutex_(ctx_mutex),
+      ctx_epoch_(ctx_epoch),
+      seen_epoch_(ctx_epoch.load()),
+      external_cells_(external_cells),
+      n_cells_(n_cells),
+      stop_sequences_(std::move(stop_sequences)),
+      thread_start_(std::move(thread_start)),
+      thread_stop_(std::move(thread_stop)),
+      slots_(n_slots) {
+    for (int i = 0; i < n_slots; i++) {
+        slots_[i].seq = first_seq + i;
+    }
+    worker_ = std::thread(&BatchScheduler::run, this);
+}
+
+BatchScheduler::~BatchScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+int64_t BatchScheduler::submit(GenerationRequest request) {
+    int64_t handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handle = next_handle_++;
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        cancel_flags_[handle] = cancelled;
+        queue_.push_back({handle, std::move(request), cancelled, monotonic_us()});
+    }
+    cv_.notify_all();
+    return handle;
+}
+
+bool BatchScheduler::cancel(int64_t handle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cancel_flags_.find(handle);
+        if (it == cancel_flags_.end()) return false;
+        it->second->store(true);
+        blocked_ = false;
+    }
+    cv_.notify_all();
+    return true;
+}
+
+void BatchScheduler::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocked_ = false;
+    }
+    cv_.notify_all();
+}
+
+// Worst case KV footprint of a request
+int BatchScheduler::cells_needed(const GenerationRequest& request) const {
+    return std::min((int) request.prompt.size() + std::max(request.max_tokens, 1), n_cells_);
+}
+
+// Cells a new request may still reserve. Call with ctx_mutex_ held.
+int BatchScheduler::free_cells() const {
+    llama_memory_t mem = llama_get_memory(ctx_);
+    int held_here = 0;
+    for (const Slot& slot : slots_) {
+        held_here += llama_memory_seq_pos_max(mem, slot.seq) + 1;
+    }
+    const int held_elsewhere = kv_cells_used(ctx_) - held_here;
+    const int claimed_elsewhere = std::max(held_elsewhere, external_cells_.load());
+    return std::min(n_cells_, (int) llama_n_ctx(ctx_) - claimed_elsewhere) - reserved_cells_;
+}
+
+// Call with ctx_mutex_ held, so the reservation is visible to reserved_cells() at once
+void BatchScheduler::admit(Slot& slot, Pending& pending, int n_cells) {
+    slot.active = true;
+    slot.handle = pending.handle;
+    slot.request = std::move(pending.request);
+    slot.cancelled = pending.cancelled;
+    slot.tokens = slot.request.prompt;
+    slot.n_past = 0;
+    slot.n_generated = 0;
+    slot.batch_index = -1;
+    slot.n_cells = n_cells;
+    reserved_cells_ += n_cells;
+    slot.sampler = make_sampler();
+    slot.stream.reset(new TokenStream(stop_sequences_, STREAM_FLUSH_BYTES, STREAM_FLUSH_MS));
+    slot.submit_us = pending.submit_us;
+    slot.stats = RequestStats();
+    slot.stats.n_prompt_tokens = slot.tokens.size();
+    slot.stats.n_ctx = n_cells;
+    slot.stats.tokenize_ms = slot.request.tokenize_ms;
+    slot.stats.queue_ms = (monotonic_us() - pending.submit_us) / 1000.0;
+}
+
+RequestStats BatchScheduler::queued_stats(const Pending& pending, bool cancelled) const {
+    RequestStats stats;
+    stats.n_prompt_tokens = pending.request.prompt.size();
+    stats.n_ctx = n_cells_;
+    stats.tokenize_ms = pending.request.tokenize_ms;
+    stats.queue_ms = (monotonic_us() - pending.submit_us) / 1000.0;
+    stats.cancelled = cancelled;
+    return stats;
+}
+
+void BatchScheduler::finish(Slot& slot, bool cancelled, const char* error) {
+    std::string chunk;
+    slot.stream->finish(chunk);
+    if (!chunk.empty() && slot.request.on_text) {
+        slot.request.on_text(chunk);
+    }
+    if (slot.request.on_done) {
+        slot.stats.n_generated_tokens = slot.n_generated;
+        slot.stats.cancelled = cancelled;
+        slot.request.on_done(slot.stream->text(), cancelled, error, slot.stats);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx_mutex_);
+        llama_memory_seq_rm(llama_get_memory(ctx_), slot.seq, -1, -1);
+        reserved_cells_ -= slot.n_cells;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancel_flags_.erase(slot.handle);
+    }
+
+    llama_sampler_free(slot.sampler);
+    slot.sampler = nullptr;
+    slot.stream.reset();
+    slot.request = GenerationRequest();
+    slot.tokens.clear();
+    slot.n_cells = 0;
+    slot.active = false;
+}
+
+// Returns false when the request is complete
+bool BatchScheduler::accept_token(Slot& slot, llama_token token) {
+    slot.n_generated++;
+    if (llama_vocab_is_eog(vocab_, token)) return false;
+
+    char buf[256];
+    int n = llama_token_to_piece(vocab_, token, buf, sizeof(buf), 0, true);
+    if (n > 0 && slot.stream->push(buf, n)) return false;
+
+    std::string chunk;
+    if (slot.stream->take_ready(now_ms(), chunk) && slot.request.on_text) {
+        slot.request.on_text(chunk);
+    }
+
+    slot.tokens.push_back(token);
+    return slot.n_generated < slot.request.max_tokens && (int) slot.tokens.size() < slot.n_cells;
+}
+
+void BatchScheduler::run() {
+    if (thread_start_) thread_start_();
+
+    const int32_t n_batch = llama_n_batch(ctx_);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+
+    while (true) {
+        std::vector<Pending> cancelled_pending;
+        std::vector<Pending> rejected_pending;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] {
+                if (stopping_ || (!queue_.empty() && !blocked_)) return true;
+                return std::any_of(slots_.begin(), slots_.end(), [](const Slot& s) { return s.active; });
+            });
+            if (stopping_) break;
+
+            // Drop queued requests that were cancelled before they started or can never fit
+            for (auto it = queue_.begin(); it != queue_.end();) {
+                const bool cancelled = it->cancelled->load();
+                if (cancelled || (int) it->request.prompt.size() >= n_cells_) {
+                    cancel_flags_.erase(it->handle);
+                    (cancelled ? cancelled_pending : rejected_pending).push_back(std::move(*it));
+                    it = queue_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (Pending& pending : cancelled_pending) {
+            if (pending.request.on_done) pending.request.on_done("", true, nullptr, queued_stats(pending, true));
+        }
+        for (Pending& pending : rejected_pending) {
+            if (pending.request.on_done) {
+                pending.request.on_done("", false, "Prompt does not fit in the scheduler's KV cells", queued_stats(pending, false));
+            }
+        }
+
+        for (Slot& slot : slots_) {
+            if (slot.active && slot.cancelled->load()) finish(slot, true);
+            else if (slot.active && slot.tokens.empty()) finish(slot, false);
+        }
+
+        std::vector<std::pair<Slot*, llama_token>> sampled;
+        std::vector<Slot*> in_batch;
+        std::vector<bool> prefilling; // Per in_batch entry: prompt tokens rather than the next generated one
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(ctx_mutex_);
+
+            // Someone cleared the whole cache: the requests keep their tokens, so prefill them again
+            const uint32_t epoch = ctx_epoch_.load();
+            if (epoch != seen_epoch_) {
+                seen_epoch_ = epoch;
+                for (Slot& slot : slots_) slot.n_past = 0;
+            }
+
+            // Fill free sequences in queue order while the head's worst case fits. The head waits
+            // rather than being overtaken, so short requests cannot starve a long one.
+            {
+                std::lock_guard<std::mutex> queue_lock(mutex_);
+                int n_free = free_cells();
+                for (Slot& slot : slots_) {
+                    if (slot.active || queue_.empty()) continue;
+                    const int n_cells = cells_needed(queue_.front().request);
+                    if (n_cells > n_free) break;
+                    admit(slot, queue_.front(), n_cells);
+                    queue_.pop_front();
+                    n_free -= n_cells;
+                }
+                // With nothing running only the other sequences can free cells; sleep until wake()
+                blocked_ = !queue_.empty() &&
+                           std::none_of(slots_.begin(), slots_.end(), [](const Slot& s) { return s.active; });
+            }
+
+            // Generating sequences first (one token each), then prompt chunks with the remaining room
+            batch.n_tokens = 0;
+            for (Slot& slot : slots_) slot.batch_index = -1;
+            for (int pass = 0; pass < 2; pass++) {
+                for (Slot& slot : slots_) {
+                    if (!slot.active) continue;
+                    const int n_pending = (int) slot.tokens.size() - slot.n_past;
+                    if (n_pending <= 0 || (pass == 0) != (n_pending == 1)) continue;
+
+                    const int n_take = std::min(n_pending, n_batch - batch.n_tokens);
+                    if (n_take <= 0) continue;
+                    if (slot.n_past == 0) {
+                        llama_memory_seq_rm(llama_get_memory(ctx_), slot.seq, -1, -1);
+                    }
+                    for (int i = 0; i < n_take; i++) {
+                        const int pos = slot.n_past + i;
+                        const bool last = pos == (int) slot.tokens.size() - 1;
+                        if (last) slot.batch_index = batch.n_tokens;
+                        batch.token[batch.n_tokens] = slot.tokens[pos];
+                        batch.pos[batch.n_tokens] = pos;
+                        batch.n_seq_id[batch.n_tokens] = 1;
+                        batch.seq_id[batch.n_tokens][0] = slot.seq;
+                        batch.logits[batch.n_tokens] = last ? 1 : 0;
+                        batch.n_tokens++;
+                    }
+                    slot.n_past += n_take;
+                    in_batch.push_back(&slot);
+                    prefilling.push_back(pass == 1 || slot.n_generated == 0);
+                }
+            }
+            if (batch.n_tokens == 0) continue;
+
+            const int64_t t_decode = monotonic_us();
+            {
+                TraceSpan span("decode", "scheduler");
+                span.arg("tokens", batch.n_tokens);
+                failed = llama_decode(ctx_, batch) != 0;
+            }
+            if (!failed) {
+                TraceSpan span("sample", "scheduler");
+                for (Slot& slot : slots_) {
+                    if (slot.active && slot.batch_index >= 0) {
+                        sampled.emplace_back(&slot, llama_sampler_sample(slot.sampler, ctx_, slot.batch_index));
+                    }
+                }
+            }
+
+            // Every request in the batch waited for all of it, so each is charged the whole step
+            const int64_t t_done = monotonic_us();
+            const double step_ms = (t_done - t_decode) / 1000.0;
+            const int kv_used = kv_cells_used(ctx_);
+            TraceRecorder::global().counter("kv_used", kv_used);
+            for (size_t i = 0; i < in_batch.size(); i++) {
+                RequestStats& stats = in_batch[i]->stats;
+                if (prefilling[i]) {
+                    stats.prefill_ms += step_ms;
+                    stats.n_prefill_batches++;
+                } else {
+                    stats.decode_ms += step_ms;
+                }
+                stats.max_batch_tokens = std::max(stats.max_batch_tokens, (int) batch.n_tokens);
+                stats.kv_used = kv_used;
+            }
+            for (auto& entry : sampled) {
+                if (entry.first->n_generated == 0) entry.first->stats.ttft_ms = (t_done - entry.first->submit_us) / 1000.0;
+            }
+        }
+
+        if (failed) {
+            for (Slot* slot : in_batch) finish(*slot, false, "llama_decode failed");
+        }
+        for (auto& entry : sampled) {
+            if (!accept_token(*entry.first, entry.second)) finish(*entry.first, false);
+        }
+    }
+
+    // Shutting down: nothing may be left without its on_done
+    for (Slot& slot : slots_) {
+        if (slot.active) finish(slot, true);
+    }
+    for (Pending& pending : queue_) {
+        if (pending.request.on_done) pending.request.on_done("", true, nullptr, queued_stats(pending, true));
+    }
+    queue_.clear();
+
+    llama_batch_free(batch);
+    if (thread_stop_) thread_stop_();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Continuous-batching text generation over a shared llama_context.
+//
+// Every request gets its own sequence id, a handle and a cancellation flag. A worker thread runs one
+// llama_decode per iteration that carries the next token of every generating request plus prompt
+// chunks of newly admitted ones, so requests join mid-flight and a long prompt is prefilled in
+// pieces instead of stalling the others. The context is shared with the single-sequence chat path:
+// every use of it goes through ctx_mutex, and whoever wipes all sequences bumps ctx_epoch so the
+// scheduler re-prefills its requests.
+//
+// The KV cells are shared as well. A request is admitted only once its worst case, prompt plus
+// max_tokens, fits in the cells that are free: scheduled requests together hold at most n_cells,
+// and never what the other sequences hold or have claimed through external_cells. A request that
+// can never fit, or whose decode fails anyway, completes with an error.
+
+#include "llama.h"
+#include "request_stats.h"
+#include "token_stream.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct GenerationRequest {
+    std::vector<llama_token> prompt;
+    int max_tokens = 512;
+    double tokenize_ms = 0; // Spent by the caller building prompt, passed through to the stats
+    // Both run on the worker thread. on_text receives coalesced UTF-8 chunks; on_done runs exactly
+    // once with the whole output and the request's stats, including after cancellation or a failure,
+    // when error says what went wrong (null otherwise).
+    std::function<void(const std::string& text)> on_text;
+    std::function<void(const std::string& text, bool cancelled, const char* error, const RequestStats& stats)> on_done;
+};
+
+class BatchScheduler {
+public:
+    // Sequences first_seq .. first_seq + n_slots - 1 of ctx belong to the scheduler and hold at most
+    // n_cells KV cells together. external_cells is what the other sequences have claimed beyond what
+    // they already hold; it is written under ctx_mutex. thread_start and thread_stop run on the
+    // worker thread (e.g. to attach it to the JVM).
+    BatchScheduler(llama_context* ctx, std::mutex& ctx_mutex, const std::atomic<uint32_t>& ctx_epoch,
+                   const std::atomic<int>& external_cells, llama_seq_id first_seq, int n_slots, int n_cells,
+                   std::vector<std::string> stop_sequences,
+                   std::function<void()> thread_start, std::function<void()> thread_stop);
+
+    // Cancels every request and joins the worker
+    ~BatchScheduler();
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    // Queue a request; it is admitted as soon as a sequence is free. Returns its handle.
+    int64_t submit(GenerationRequest request);
+
+    // Request cancellation. Returns false if the handle is unknown or already finished.
+    bool cancel(int64_t handle);
+
+    // KV cells the running requests may grow to. Call with ctx_mutex held.
+    int reserved_cells() const { return reserved_cells_; }
+
+    // Retry admission after external_cells went down
+    void wake();
+
+private:
+    struct Pending {
+        int64_t handle;
+        GenerationRequest request;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        int64_t submit_us;
+    };
+
+    struct Slot {
+        llama_seq_id seq;
+        bool active = false;
+        int64_t handle = 0;
+        GenerationRequest request;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::vector<llama_token> tokens; // Prompt followed by generated tokens
+        int n_past = 0;                  // Leading tokens already in the KV cache
+        int n_generated = 0;
+        int batch_index = -1;            // Logits row in the current batch, -1 if none
+        int n_cells = 0;                 // KV cells reserved for prompt and output
+        llama_sampler* sampler = nullptr;
+        std::unique_ptr<TokenStream> stream;
+        int64_t submit_us = 0;
+        RequestStats stats;
+    };
+
+    void run();
+    int cells_needed(const GenerationRequest& request) const;
+    int free_cells() const;
+    void admit(Slot& slot, Pending& pending, int n_cells);
+    void finish(Slot& slot, bool cancelled, const char* error = nullptr);
+    RequestStats queued_stats(const Pending& pending, bool cancelled) const;
+    bool accept_token(Slot& slot, llama_token token);
+
+    llama_context* ctx_;
+    const llama_vocab* vocab_;
+    std::mutex& ctx_mutex_;
+    const std::atomic<uint32_t>& ctx_epoch_;
+    uint32_t seen_epoch_;
+    const std::atomic<int>& external_cells_;
+    const int n_cells_;
+    int reserved_cells_ = 0; // Sum of the active slots' n_cells, guarded by ctx_mutex_
+    std::vector<std::string> stop_sequences_;
+    std::function<void()> thread_start_;
+    std::function<void()> thread_stop_;
+
+    std::vector<Slot> slots_;
+
+    std::mutex mutex_; // Guards queue_, cancel_flags_, next_handle_, stopping_ and blocked_; taken after ctx_mutex_
+    std::condition_variable cv_;
+    std::deque<Pending> queue_;
+    std::unordered_map<int64_t, std::shared_ptr<std::atomic<bool>>> cancel_flags_;
+    int64_t next_handle_ = 1;
+    bool stopping_ = false;
+    bool blocked_ = false; // The queue head waits for cells held outside the scheduler
+
+    std::thread worker_;
+};
@@ -0,0 +1,476 @@
+#include "text_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <unordered_set>
+#include <unistd.h>
+
+namespace {
+
+const char TEXT_INDEX_MAGIC[4] = {'S', 'N', 'T', 'I'};
+const uint32_t TEXT_INDEX_VERSION = 1;
+
+const float BM25_K1 = 1.2f;
+const float BM25_B = 0.75f;
+const size_t MAX_TERM_BYTES = 64;
+
+// Split text into lowercase terms. ASCII letters and digits form words; bytes of multi-byte UTF-8
+// sequences are treated as word characters so non-Latin scripts stay searchable.
+void split_terms(const std::string& text, std::vector<std::string>& out) {
+    out.clear();
+    std::string current;
+    for (unsigned char c : text) {
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            current += (char) c;
+        } else if (c >= 'A' && c <= 'Z') {
+            current += (char) (c - 'A' + 'a');
+        } else if (!current.empty()) {
+            out.push_back(current.substr(0, MAX_TERM_BYTES));
+            current.clear();
+        }
+    }
+    if (!current.empty()) out.push_back(current.substr(0, MAX_TERM_BYTES));
+}
+
+void put_varint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t) (v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t) v);
+}
+
+uint32_t get_varint(const uint8_t*& p, const uint8_t* end) {
+    uint32_t v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        const uint8_t byte = *p++;
+        v |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return v;
+}
+
+float bm25_idf(uint32_t df, uint32_t n_docs) {
+    return std::log(1.0f + ((float) n_docs - df + 0.5f) / (df + 0.5f));
+}
+
+// Sequential reader over one compressed posting list
+struct PostingCursor {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t doc = 0;
+    uint32_t tf = 0;
+    bool valid = true;
+    bool started = false;
+
+    PostingCursor(const std::vector<uint8_t>& postings) : p(postings.data()), end(postings.data() + postings.size()) {
+        next();
+    }
+
+    void next() {
+        if (p >= end) {
+            valid = false;
+            return;
+        }
+        const uint32_t delta = get_varint(p, end);
+        doc = started ? doc + delta : delta;
+        started = true;
+        tf = get_varint(p, end);
+    }
+
+    void advance_to(uint32_t target) {
+        while (valid && doc < target) next();
+    }
+};
+
+struct FileWriter {
+    FILE* f;
+    bool ok = true;
+
+    void bytes(const void* data, size_t len) {
+        if (ok && len > 0) ok = fwrite(data, 1, len, f) == len;
+    }
+    void u32(uint32_t v) { bytes(&v, sizeof(v)); }
+    void u64(uint64_t v) { bytes(&v, sizeof(v)); }
+    void str(const std::string& s) {
+        u32(s.size());
+        bytes(s.data(), s.size());
+    }
+};
+
+struct FileReader {
+    FILE* f;
+    bool ok = true;
+
+    void bytes(void* data, size_t len) {
+        if (ok && len > 0) ok = fread(data, 1, len, f) == len;
+    }
+    uint32_t u32() { uint32_t v = 0; bytes(&v, sizeof(v)); return v; }
+    uint64_t u64() { uint64_t v = 0; bytes(&v, sizeof(v)); return v; }
+    // Lengths are bounded so a corrupt file cannot trigger a huge allocation
+    bool str(std::string& s, uint32_t max_len) {
+        uint32_t len = u32();
+        if (!ok || len > max_len) return ok = false;
+        s.resize(len);
+        bytes(&s[0], len);
+        return ok;
+    }
+};
+
+} // namespace
+
+void TextIndex::add(const std::string& id, const std::string& text) {
+    remove(id);
+
+    std::vector<std::string> words;
+    split_terms(text, words);
+
+    // Term frequencies in first-occurrence order
+    std::unordered_map<uint32_t, uint32_t> tf;
+    std::vector<uint32_t> distinct;
+    for (const std::string& w : words) {
+        auto it = term_ids_.find(w);
+        uint32_t term_id;
+        if (it == term_ids_.end()) {
+            term_id = terms_.size();
+            term_ids_.emplace(w, term_id);
+            terms_.emplace_back();
+        } else {
+            term_id = it->second;
+        }
+        if (tf[term_id]++ == 0) distinct.push_back(term_id);
+    }
+
+    const uint32_t doc = doc_ids_.size();
+    doc_ids_.push_back(id);
+    doc_lengths_.push_back(words.size());
+    deleted_.push_back(0);
+    id_to_doc_[id] = doc;
+    total_length_ += words.size();
+    n_live_++;
+
+    // Documents are numbered in insertion order, so postings stay sorted by appending
+    for (uint32_t term_id : distinct) {
+        Term& term = terms_[term_id];
+        const uint32_t freq = tf[term_id];
+        put_varint(term.postings, term.n_postings == 0 ? doc : doc - term.last_doc);
+        put_varint(term.postings, freq);
+        term.n_postings++;
+        term.df++;
+        term.last_doc = doc;
+        term.max_tf = std::max(term.max_tf, freq);
+    }
+    doc_terms_.push_back(std::move(distinct));
+}
+
+bool TextIndex::remove(const std::string& id) {
+    auto it = id_to_doc_.find(id);
+    if (it == id_to_doc_.end()) return false;
+
+    const uint32_t doc = it->second;
+    deleted_[doc] = 1;
+    for (uint32_t term_id : doc_terms_[doc]) {
+        terms_[term_id].df--;
+    }
+    total_length_ -= doc_lengths_[doc];
+    n_live_--;
+    id_to_doc_.erase(it);
+    return true;
+}
+
+void TextIndex::search(const std::string& query, int k, std::vector<std::pair<std::string, float>>& out) const {
+    out.clear();
+    if (n_live_ == 0 || k <= 0) return;
+
+    std::vector<std::string> words;
+    split_terms(query, words);
+
+    // Distinct query terms with their BM25 upper bounds (tf at its max, document length at 0)
+    struct QueryTerm {
+        const Term* term;
+        float idf;
+        float upper_bound;
+    };
+    std::vector<QueryTerm> query_terms;
+    std::unordered_set<uint32_t> seen;
+    for (const std::string& w : words) {
+        auto it = term_ids_.find(w);
+        if (it == term_ids_.end() || !seen.insert(it->second).second) continue;
+        const Term& term = terms_[it->second];
+        if (term.df == 0) continue;
+        const float idf = bm25_idf(term.df, n_live_);
+        const float max_tf = (float) term.max_tf;
+        query_terms.push_back({&term, idf, idf * max_tf * (BM25_K1 + 1) / (max_tf + BM25_K1 * (1 - BM25_B))});
+    }
+    if (query_terms.empty()) return;
+
+    // MaxScore: order lists by upper bound, and once the k-th best score exceeds the summed bounds
+    // of the weakest lists those lists are only probed for documents found through stronger ones.
+    std::sort(query_terms.begin(), query_terms.end(),
+              [](const QueryTerm& a, const QueryTerm& b) { return a.upper_bound < b.upper_bound; });
+    const size_t n_terms = query_terms.size();
+    std::vector<float> prefix_bound(n_terms);
+    std::vector<PostingCursor> cursors;
+    cursors.reserve(n_terms);
+    for (size_t i = 0; i < n_terms; i++) {
+        prefix_bound[i] = query_terms[i].upper_bound + (i > 0 ? prefix_bound[i - 1] : 0.0f);
+        cursors.emplace_back(query_terms[i].term->postings);
+    }
+
+    const float avg_length = (float) total_length_ / n_live_;
+    auto term_score = [&](size_t i, uint32_t doc) {
+        const float tf = (float) cursors[i].tf;
+        const float norm = BM25_K1 * (1 - BM25_B + BM25_B * doc_lengths_[doc] / avg_length);
+        return query_terms[i].idf * tf * (BM25_K1 + 1) / (tf + norm);
+    };
+
+    // Min-heap of the current top-k by score
+    typedef std::pair<float, uint32_t> Hit;
+    std::vector<Hit> heap;
+    float threshold = 0.0f;
+    size_t first_essential = 0;
+
+    while (first_essential < n_terms) {
+        uint32_t doc = UINT32_MAX;
+        for (size_t i = first_essential; i < n_terms; i++) {
+            if (cursors[i].valid && cursors[i].doc < doc) doc = cursors[i].doc;
+        }
+        if (doc == UINT32_MAX) break;
+
+        float score = 0.0f;
+        for (size_t i = first_essential; i < n_terms; i++) {
+            if (cursors[i].valid && cursors[i].doc == doc) {
+                score += term_score(i, doc);
+                cursors[i].next();
+            }
+        }
+        for (size_t i = first_essential; i-- > 0;) {
+            if ((int) heap.size() >= k && score + prefix_bound[i] <= threshold) break;
+            cursors[i].advance_to(doc);
+            if (cursors[i].valid && cursors[i].doc == doc) {
+                score += term_score(i, doc);
+            }
+        }
+
+        if (deleted_[doc]) continue;
+        if ((int) heap.size() < k) {
+            heap.emplace_back(score, doc);
+            std::push_heap(heap.begin(), heap.end(), std::greater<Hit>());
+        } else if (score > threshold) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Hit>());
+            heap.back() = Hit(score, doc);
+            std::push_heap(heap.begin(), heap.end(), std::greater<Hit>());
+        }
+        if ((int) heap.size() >= k) {
+            threshold = heap.front().first;
+            while (first_essential < n_terms && prefix_bound[first_essential] <= threshold) {
+                first_essential++;
+            }
+        }
+    }
+
+    std::sort(heap.begin(), heap.end(), std::greater<Hit>());
+    for (const Hit& hit : heap) {
+        out.emplace_back(doc_ids_[hit.second], hit.first);
+    }
+}
+
+void TextIndex::search_hybrid(const std::string& query, int k, const std::vector<std::pair<std::string, float>>& vector_hits,
+                              float alpha, std::vector<std::pair<std::string, float>>& out) const {
+    // Widen the lexical candidate set so documents that rank well on both signals are not missed
+    std::vector<std::pair<std::string, float>> lexical;
+    search(query, std::max(k * 4, 32), lexical);
+
+    const float max_bm25 = lexical.empty() ? 0.0f : lexical.front().second;
+    std::unordered_map<std::string, float> fused;
+    for (const auto& hit : lexical) {
+        fused[hit.first] += (1.0f - alpha) * (max_bm25 > 0.0f ? hit.second / max_bm25 : 0.0f);
+    }
+    for (const auto& hit : vector_hits) {
+        fused[hit.first] += alpha * std::max(hit.second, 0.0f);
+    }
+
+    out.assign(fused.begin(), fused.end());
+    const size_t n = std::min(out.size(), (size_t) std::max(k, 0));
+    std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                      [](const std::pair<std::string, float>& a, const std::pair<std::string, float>& b) { return a.second > b.second; });
+    out.resize(n);
+}
+
+void TextIndex::compact() {
+    std::vector<uint32_t> remap(doc_ids_.size(), UINT32_MAX);
+    uint32_t next_doc = 0;
+    for (uint32_t doc = 0; doc < doc_ids_.size(); doc++) {
+        if (!deleted_[doc]) remap[doc] = next_doc++;
+    }
+
+    for (Term& term : terms_) {
+        std::vector<uint8_t> postings;
+        uint32_t n_postings = 0;
+        uint32_t last_doc = 0;
+        uint32_t max_tf = 0;
+        for (PostingCursor cursor(term.postings); cursor.valid; cursor.next()) {
+            const uint32_t doc = remap[cursor.doc];
+            if (doc == UINT32_MAX) continue;
+            put_varint(postings, n_postings == 0 ? doc : doc - last_doc);
+            put_varint(postings, cursor.tf);
+            n_postings++;
+            last_doc = doc;
+            max_tf = std::max(max_tf, cursor.tf);
+        }
+        term.postings.swap(postings);
+        term.n_postings = n_postings;
+        term.last_doc = last_doc;
+        term.max_tf = max_tf;
+    }
+
+    for (uint32_t doc = 0; doc < doc_ids_.size(); doc++) {
+        const uint32_t to = remap[doc];
+        if (to == UINT32_MAX || to == doc) continue;
+        doc_ids_[to] = std::move(doc_ids_[doc]);
+        doc_lengths_[to] = doc_lengths_[doc];
+        doc_terms_[to] = std::move(doc_terms_[doc]);
+    }
+    doc_ids_.resize(next_doc);
+    doc_lengths_.resize(next_doc);
+    doc_terms_.resize(next_doc);
+    deleted_.assign(next_doc, 0);
+
+    id_to_doc_.clear();
+    for (uint32_t doc = 0; doc < next_doc; doc++) {
+        id_to_doc_[doc_ids_[doc]] = doc;
+    }
+}
+
+bool TextIndex::save(const std::string& path) {
+    if (n_live_ < doc_ids_.size() && (doc_ids_.size() - n_live_) * 4 > doc_ids_.size()) {
+        compact();
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+
+    std::vector<std::string> term_strings(terms_.size());
+    for (const auto& entry : term_ids_) {
+        term_strings[entry.second] = entry.first;
+    }
+
+    FileWriter w{f};
+    w.bytes(TEXT_INDEX_MAGIC, sizeof(TEXT_INDEX_MAGIC));
+    w.u32(TEXT_INDEX_VERSION);
+    w.u32(terms_.size());
+    w.u32(doc_ids_.size());
+    w.u64(total_length_);
+    for (size_t t = 0; t < terms_.size(); t++) {
+        const Term& term = terms_[t];
+        w.str(term_strings[t]);
+        w.u32(term.n_postings);
+        w.u32(term.df);
+        w.u32(term.max_tf);
+        w.u32(term.last_doc);
+        w.u32(term.postings.size());
+        w.bytes(term.postings.data(), term.postings.size());
+    }
+    for (size_t doc = 0; doc < doc_ids_.size(); doc++) {
+        w.str(doc_ids_[doc]);
+        w.u32(doc_lengths_[doc]);
+        w.u32(deleted_[doc]);
+        w.u32(doc_terms_[doc].size());
+        w.bytes(doc_terms_[doc].data(), doc_terms_[doc].size() * sizeof(uint32_t));
+    }
+
+    bool ok = w.ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+TextIndex* TextIndex::load(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return nullptr;
+
+    FileReader r{f};
+    char magic[4];
+    r.bytes(magic, sizeof(magic));
+    const uint32_t version = r.u32();
+    const uint32_t n_terms = r.u32();
+    const uint32_t n_docs = r.u32();
+    const uint64_t total_length = r.u64();
+    if (!r.ok || memcmp(magic, TEXT_INDEX_MAGIC, sizeof(magic)) != 0 || version != TEXT_INDEX_VERSION) {
+        fclose(f);
+        return nullptr;
+    }
+
+    TextIndex* index = new TextIndex();
+    index->total_length_ = total_length;
+    index->terms_.resize(n_terms);
+    for (uint32_t t = 0; t < n_terms && r.ok; t++) {
+        Term& term = index->terms_[t];
+        std::string text;
+        if (!r.str(text, MAX_TERM_BYTES)) break;
+        term.n_postings = r.u32();
+        term.df = r.u32();
+        term.max_tf = r.u32();
+        term.last_doc = r.u32();
+        const uint32_t n_bytes = r.u32();
+        if (!r.ok || n_bytes > (uint64_t) n_docs * 10) {
+            r.ok = false;
+            break;
+        }
+        term.postings.resize(n_bytes);
+        r.bytes(term.postings.data(), n_bytes);
+        index->term_ids_.emplace(text, t);
+    }
+
+    index->doc_ids_.resize(n_docs);
+    index->doc_lengths_.resize(n_docs);
+    index->deleted_.resize(n_docs);
+    index->doc_terms_.resize(n_docs);
+    for (uint32_t doc = 0; doc < n_docs && r.ok; doc++) {
+        if (!r.str(index->doc_ids_[doc], 4096)) break;
+        index->doc_lengths_[doc] = r.u32();
+        index->deleted_[doc] = r.u32() ? 1 : 0;
+        const uint32_t n_doc_terms = r.u32();
+        if (!r.ok || n_doc_terms > n_terms) {
+            r.ok = false;
+            break;
+        }
+        index->doc_terms_[doc].resize(n_doc_terms);
+        r.bytes(index->doc_terms_[doc].data(), n_doc_terms * sizeof(uint32_t));
+        for (uint32_t term_id : index->doc_terms_[doc]) {
+            if (term_id >= n_terms) r.ok = false;
+        }
+        if (!index->deleted_[doc]) {
+            index->id_to_doc_[index->doc_ids_[doc]] = doc;
+            index->n_live_++;
+        }
+    }
+    fclose(f);
+
+    // Postings index the per-document columns, so decode each list once: doc ids must increase,
+    // stay below n_docs and agree with the counts appends continue from
+    for (uint32_t t = 0; t < n_terms && r.ok; t++) {
+        const Term& term = index->terms_[t];
+        uint32_t n_postings = 0;
+        uint32_t last_doc = 0;
+        for (PostingCursor cursor(term.postings); cursor.valid && r.ok; cursor.next()) {
+            r.ok = cursor.doc < n_docs && (n_postings == 0 || cursor.doc > last_doc);
+            last_doc = cursor.doc;
+            n_postings++;
+        }
+        r.ok = r.ok && n_postings == term.n_postings && (n_postings == 0 || last_doc == term.last_doc);
+    }
+
+    if (!r.ok) {
+        delete index;
+        return nullptr;
+    }
+    return index;
+}
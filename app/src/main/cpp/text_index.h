@@ -0,0 +1,62 @@
+#pragma once
+
+// Full-text inverted index with BM25 ranking over notes.
+//
+// Postings are delta + varint compressed per term. Documents can be added, replaced and removed
+// incrementally; removals are tombstones that are compacted away on save. Top-k retrieval uses
+// MaxScore so lists that cannot lift a document into the current top-k are skipped.
+// Not thread-safe: callers serialize access.
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class TextIndex {
+public:
+    // Read an index written by save(). Returns nullptr if it is missing or corrupt.
+    static TextIndex* load(const std::string& path);
+
+    // Write the index to path (via a temp file + rename). Compacts removed documents first.
+    bool save(const std::string& path);
+
+    // Index text under id, replacing any previous text for id
+    void add(const std::string& id, const std::string& text);
+
+    // Remove id from results. Returns false if it was not present.
+    bool remove(const std::string& id);
+
+    // Top-k ids by BM25 score, best first
+    void search(const std::string& query, int k, std::vector<std::pair<std::string, float>>& out) const;
+
+    // Fuse BM25 with cosine similarities from the vector index: alpha * cosine + (1 - alpha) * bm25,
+    // with BM25 scaled to [0, 1] by the best lexical hit. Candidates are the union of both result sets.
+    void search_hybrid(const std::string& query, int k, const std::vector<std::pair<std::string, float>>& vector_hits,
+                       float alpha, std::vector<std::pair<std::string, float>>& out) const;
+
+    uint32_t size() const { return n_live_; }
+
+private:
+    struct Term {
+        std::vector<uint8_t> postings; // (doc delta, tf) varint pairs in increasing doc order
+        uint32_t n_postings = 0;       // Including postings of removed documents
+        uint32_t df = 0;               // Live documents containing the term
+        uint32_t max_tf = 0;           // Upper bound for MaxScore
+        uint32_t last_doc = 0;
+    };
+
+    void compact();
+
+    std::unordered_map<std::string, uint32_t> term_ids_;
+    std::vector<Term> terms_;
+
+    std::vector<std::string> doc_ids_;
+    std::vector<uint32_t> doc_lengths_;
+    std::vector<uint8_t> deleted_;
+    std::vector<std::vector<uint32_t>> doc_terms_; // Distinct term ids per document, for df upkeep
+    std::unordered_map<std::string, uint32_t> id_to_doc_;
+
+    uint64_t total_length_ = 0; // Sum of live document lengths
+    uint32_t n_live_ = 0;
+};
@@ -0,0 +1,124 @@
+#include "token_stream.h"
+
+#include <algorithm>
+#include <deque>
+
+StopMatcher::StopMatcher(const std::vector<std::string>& patterns) {
+    std::array<int32_t, 256> empty;
+    empty.fill(-1);
+    next_.push_back(empty);
+    depth_.push_back(0);
+    match_len_.push_back(0);
+
+    // Trie of all patterns
+    for (const std::string& pattern : patterns) {
+        if (pattern.empty()) continue;
+        int32_t state = 0;
+        for (unsigned char c : pattern) {
+            if (next_[state][c] < 0) {
+                next_[state][c] = next_.size();
+                next_.push_back(empty);
+                depth_.push_back(depth_[state] + 1);
+                match_len_.push_back(0);
+            }
+            state = next_[state][c];
+        }
+        match_len_[state] = pattern.size();
+    }
+
+    // Breadth-first: fill missing transitions through failure links, turning the trie into a DFA.
+    // A state's failure target is shallower, so its table and match length are already final.
+    std::vector<int32_t> fail(next_.size(), 0);
+    std::deque<int32_t> queue;
+    for (int c = 0; c < 256; c++) {
+        int32_t child = next_[0][c];
+        if (child < 0) {
+            next_[0][c] = 0;
+        } else {
+            queue.push_back(child);
+        }
+    }
+    while (!queue.empty()) {
+        const int32_t state = queue.front();
+        queue.pop_front();
+        match_len_[state] = std::max(match_len_[state], match_len_[fail[state]]);
+        for (int c = 0; c < 256; c++) {
+            int32_t child = next_[state][c];
+            if (child < 0) {
+                next_[state][c] = next_[fail[state]][c];
+            } else {
+                fail[child] = next_[fail[state]][c];
+                queue.push_back(child);
+            }
+        }
+    }
+}
+
+size_t StopMatcher::feed(const char* data, size_t len, size_t* end) {
+    for (size_t i = 0; i < len; i++) {
+        state_ = next_[state_][(unsigned char) data[i]];
+        if (match_len_[state_] > 0) {
+            *end = i + 1;
+            return match_len_[state_];
+        }
+    }
+    return 0;
+}
+
+size_t utf8_incomplete_tail(const std::string& s) {
+    const size_t n = s.size();
+    for (size_t back = 1; back <= 3 && back <= n; back++) {
+        const unsigned char c = s[n - back];
+        if ((c & 0xC0) == 0x80) continue; // Continuation byte, keep looking for the lead byte
+        size_t expected = 1;
+        if ((c & 0xE0) == 0xC0) expected = 2;
+        else if ((c & 0xF0) == 0xE0) expected = 3;
+        else if ((c & 0xF8) == 0xF0) expected = 4;
+        return expected > back ? back : 0;
+    }
+    return 0;
+}
+
+TokenStream::TokenStream(const std::vector<std::string>& stop_sequences, size_t flush_bytes, int64_t flush_interval_ms)
+    : matcher_(stop_sequences), flush_bytes_(flush_bytes), flush_interval_ms_(flush_interval_ms) {}
+
+bool TokenStream::push(const char* piece, size_t len) {
+    if (stopped_) return true;
+
+    size_t end = 0;
+    const size_t match_len = matcher_.feed(piece, len, &end);
+    if (match_len > 0) {
+        // The match may have started in text appended earlier
+        text_.append(piece, end);
+        text_.resize(text_.size() - match_len);
+        released_ = std::min(released_, text_.size());
+        stopped_ = true;
+        return true;
+    }
+    text_.append(piece, len);
+    return false;
+}
+
+size_t TokenStream::releasable_end() const {
+    // Hold back a possible stop-sequence prefix and an incomplete UTF-8 character
+    const size_t held = stopped_ ? 0 : std::max(matcher_.partial_match(), utf8_incomplete_tail(text_));
+    return text_.size() > held ? text_.size() - held : 0;
+}
+
+bool TokenStream::take_ready(int64_t now_ms, std::string& out) {
+    const size_t end = releasable_end();
+    if (end <= released_) return false;
+    if (end - released_ < flush_bytes_ && now_ms - last_release_ms_ < flush_interval_ms_) return false;
+
+    out.assign(text_, released_, end - released_);
+    released_ = end;
+    last_release_ms_ = now_ms;
+    return true;
+}
+
+void TokenStream::finish(std::string& out) {
+    // Generation is over: a partial stop sequence is ordinary text, a truncated character is dropped
+    text_.resize(text_.size() - utf8_incomplete_tail(text_));
+    out.assign(text_, std::min(released_, text_.size()), std::string::npos);
+    released_ = text_.size();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Streaming detokenizer output for completion().
+//
+// Token pieces are appended as raw bytes. Text is only released once it is complete UTF-8 and can no
+// longer turn into a stop sequence, and then in coalesced chunks so the caller crosses into Java a
+// few times per second instead of once per token. Stop sequences are matched with an Aho-Corasick
+// automaton that advances once per byte. The stop sequence itself never reaches the output.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Aho-Corasick automaton over byte strings, compiled to a full transition table
+class StopMatcher {
+public:
+    explicit StopMatcher(const std::vector<std::string>& patterns);
+
+    // Feed bytes. Returns the length of the pattern completed at data[*end - 1] and sets *end,
+    // or returns 0 if no pattern completed within data.
+    size_t feed(const char* data, size_t len, size_t* end);
+
+    // Length of the longest suffix of the input so far that is a proper prefix of some pattern
+    size_t partial_match() const { return depth_[state_]; }
+
+    void reset() { state_ = 0; }
+
+private:
+    std::vector<std::array<int32_t, 256>> next_;
+    std::vector<uint32_t> depth_;
+    std::vector<uint32_t> match_len_; // Longest pattern ending at this state, 0 if none
+    int32_t state_ = 0;
+};
+
+class TokenStream {
+public:
+    // Release text once flush_bytes are pending or flush_interval_ms passed since the last release
+    TokenStream(const std::vector<std::string>& stop_sequences, size_t flush_bytes, int64_t flush_interval_ms);
+
+    // Append a detokenized piece. Returns true when a stop sequence completed; the text is cut
+    // before it and generation should end.
+    bool push(const char* piece, size_t len);
+
+    // Move releasable text into out if a threshold is reached. Returns false (out untouched) otherwise.
+    bool take_ready(int64_t now_ms, std::string& out);
+
+    // Move all remaining complete text into out at the end of generation
+    void finish(std::string& out);
+
+    // Whole visible output so far, including text not released yet
+    const std::string& text() const { return text_; }
+
+private:
+    size_t releasable_end() const;
+
+    StopMatcher matcher_;
+    std::string text_;
+    size_t released_ = 0;
+    bool stopped_ = false;
+
+    size_t flush_bytes_;
+    int64_t flush_interval_ms_;
+    int64_t last_release_ms_ = INT64_MIN / 2;
+};
+
+// Number of bytes at the end of s that start a UTF-8 sequence whose continuation bytes are missing
+size_t utf8_incomplete_tail(const std::string& s);
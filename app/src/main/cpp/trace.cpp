@@ -0,0 +1,96 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+// Small sequential ids instead of OS thread ids keep the format portable and the tracks readable
+int current_tid() {
+    static std::atomic<int> next_tid(1);
+    thread_local int tid = next_tid++;
+    return tid;
+}
+
+} // namespace
+
+int64_t monotonic_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRecorder& TraceRecorder::global() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+bool TraceRecorder::start(const std::string& path, size_t max_events) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_.load()) return false;
+
+    path_ = path;
+    events_.clear();
+    events_.reserve(std::min(max_events, (size_t) 4096));
+    max_events_ = max_events;
+    dropped_ = 0;
+    origin_us_ = monotonic_us();
+    enabled_ = true;
+    return true;
+}
+
+void TraceRecorder::push(const Event& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!enabled_.load()) return;
+    if (events_.size() >= max_events_) {
+        dropped_++;
+        return;
+    }
+    events_.push_back(event);
+}
+
+void TraceRecorder::complete(const char* name, const char* category, int64_t start_us, int64_t dur_us,
+                             const char* arg_name, int64_t arg_value) {
+    if (!enabled()) return;
+    push({name, category, start_us, dur_us, arg_name, arg_value, current_tid()});
+}
+
+void TraceRecorder::counter(const char* name, int64_t value) {
+    if (!enabled()) return;
+    push({name, nullptr, monotonic_us(), 0, nullptr, value, current_tid()});
+}
+
+bool TraceRecorder::stop() {
+    std::vector<Event> events;
+    std::string path;
+    size_t dropped;
+    int64_t origin_us;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_.load()) return false;
+        enabled_ = false;
+        events.swap(events_);
+        path.swap(path_);
+        dropped = dropped_;
+        origin_us = origin_us_;
+    }
+
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    fprintf(f, "{\"traceEvents\":[");
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+        fprintf(f, "%s\n", i > 0 ? "," : "");
+        if (e.category) {
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d",
+                    e.name, e.category, (long long) (e.ts_us - origin_us), (long long) e.dur_us, e.tid);
+            if (e.arg_name) fprintf(f, ",\"args\":{\"%s\":%lld}", e.arg_name, (long long) e.arg_value);
+            fprintf(f, "}");
+        } else {
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%lld}}",
+                    e.name, (long long) (e.ts_us - origin_us), e.tid, (long long) e.arg_value);
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%zu}}\n", dropped);
+    return fclose(f) == 0;
+}
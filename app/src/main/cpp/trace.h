@@ -0,0 +1,88 @@
+#pragma once
+
+// Optional trace-event recorder. While started, spans and counters are buffered in memory and written
+// on stop() as Chrome trace-event JSON, which chrome://tracing and ui.perfetto.dev open directly.
+// Stopped, a span costs one relaxed atomic load, so instrumentation stays in release builds.
+// Event names and categories must be string literals (or otherwise outlive the recording).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Monotonic clock in microseconds, also used for the per-request stats
+int64_t monotonic_us();
+
+class TraceRecorder {
+public:
+    // Events beyond max_events are dropped (and counted) so a forgotten recording cannot grow unbounded
+    static const size_t DEFAULT_MAX_EVENTS = 200000;
+
+    static TraceRecorder& global();
+
+    // Begin a recording written to path on stop(). Returns false if one is already running.
+    bool start(const std::string& path, size_t max_events = DEFAULT_MAX_EVENTS);
+
+    // End the recording and write it out. Returns false if none was running or the write failed.
+    bool stop();
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // A span of dur_us starting at start_us (monotonic_us()), with up to one integer argument
+    void complete(const char* name, const char* category, int64_t start_us, int64_t dur_us,
+                  const char* arg_name = nullptr, int64_t arg_value = 0);
+
+    // A counter track sample (e.g. KV cache cells in use)
+    void counter(const char* name, int64_t value);
+
+private:
+    struct Event {
+        const char* name;
+        const char* category; // Null for counters
+        int64_t ts_us;
+        int64_t dur_us;
+        const char* arg_name;
+        int64_t arg_value;
+        int tid;
+    };
+
+    void push(const Event& event);
+
+    std::atomic<bool> enabled_{false};
+    std::mutex mutex_; // Guards everything below
+    std::string path_;
+    std::vector<Event> events_;
+    size_t max_events_ = 0;
+    size_t dropped_ = 0;
+    int64_t origin_us_ = 0;
+};
+
+// Records the enclosing scope as a span on the global recorder, if it is running
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category)
+        : name_(name), category_(category), start_us_(TraceRecorder::global().enabled() ? monotonic_us() : -1) {}
+
+    ~TraceSpan() {
+        if (start_us_ >= 0) {
+            TraceRecorder::global().complete(name_, category_, start_us_, monotonic_us() - start_us_, arg_name_, arg_value_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void arg(const char* name, int64_t value) {
+        arg_name_ = name;
+        arg_value_ = value;
+    }
+
+private:
+    const char* name_;
+    const char* category_;
+    int64_t start_us_;
+    const char* arg_name_ = nullptr;
+    int64_t arg_value_ = 0;
+};
@@ -0,0 +1,598 @@
+#include "vector_index.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+enum Section {
+    SECTION_VECTORS,
+    SECTION_SCALES,
+    SECTION_LEVELS,
+    SECTION_LINKS0,
+    SECTION_UPPER_OFFSET,
+    SECTION_UPPER_LINKS,
+    SECTION_DELETED,
+    SECTION_ID_OFFSETS,
+    SECTION_ID_BLOB,
+    SECTION_COUNT
+};
+
+const char INDEX_MAGIC[4] = {'S', 'N', 'V', 'I'};
+const uint32_t INDEX_VERSION = 1;
+const uint64_t SECTION_ALIGN = 64;
+
+struct IndexFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t quantized;
+    uint32_t node_count;
+    uint32_t n_live;
+    uint32_t entry_point;
+    int32_t max_level;
+    uint32_t links_per_node;
+    uint32_t links_per_node0;
+    uint64_t offsets[SECTION_COUNT]; // Byte offset of each section from the start of the file
+    uint64_t sizes[SECTION_COUNT];   // Byte size of each section
+};
+
+uint64_t align_up(uint64_t v) {
+    return (v + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+void normalize_into(const float* v, float* out, int n) {
+    normalize_f32(v, out, n);
+}
+
+} // namespace
+
+VectorIndex::VectorIndex(int dim, bool quantized) : dim_(dim), quantized_(quantized) {
+}
+
+VectorIndex::~VectorIndex() {
+    unmap();
+}
+
+void VectorIndex::unmap() {
+    if (map_addr_) {
+        munmap(map_addr_, map_size_);
+        map_addr_ = nullptr;
+        map_size_ = 0;
+    }
+}
+
+VectorIndex* VectorIndex::open(const std::string& path, int dim, bool quantized) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(IndexFileHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    const size_t file_size = st.st_size;
+    void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return nullptr;
+
+    const char* base = static_cast<const char*>(addr);
+    IndexFileHeader header;
+    memcpy(&header, base, sizeof(header));
+
+    bool valid = memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                 header.version == INDEX_VERSION &&
+                 header.dim == (uint32_t) dim &&
+                 header.quantized == (quantized ? 1u : 0u) &&
+                 header.links_per_node == (uint32_t) M &&
+                 header.links_per_node0 == (uint32_t) M0 &&
+                 header.n_live <= header.node_count &&
+                 (header.node_count == 0 || header.entry_point < header.node_count) &&
+                 header.max_level <= MAX_LEVEL;
+    for (int s = 0; s < SECTION_COUNT && valid; s++) {
+        valid = header.offsets[s] % SECTION_ALIGN == 0 &&
+                header.offsets[s] <= file_size &&
+                header.sizes[s] <= file_size - header.offsets[s];
+    }
+
+    const uint64_t n = header.node_count;
+    if (valid) {
+        const uint64_t vector_bytes = n * dim * (quantized ? sizeof(int8_t) : sizeof(float));
+        valid = header.sizes[SECTION_VECTORS] == vector_bytes &&
+                header.sizes[SECTION_SCALES] == (quantized ? n * sizeof(float) : 0) &&
+                header.sizes[SECTION_LEVELS] == n * sizeof(int32_t) &&
+                header.sizes[SECTION_LINKS0] == n * (1 + M0) * sizeof(uint32_t) &&
+                header.sizes[SECTION_UPPER_OFFSET] == n * sizeof(uint32_t) &&
+                header.sizes[SECTION_UPPER_LINKS] % sizeof(uint32_t) == 0 &&
+                header.sizes[SECTION_DELETED] == n &&
+                header.sizes[SECTION_ID_OFFSETS] == (n + 1) * sizeof(uint32_t);
+    }
+    if (!valid) {
+        munmap(addr, file_size);
+        return nullptr;
+    }
+
+    // Graph traversal jumps around the file
+    madvise(addr, file_size, MADV_RANDOM);
+
+    VectorIndex* index = new VectorIndex(dim, quantized);
+    index->map_addr_ = addr;
+    index->map_size_ = file_size;
+    index->entry_point_ = header.entry_point;
+    index->max_level_ = header.max_level;
+    index->n_live_ = header.n_live;
+
+    auto view = [&](auto& column, Section s) {
+        typedef typename std::remove_reference<decltype(column)>::type::value_type T;
+        column.mapped = reinterpret_cast<const T*>(base + header.offsets[s]);
+        column.mapped_size = header.sizes[s] / sizeof(T);
+    };
+    view(index->vectors_f32_, SECTION_VECTORS);
+    view(index->vectors_i8_, SECTION_VECTORS);
+    if (quantized) {
+        index->vectors_f32_.mapped = nullptr;
+        index->vectors_f32_.mapped_size = 0;
+    } else {
+        index->vectors_i8_.mapped = nullptr;
+        index->vectors_i8_.mapped_size = 0;
+    }
+    view(index->scales_, SECTION_SCALES);
+    view(index->levels_, SECTION_LEVELS);
+    view(index->links0_, SECTION_LINKS0);
+    view(index->upper_offset_, SECTION_UPPER_OFFSET);
+    view(index->upper_links_, SECTION_UPPER_LINKS);
+    view(index->deleted_, SECTION_DELETED);
+    view(index->id_offsets_, SECTION_ID_OFFSETS);
+    view(index->id_blob_, SECTION_ID_BLOB);
+
+    // Structural check of the per-node columns and link lists so traversal never reads out of
+    // bounds: every link names a node that has the layer it is followed on
+    const int32_t* levels = index->levels_.data();
+    const size_t upper_size = index->upper_links_.size();
+    const size_t blob_size = index->id_blob_.size();
+    auto links_valid = [&](const uint32_t* block, uint32_t max_links, int32_t layer) {
+        if (block[0] > max_links) return false;
+        for (uint32_t j = 1; j <= block[0]; j++) {
+            if (block[j] >= n || levels[block[j]] < layer) return false;
+        }
+        return true;
+    };
+    for (uint32_t i = 0; i < n && valid; i++) {
+        const int32_t level = levels[i];
+        valid = level >= 0 && level <= header.max_level &&
+                index->upper_offset_.data()[i] + (uint64_t) level * (1 + M) <= upper_size &&
+                index->id_offsets_.data()[i] <= index->id_offsets_.data()[i + 1] &&
+                links_valid(index->links0_.data() + (size_t) i * (1 + M0), M0, 0);
+        for (int32_t l = 1; l <= level && valid; l++) {
+            valid = links_valid(index->upper_links_.data() + index->upper_offset_.data()[i] + (size_t) (l - 1) * (1 + M), M, l);
+        }
+    }
+    // Search starts at the entry point on the top layer
+    if (valid && n > 0) {
+        valid = levels[header.entry_point] == header.max_level && index->id_offsets_.data()[n] <= blob_size;
+    }
+    if (!valid) {
+        delete index;
+        return nullptr;
+    }
+
+    return index;
+}
+
+bool VectorIndex::save(const std::string& path) {
+    if (n_live_ < node_count() && (node_count() - n_live_) * 4 > node_count()) {
+        compact();
+    }
+
+    IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.dim = dim_;
+    header.quantized = quantized_ ? 1 : 0;
+    header.node_count = node_count();
+    header.n_live = n_live_;
+    header.entry_point = entry_point_;
+    header.max_level = max_level_;
+    header.links_per_node = M;
+    header.links_per_node0 = M0;
+
+    // An empty index still needs the leading id offset
+    const uint32_t zero_offset = 0;
+    const void* id_offsets = id_offsets_.size() > 0 ? (const void*) id_offsets_.data() : (const void*) &zero_offset;
+    const size_t id_offsets_bytes = id_offsets_.size() > 0 ? id_offsets_.size() * sizeof(uint32_t) : sizeof(uint32_t);
+
+    const void* data[SECTION_COUNT] = {
+        quantized_ ? (const void*) vectors_i8_.data() : (const void*) vectors_f32_.data(),
+        scales_.data(), levels_.data(), links0_.data(), upper_offset_.data(),
+        upper_links_.data(), deleted_.data(), id_offsets, id_blob_.data()
+    };
+    header.sizes[SECTION_VECTORS] = quantized_ ? vectors_i8_.size() : vectors_f32_.size() * sizeof(float);
+    header.sizes[SECTION_SCALES] = quantized_ ? scales_.size() * sizeof(float) : 0;
+    header.sizes[SECTION_LEVELS] = levels_.size() * sizeof(int32_t);
+    header.sizes[SECTION_LINKS0] = links0_.size() * sizeof(uint32_t);
+    header.sizes[SECTION_UPPER_OFFSET] = upper_offset_.size() * sizeof(uint32_t);
+    header.sizes[SECTION_UPPER_LINKS] = upper_links_.size() * sizeof(uint32_t);
+    header.sizes[SECTION_DELETED] = deleted_.size();
+    header.sizes[SECTION_ID_OFFSETS] = id_offsets_bytes;
+    header.sizes[SECTION_ID_BLOB] = id_blob_.size();
+
+    uint64_t offset = align_up(sizeof(header));
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        header.offsets[s] = offset;
+        offset = align_up(offset + header.sizes[s]);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t written = sizeof(header);
+    static const char padding[SECTION_ALIGN] = {0};
+    for (int s = 0; s < SECTION_COUNT && ok; s++) {
+        ok = fwrite(padding, 1, header.offsets[s] - written, f) == header.offsets[s] - written;
+        if (ok && header.sizes[s] > 0) {
+            ok = fwrite(data[s], 1, header.sizes[s], f) == header.sizes[s];
+        }
+        written = header.offsets[s] + header.sizes[s];
+    }
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void VectorIndex::make_writable() {
+    if (map_addr_) {
+        vectors_f32_.materialize();
+        vectors_i8_.materialize();
+        scales_.materialize();
+        levels_.materialize();
+        links0_.materialize();
+        upper_offset_.materialize();
+        upper_links_.materialize();
+        deleted_.materialize();
+        id_offsets_.materialize();
+        id_blob_.materialize();
+        unmap();
+    }
+    build_id_map();
+}
+
+void VectorIndex::build_id_map() {
+    if (id_map_built_) return;
+    id_to_node_.clear();
+    for (uint32_t i = 0; i < node_count(); i++) {
+        if (!deleted_.data()[i]) {
+            id_to_node_[id_of(i)] = i;
+        }
+    }
+    id_map_built_ = true;
+}
+
+std::string VectorIndex::id_of(uint32_t node) const {
+    const uint32_t* offsets = id_offsets_.data();
+    return std::string(id_blob_.data() + offsets[node], offsets[node + 1] - offsets[node]);
+}
+
+VectorIndex::Query VectorIndex::node_query(uint32_t node) const {
+    Query q;
+    if (quantized_) {
+        q.i8 = vectors_i8_.data() + (size_t) node * dim_;
+        q.scale = scales_.data()[node];
+    } else {
+        q.f32 = vectors_f32_.data() + (size_t) node * dim_;
+    }
+    return q;
+}
+
+float VectorIndex::distance(const Query& q, uint32_t node) const {
+    if (quantized_) {
+        const int32_t dot = dot_i8(q.i8, vectors_i8_.data() + (size_t) node * dim_, dim_);
+        return -(q.scale * scales_.data()[node] * (float) dot);
+    }
+    return -dot_f32(q.f32, vectors_f32_.data() + (size_t) node * dim_, dim_);
+}
+
+float VectorIndex::node_distance(uint32_t a, uint32_t b) const {
+    return distance(node_query(a), b);
+}
+
+const uint32_t* VectorIndex::links(uint32_t node, int level) const {
+    if (level == 0) {
+        return links0_.data() + (size_t) node * (1 + M0);
+    }
+    return upper_links_.data() + upper_offset_.data()[node] + (size_t) (level - 1) * (1 + M);
+}
+
+uint32_t* VectorIndex::links(uint32_t node, int level) {
+    // Only used after make_writable(), when every column is owned
+    return const_cast<uint32_t*>(static_cast<const VectorIndex*>(this)->links(node, level));
+}
+
+int VectorIndex::random_level() {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    const double level = -std::log(1.0 - dist(rng_)) / std::log((double) M);
+    return std::min((int) level, MAX_LEVEL);
+}
+
+uint32_t VectorIndex::greedy_search(const Query& q, uint32_t entry, int from_level, int to_level) const {
+    const uint32_t n = node_count();
+    uint32_t cur = entry;
+    float cur_dist = distance(q, cur);
+    for (int level = from_level; level >= to_level; level--) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const uint32_t* nl = links(cur, level);
+            for (uint32_t i = 0; i < nl[0]; i++) {
+                const uint32_t nb = nl[1 + i];
+                if (nb >= n) continue;
+                const float d = distance(q, nb);
+                if (d < cur_dist) {
+                    cur = nb;
+                    cur_dist = d;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return cur;
+}
+
+void VectorIndex::search_layer(const Query& q, uint32_t entry, int ef, int level, std::vector<Candidate>& results) {
+    const uint32_t n = node_count();
+    if (visited_.size() < n) visited_.resize(n, 0);
+    if (++visit_epoch_ == 0) {
+        std::fill(visited_.begin(), visited_.end(), 0);
+        visit_epoch_ = 1;
+    }
+
+    // candidates_ is a min-heap on distance, results a max-heap bounded to ef entries
+    candidates_.clear();
+    results.clear();
+
+    const float d0 = distance(q, entry);
+    candidates_.emplace_back(d0, entry);
+    results.emplace_back(d0, entry);
+    visited_[entry] = visit_epoch_;
+
+    while (!candidates_.empty()) {
+        std::pop_heap(candidates_.begin(), candidates_.end(), std::greater<Candidate>());
+        const Candidate c = candidates_.back();
+        candidates_.pop_back();
+        if ((int) results.size() >= ef && c.first > results.front().first) break;
+
+        const uint32_t* nl = links(c.second, level);
+        for (uint32_t i = 0; i < nl[0]; i++) {
+            const uint32_t nb = nl[1 + i];
+            if (nb >= n || visited_[nb] == visit_epoch_) continue;
+            visited_[nb] = visit_epoch_;
+
+            const float d = distance(q, nb);
+            if ((int) results.size() < ef || d < results.front().first) {
+                candidates_.emplace_back(d, nb);
+                std::push_heap(candidates_.begin(), candidates_.end(), std::greater<Candidate>());
+                results.emplace_back(d, nb);
+                std::push_heap(results.begin(), results.end());
+                if ((int) results.size() > ef) {
+                    std::pop_heap(results.begin(), results.end());
+                    results.pop_back();
+                }
+            }
+        }
+    }
+
+    std::sort_heap(results.begin(), results.end());
+}
+
+void VectorIndex::select_neighbors(std::vector<Candidate>& candidates, int max_links) const {
+    if ((int) candidates.size() <= max_links) return;
+
+    // HNSW heuristic: keep a candidate only if it is closer to the base node than to any kept
+    // neighbour, which spreads links across clusters. Pruned candidates fill any remaining slots.
+    std::vector<Candidate> selected;
+    std::vector<Candidate> pruned;
+    for (const Candidate& c : candidates) {
+        if ((int) selected.size() >= max_links) break;
+        bool keep = true;
+        for (const Candidate& s : selected) {
+            if (node_distance(c.second, s.second) < c.first) {
+                keep = false;
+                break;
+            }
+        }
+        (keep ? selected : pruned).push_back(c);
+    }
+    for (size_t i = 0; i < pruned.size() && (int) selected.size() < max_links; i++) {
+        selected.push_back(pruned[i]);
+    }
+    candidates.swap(selected);
+}
+
+void VectorIndex::connect(uint32_t node, uint32_t neighbor, int level) {
+    const int max_links = level == 0 ? M0 : M;
+    uint32_t* nl = links(node, level);
+    if ((int) nl[0] < max_links) {
+        nl[1 + nl[0]] = neighbor;
+        nl[0]++;
+        return;
+    }
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(max_links + 1);
+    for (uint32_t i = 0; i < nl[0]; i++) {
+        candidates.emplace_back(node_distance(node, nl[1 + i]), nl[1 + i]);
+    }
+    candidates.emplace_back(node_distance(node, neighbor), neighbor);
+    std::sort(candidates.begin(), candidates.end());
+    select_neighbors(candidates, max_links);
+
+    nl[0] = candidates.size();
+    for (size_t i = 0; i < candidates.size(); i++) {
+        nl[1 + i] = candidates[i].second;
+    }
+}
+
+uint32_t VectorIndex::insert(const std::string& id, const float* vec) {
+    const uint32_t node = node_count();
+
+    std::vector<float> normalized(dim_);
+    normalize_into(vec, normalized.data(), dim_);
+    if (quantized_) {
+        vectors_i8_.owned.resize(vectors_i8_.owned.size() + dim_);
+        scales_.owned.push_back(quantize_i8(normalized.data(), vectors_i8_.owned.data() + (size_t) node * dim_, dim_));
+    } else {
+        vectors_f32_.owned.insert(vectors_f32_.owned.end(), normalized.begin(), normalized.end());
+    }
+
+    const int level = random_level();
+    levels_.owned.push_back(level);
+    links0_.owned.resize(links0_.owned.size() + 1 + M0, 0);
+    upper_offset_.owned.push_back(upper_links_.owned.size());
+    upper_links_.owned.resize(upper_links_.owned.size() + (size_t) level * (1 + M), 0);
+    deleted_.owned.push_back(0);
+    if (id_offsets_.owned.empty()) id_offsets_.owned.push_back(0);
+    id_blob_.owned.insert(id_blob_.owned.end(), id.begin(), id.end());
+    id_offsets_.owned.push_back(id_blob_.owned.size());
+
+    id_to_node_[id] = node;
+    n_live_++;
+
+    if (max_level_ < 0) {
+        entry_point_ = node;
+        max_level_ = level;
+        return node;
+    }
+
+    const Query q = node_query(node);
+    uint32_t cur = entry_point_;
+    if (max_level_ > level) {
+        cur = greedy_search(q, cur, max_level_, level + 1);
+    }
+
+    std::vector<Candidate> found;
+    for (int l = std::min(level, (int) max_level_); l >= 0; l--) {
+        search_layer(q, cur, EF_CONSTRUCTION, l, found);
+        cur = found.front().second;
+        select_neighbors(found, l == 0 ? M0 : M);
+
+        uint32_t* nl = links(node, l);
+        nl[0] = found.size();
+        for (size_t i = 0; i < found.size(); i++) {
+            nl[1 + i] = found[i].second;
+            connect(found[i].second, node, l);
+        }
+    }
+
+    if (level > max_level_) {
+        entry_point_ = node;
+        max_level_ = level;
+    }
+    return node;
+}
+
+void VectorIndex::add(const std::string& id, const float* vec) {
+    make_writable();
+    remove(id);
+    insert(id, vec);
+}
+
+bool VectorIndex::remove(const std::string& id) {
+    make_writable();
+    auto it = id_to_node_.find(id);
+    if (it == id_to_node_.end()) return false;
+
+    // Tombstone only: the node stays in the graph so its links keep routing searches
+    deleted_.owned[it->second] = 1;
+    id_to_node_.erase(it);
+    n_live_--;
+    return true;
+}
+
+void VectorIndex::compact() {
+    make_writable();
+
+    std::vector<std::pair<std::string, std::vector<float>>> live;
+    live.reserve(n_live_);
+    for (uint32_t i = 0; i < node_count(); i++) {
+        if (deleted_.owned[i]) continue;
+        std::vector<float> v(dim_);
+        if (quantized_) {
+            const int8_t* codes = vectors_i8_.owned.data() + (size_t) i * dim_;
+            for (int d = 0; d < dim_; d++) v[d] = codes[d] * scales_.owned[i];
+        } else {
+            const float* src = vectors_f32_.owned.data() + (size_t) i * dim_;
+            v.assign(src, src + dim_);
+        }
+        live.emplace_back(id_of(i), std::move(v));
+    }
+
+    vectors_f32_.owned.clear();
+    vectors_i8_.owned.clear();
+    scales_.owned.clear();
+    levels_.owned.clear();
+    links0_.owned.clear();
+    upper_offset_.owned.clear();
+    upper_links_.owned.clear();
+    deleted_.owned.clear();
+    id_offsets_.owned.clear();
+    id_blob_.owned.clear();
+    id_to_node_.clear();
+    entry_point_ = 0;
+    max_level_ = -1;
+    n_live_ = 0;
+
+    for (const auto& entry : live) {
+        insert(entry.first, entry.second.data());
+    }
+}
+
+void VectorIndex::search(const float* query, int k, std::vector<std::pair<std::string, float>>& out) {
+    out.clear();
+    if (n_live_ == 0 || k <= 0) return;
+
+    query_f32_.resize(dim_);
+    normalize_into(query, query_f32_.data(), dim_);
+
+    Query q;
+    if (quantized_) {
+        query_i8_.resize(dim_);
+        q.scale = quantize_i8(query_f32_.data(), query_i8_.data(), dim_);
+        q.i8 = query_i8_.data();
+    } else {
+        q.f32 = query_f32_.data();
+    }
+
+    uint32_t entry = entry_point_;
+    if (max_level_ > 0) {
+        entry = greedy_search(q, entry, max_level_, 1);
+    }
+
+    // Tombstoned nodes still occupy candidate slots, so widen the beam when there are any
+    int ef = std::max(ef_search_, k);
+    if (n_live_ < node_count()) ef += k;
+    search_layer(q, entry, ef, 0, results_);
+
+    const uint8_t* deleted = deleted_.data();
+    for (const Candidate& r : results_) {
+        if (deleted[r.second]) continue;
+        out.emplace_back(id_of(r.second), -r.first);
+        if ((int) out.size() >= k) break;
+    }
+}
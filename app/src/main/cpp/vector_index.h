@@ -0,0 +1,140 @@
+#pragma once
+
+// Approximate nearest-neighbour index over note embeddings.
+//
+// HNSW graph over contiguous vectors (float32 or int8 with a per-vector scale). Similarity is the
+// dot product, vectors are L2-normalized on insert so it equals cosine similarity.
+//
+// The on-disk file is laid out exactly like the in-memory columns, so open() only mmaps it and
+// points the columns into the mapping. The first mutation copies the columns into owned memory.
+// Not thread-safe: callers serialize access.
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class VectorIndex {
+public:
+    VectorIndex(int dim, bool quantized);
+    ~VectorIndex();
+
+    VectorIndex(const VectorIndex&) = delete;
+    VectorIndex& operator=(const VectorIndex&) = delete;
+
+    // Map an index file written by save(). Returns nullptr if it is missing, corrupt or does not
+    // match dim/quantized.
+    static VectorIndex* open(const std::string& path, int dim, bool quantized);
+
+    // Write the index to path (via a temp file + rename). Compacts removed vectors first.
+    bool save(const std::string& path);
+
+    // Insert or replace the vector stored under id
+    void add(const std::string& id, const float* vec);
+
+    // Remove id from results. Returns false if it was not present.
+    bool remove(const std::string& id);
+
+    // Top-k ids by similarity, best first. Reuses internal buffers, so out is the only allocation.
+    void search(const float* query, int k, std::vector<std::pair<std::string, float>>& out);
+
+    int dim() const { return dim_; }
+    bool quantized() const { return quantized_; }
+    uint32_t size() const { return n_live_; }
+
+    // Candidate list size while searching; higher is slower but more accurate
+    void set_ef_search(int ef) { ef_search_ = ef; }
+
+private:
+    static const int M = 16;            // Links per node on upper layers
+    static const int M0 = 2 * M;        // Links per node on layer 0
+    static const int EF_CONSTRUCTION = 100;
+    static const int MAX_LEVEL = 16;
+
+    // A column either owns its data or views a slice of the mapped file
+    template <typename T>
+    struct Column {
+        typedef T value_type;
+
+        std::vector<T> owned;
+        const T* mapped = nullptr;
+        size_t mapped_size = 0;
+
+        const T* data() const { return mapped ? mapped : owned.data(); }
+        size_t size() const { return mapped ? mapped_size : owned.size(); }
+        void materialize() {
+            if (mapped) {
+                owned.assign(mapped, mapped + mapped_size);
+                mapped = nullptr;
+                mapped_size = 0;
+            }
+        }
+    };
+
+    // Query prepared once per search in the same representation as stored vectors
+    struct Query {
+        const float* f32 = nullptr;
+        const int8_t* i8 = nullptr;
+        float scale = 1.0f;
+    };
+
+    typedef std::pair<float, uint32_t> Candidate; // (distance, node)
+
+    uint32_t node_count() const { return (uint32_t) levels_.size(); }
+    float distance(const Query& q, uint32_t node) const;
+    float node_distance(uint32_t a, uint32_t b) const;
+    Query node_query(uint32_t node) const;
+
+    uint32_t* links(uint32_t node, int level);
+    const uint32_t* links(uint32_t node, int level) const;
+
+    uint32_t greedy_search(const Query& q, uint32_t entry, int from_level, int to_level) const;
+    void search_layer(const Query& q, uint32_t entry, int ef, int level, std::vector<Candidate>& results);
+    void select_neighbors(std::vector<Candidate>& candidates, int max_links) const;
+    void connect(uint32_t node, uint32_t neighbor, int level);
+
+    uint32_t insert(const std::string& id, const float* vec);
+    int random_level();
+    void make_writable();
+    void build_id_map();
+    std::string id_of(uint32_t node) const;
+    void compact();
+    void unmap();
+
+    int dim_;
+    bool quantized_;
+    int ef_search_ = 64;
+
+    Column<float> vectors_f32_;     // node_count * dim (float mode)
+    Column<int8_t> vectors_i8_;     // node_count * dim (int8 mode)
+    Column<float> scales_;          // node_count (int8 mode)
+    Column<int32_t> levels_;        // node_count
+    Column<uint32_t> links0_;       // node_count * (1 + M0): count followed by links
+    Column<uint32_t> upper_offset_; // node_count: start of the node's blocks in upper_links_
+    Column<uint32_t> upper_links_;  // level blocks of (1 + M) for nodes with level > 0
+    Column<uint8_t> deleted_;       // node_count
+    Column<uint32_t> id_offsets_;   // node_count + 1
+    Column<char> id_blob_;
+
+    uint32_t entry_point_ = 0;
+    int32_t max_level_ = -1;
+    uint32_t n_live_ = 0;
+
+    std::unordered_map<std::string, uint32_t> id_to_node_;
+    bool id_map_built_ = false;
+
+    void* map_addr_ = nullptr;
+    size_t map_size_ = 0;
+
+    std::mt19937 rng_{42};
+
+    // Scratch reused across searches so lookups do not allocate
+    std::vector<uint32_t> visited_;
+    uint32_t visit_epoch_ = 0;
+    std::vector<Candidate> candidates_;
+    std::vector<Candidate> results_;
+    std::vector<int8_t> query_i8_;
+    std::vector<float> query_f32_;
+};
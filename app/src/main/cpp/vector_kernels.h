@@ -0,0 +1,171 @@
+#pragma once
+
+// SIMD similarity kernels shared by the vector index and embedding code.
+// NEON on arm64, SSE/AVX on x86_64 (emulator), scalar everywhere else.
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Dot product of two float vectors
+inline float dot_f32(const float* a, const float* b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#elif defined(__AVX__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    sum = _mm_cvtss_f32(lo);
+#elif defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+// L2-normalize v into out (may alias v). A zero vector stays zero.
+inline void normalize_f32(const float* v, float* out, int n) {
+    const float norm = std::sqrt(dot_f32(v, v, n));
+    const float scale = norm > 0.0f ? 1.0f / norm : 0.0f;
+    int i = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(v + i), scale));
+    }
+#elif defined(__AVX__)
+    const __m256 s = _mm256_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(v + i), s));
+    }
+#elif defined(__SSE2__)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(v + i), s));
+    }
+#endif
+    for (; i < n; i++) out[i] = v[i] * scale;
+}
+
+// Dot product of two int8 vectors, accumulated in int32
+inline int32_t dot_i8(const int8_t* a, const int8_t* b, int n) {
+    int i = 0;
+    int32_t sum = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__) && defined(__ARM_FEATURE_DOTPROD)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= n; i += 16) {
+        acc = vdotq_s32(acc, vld1q_s8(a + i), vld1q_s8(b + i));
+    }
+    sum = vaddvq_s32(acc);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_high_s8(va, vb));
+    }
+    sum = vaddvq_s32(acc);
+#elif defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 16 <= n; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(lo);
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+        // Sign-extend bytes to 16 bits by unpacking into the high byte and shifting back down
+        __m128i va_lo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        __m128i va_hi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        __m128i vb_lo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        __m128i vb_hi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va_lo, vb_lo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va_hi, vb_hi));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < n; i++) sum += (int32_t) a[i] * (int32_t) b[i];
+    return sum;
+}
+
+// Symmetric int8 quantization: out[i] = round(v[i] / scale). Returns the scale.
+inline float quantize_i8(const float* v, int8_t* out, int n) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float a = std::fabs(v[i]);
+        if (a > max_abs) max_abs = a;
+    }
+    const float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+    const float inv = 1.0f / scale;
+    for (int i = 0; i < n; i++) {
+        out[i] = (int8_t) std::lrintf(v[i] * inv);
+    }
+    return scale;
+}
+
+// Sign bits of v, lowest dimension in the lowest bit of the first byte. out holds (n + 7) / 8 bytes.
+inline void binarize_f32(const float* v, uint8_t* out, int n) {
+    for (int byte = 0; byte * 8 < n; byte++) {
+        uint8_t bits = 0;
+        for (int b = 0; b < 8 && byte * 8 + b < n; b++) {
+            if (v[byte * 8 + b] > 0.0f) bits |= (uint8_t) (1 << b);
+        }
+        out[byte] = bits;
+    }
+}
+
+// Differing bits between two n-byte codes
+inline int hamming_u8(const uint8_t* a, const uint8_t* b, int n) {
+    int i = 0;
+    int dist = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    // Per-lane byte counts pairwise-added into u16 lanes: no overflow below 64 KB of code
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (; i + 16 <= n; i += 16) {
+        acc = vpadalq_u8(acc, vcntq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+    }
+    dist = (int) vaddlvq_u16(acc);
+#elif defined(__x86_64__)
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        dist += __builtin_popcountll(x ^ y);
+    }
+#endif
+    for (; i < n; i++) dist += __builtin_popcount((unsigned) (a[i] ^ b[i]));
+    return dist;
+}
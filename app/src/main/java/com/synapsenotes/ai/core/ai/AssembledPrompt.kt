@@ -0,0 +1,12 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * A chat prompt built natively from a query and ranked context chunks within a token budget.
+ * [tokens] is the final prompt for the loaded model, ready for [LlmEngine.completionFlow];
+ * [includedChunks] are the indices of the chunks that fit, in rank order.
+ * Constructed from native code, keep the constructor signature in sync with native-lib.cpp.
+ */
+class AssembledPrompt(
+    val tokens: IntArray,
+    val includedChunks: IntArray
+)
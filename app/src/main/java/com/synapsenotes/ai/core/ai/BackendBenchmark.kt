@@ -0,0 +1,25 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Prefill and decode speed of the chat model on one backend, measured by a fixed microbenchmark.
+ */
+data class BackendBenchmark(
+    val prefillTokensPerSecond: Float,
+    val decodeTokensPerSecond: Float
+) {
+    companion object {
+        // Shape of a typical RAG chat turn, used to weigh prefill against decode speed
+        private const val TYPICAL_PROMPT_TOKENS = 512
+        private const val TYPICAL_GENERATED_TOKENS = 128
+    }
+
+    /**
+     * Estimated seconds for a typical chat turn; lower is better.
+     */
+    val typicalTurnSeconds: Float
+        get() = if (prefillTokensPerSecond > 0f && decodeTokensPerSecond > 0f) {
+            TYPICAL_PROMPT_TOKENS / prefillTokensPerSecond + TYPICAL_GENERATED_TOKENS / decodeTokensPerSecond
+        } else {
+            Float.MAX_VALUE
+        }
+}
@@ -4,7 +4,10 @@ import android.app.ActivityManager
 import android.content.Context
 import android.content.pm.PackageManager
 import android.os.Build
+import com.synapsenotes.ai.BuildConfig
 import dagger.hilt.android.qualifiers.ApplicationContext
+import org.json.JSONObject
+import java.io.File
 import javax.inject.Inject
 import javax.inject.Singleton
 
@@ -41,6 +44,9 @@ open class DefaultHardwareCapabilityProvider @Inject constructor(
     protected open fun getSdkInt(): Int = Build.VERSION.SDK_INT
     protected open fun getModel(): String = Build.MODEL ?: ""
     protected open fun getHardware(): String = Build.HARDWARE ?: ""
+    protected open fun currentTimeMillis(): Long = System.currentTimeMillis()
+    // Changes with system updates, which ship GPU drivers, and app updates, which ship llama.cpp
+    protected open fun getSoftwareBuild(): String = "${Build.FINGERPRINT}/${BuildConfig.VERSION_CODE}"
 
     override fun isVulkanSupported(): Boolean {
         val pm = context.packageManager
@@ -102,6 +108,16 @@ open class DefaultHardwareCapabilityProvider @Inject constructor(
         return if (totalRam > 8.5) 4096 else 2048
     }
 
+    override fun getMemoryBudgetBytes(): Long {
+        val actManager = context.getSystemService(Context.ACTIVITY_SERVICE) as ActivityManager
+        val memInfo = ActivityManager.MemoryInfo()
+        actManager.getMemoryInfo(memInfo)
+        // Stay clear of the low-memory killer: only a share of what is free above its threshold
+        // Never 0, which would turn budgeting off exactly when memory is tightest
+        val headroom = memInfo.availMem - memInfo.threshold
+        return maxOf((headroom * MEMORY_BUDGET_FRACTION).toLong(), 1L)
+    }
+
     override fun isMmapSafe(): Boolean {
         val hardware = getHardware().lowercase()
         val model = getModel().lowercase()
@@ -205,6 +221,64 @@ open class DefaultHardwareCapabilityProvider @Inject constructor(
         android.util.Log.i(TAG, "Cleared attempting backend")
     }
 
+    private fun backendProfileFile(): File = File(context.filesDir, "backend_profiles.json")
+
+    private fun readBackendProfiles(): JSONObject {
+        val file = backendProfileFile()
+        if (!file.exists()) return JSONObject()
+        return try {
+            JSONObject(file.readText())
+        } catch (e: Exception) {
+            android.util.Log.w(TAG, "Discarding unreadable backend profiles", e)
+            JSONObject()
+        }
+    }
+
+    // A recorded failure is retried after a while, or as soon as the drivers or the app changed
+    private fun isFailureCurrent(failure: JSONObject): Boolean {
+        val age = currentTimeMillis() - failure.optLong("failedAt", 0L)
+        return age in 0..BACKEND_FAILURE_RETRY_MS && failure.optString("build") == getSoftwareBuild()
+    }
+
+    @Synchronized
+    override fun getBackendProfile(profileKey: String): Map<BackendType, BackendBenchmark?> {
+        val entry = readBackendProfiles().optJSONObject(profileKey) ?: return emptyMap()
+        val profile = mutableMapOf<BackendType, BackendBenchmark?>()
+        for (name in entry.keys()) {
+            val backend = try { BackendType.valueOf(name) } catch (_: Exception) { continue }
+            // Failures without a timestamp predate expiry; leaving them out has them measured again
+            val result = entry.optJSONObject(name) ?: continue
+            if (result.has("failedAt")) {
+                if (backend != BackendType.CPU && isFailureCurrent(result)) profile[backend] = null
+            } else {
+                profile[backend] = BackendBenchmark(result.optDouble("prefill", 0.0).toFloat(), result.optDouble("decode", 0.0).toFloat())
+            }
+        }
+        return profile
+    }
+
+    @Synchronized
+    override fun recordBackendBenchmark(profileKey: String, backend: BackendType, benchmark: BackendBenchmark?) {
+        if (benchmark == null && backend == BackendType.CPU) {
+            android.util.Log.w(TAG, "Not recording a CPU failure for $profileKey, CPU stays the last resort")
+            return
+        }
+        val profiles = readBackendProfiles()
+        val entry = profiles.optJSONObject(profileKey) ?: JSONObject().also { profiles.put(profileKey, it) }
+        entry.put(backend.name, benchmark?.let {
+            JSONObject().put("prefill", it.prefillTokensPerSecond.toDouble()).put("decode", it.decodeTokensPerSecond.toDouble())
+        } ?: JSONObject().put("failedAt", currentTimeMillis()).put("build", getSoftwareBuild()))
+
+        // Write to a temp file first so a process kill mid-write never leaves a truncated profile
+        val file = backendProfileFile()
+        val tmp = File(file.path + ".tmp")
+        tmp.writeText(profiles.toString())
+        if (!tmp.renameTo(file)) {
+            tmp.delete()
+            android.util.Log.e(TAG, "Failed to save backend profile for $profileKey")
+        }
+    }
+
     /**
      * Check if this is a known problematic device for GPU backends.
      * S22/S23 with Snapdragon 8 Gen 1/2 have severe Vulkan driver bugs.
@@ -248,6 +322,10 @@ open class DefaultHardwareCapabilityProvider @Inject constructor(
 
     companion object {
         private const val TAG = "HardwareCapability"
+        // Share of free memory the chat model may plan with; the rest is left to the UI and the OS
+        private const val MEMORY_BUDGET_FRACTION = 0.7
+        // A backend that failed a model is measured again after this long
+        private const val BACKEND_FAILURE_RETRY_MS = 7L * 24 * 60 * 60 * 1000
     }
 }
 
@@ -0,0 +1,12 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Embedding of one window of a long text.
+ * [startToken] and [endToken] are the window's [start, end) token offsets into the text.
+ * Constructed from native code, keep the constructor signature in sync with native-lib.cpp.
+ */
+class EmbeddingChunk(
+    val startToken: Int,
+    val endToken: Int,
+    val vector: FloatArray
+)
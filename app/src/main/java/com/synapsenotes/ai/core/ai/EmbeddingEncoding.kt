@@ -0,0 +1,19 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Storage encoding of an embedding, in the order of the native EmbedEncoding. INT8 keeps a float
+ * scale and one byte per dimension (about 4x smaller than FLOAT32); BINARY keeps the sign of each
+ * dimension as one bit (32x smaller) and is meant as a Hamming-distance prefilter before reranking.
+ */
+enum class EmbeddingEncoding {
+    FLOAT32,
+    INT8,
+    BINARY;
+
+    /** Bytes of one encoded vector of [dimensions] components. */
+    fun bytesPerVector(dimensions: Int): Int = when (this) {
+        FLOAT32 -> dimensions * 4
+        INT8 -> 4 + dimensions
+        BINARY -> (dimensions + 7) / 8
+    }
+}
@@ -0,0 +1,10 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Output format of [LlmEngine.embedEncoded]. [dimensions] > 0 truncates the vector to its first
+ * components and renormalizes it, which suits Matryoshka-trained embedding models; 0 keeps all of them.
+ */
+data class EmbeddingFormat(
+    val dimensions: Int = 0,
+    val encoding: EmbeddingEncoding = EmbeddingEncoding.FLOAT32
+)
@@ -0,0 +1,110 @@
+package com.synapsenotes.ai.core.ai
+
+import android.content.Context
+import android.util.Log
+import com.synapsenotes.ai.domain.model.Note
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import dagger.hilt.android.qualifiers.ApplicationContext
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.flow.StateFlow
+import kotlinx.coroutines.flow.asStateFlow
+import kotlinx.coroutines.launch
+import java.io.File
+import javax.inject.Inject
+import javax.inject.Singleton
+
+/**
+ * Keeps note embeddings up to date in the background. Notes are queued on the native embedding
+ * pipeline, which batches them on a low-priority thread, skips superseded edits and pauses while a
+ * chat completion runs; finished vectors are stored on the note and in [NoteVectorIndex] here. Each
+ * job carries the note's `updatedAt`, and a vector is only stored while the note is at that version.
+ * Saving a note therefore never waits on the model. Notes are embedded chunk-wise through a native
+ * cache of chunk vectors under `embed_cache/`, so an edit only re-embeds the paragraphs it touched.
+ */
+@Singleton
+class EmbeddingIndexer @Inject constructor(
+    @ApplicationContext private val context: Context,
+    private val llmContext: LlmContext,
+    private val repository: NoteRepository,
+    private val noteVectorIndex: NoteVectorIndex
+) {
+    companion object {
+        private const val TAG = "EmbeddingIndexer"
+    }
+
+    private val scope = CoroutineScope(SupervisorJob() + Dispatchers.IO)
+    private class EmbeddedNote(val noteId: String, val updatedAt: Long, val embedding: FloatArray?)
+
+    private val results = Channel<EmbeddedNote>(Channel.UNLIMITED)
+    private var started = false
+
+    private val _progress = MutableStateFlow(IndexingProgress(0, 0))
+    val progress: StateFlow<IndexingProgress> = _progress.asStateFlow()
+
+    private val callback = object : EmbeddingPipelineCallback {
+        override fun onEmbedded(id: String, version: Long, embedding: FloatArray?) {
+            results.trySend(EmbeddedNote(id, version, embedding))
+        }
+
+        override fun onProgress(done: Int, total: Int) {
+            _progress.value = IndexingProgress(done, total)
+        }
+    }
+
+    init {
+        scope.launch {
+            for (result in results) {
+                try {
+                    store(result.noteId, result.updatedAt, result.embedding)
+                } catch (e: Exception) {
+                    Log.e(TAG, "Failed to store embedding for ${result.noteId}", e)
+                }
+            }
+        }
+    }
+
+    private suspend fun store(noteId: String, updatedAt: Long, embedding: FloatArray?) {
+        val vector = embedding?.takeIf { it.isNotEmpty() }
+        // Edited or deleted while it was queued: a newer version's result, if any, follows
+        if (!repository.updateEmbedding(noteId, updatedAt, vector)) return
+
+        if (vector != null) {
+            noteVectorIndex.upsert(noteId, vector)
+        } else {
+            noteVectorIndex.remove(noteId)
+        }
+    }
+
+    @Synchronized
+    private fun ensureStarted(): Boolean {
+        if (!started) {
+            val cacheDir = File(context.filesDir, "embed_cache").apply { mkdirs() }
+            started = llmContext.startEmbeddingPipeline(callback, cacheDir.absolutePath)
+        }
+        return started
+    }
+
+    /**
+     * Queue [note] for embedding, replacing a pending version of it. Returns false if the native
+     * pipeline is unavailable.
+     */
+    fun enqueue(note: Note): Boolean = enqueueAll(listOf(note))
+
+    fun enqueueAll(notes: List<Note>): Boolean {
+        if (!ensureStarted()) return false
+        return notes.all { llmContext.enqueueEmbedding(it.id, it.content, it.updatedAt) }
+    }
+
+    /**
+     * Drop a queued embedding, e.g. because the note was deleted or emptied.
+     */
+    fun cancel(noteId: String) {
+        if (started) {
+            llmContext.cancelEmbedding(noteId)
+        }
+    }
+}
@@ -0,0 +1,15 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Results of the native background embedding pipeline, delivered on its worker thread.
+ */
+interface EmbeddingPipelineCallback {
+    /**
+     * [embedding] is null if the text could not be embedded (e.g. no model loaded). [version] is the
+     * one the text was enqueued with.
+     */
+    fun onEmbedded(id: String, version: Long, embedding: FloatArray?)
+
+    /** Notes finished and notes queued since the queue was last empty. */
+    fun onProgress(done: Int, total: Int)
+}
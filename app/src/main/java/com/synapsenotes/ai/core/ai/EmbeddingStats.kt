@@ -0,0 +1,15 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Work done by the last embedding call, measured natively.
+ */
+data class EmbeddingStats(
+    val texts: Int,
+    val tokens: Int,
+    val decodes: Int,
+    /** Wall time of the call, including waiting for the embedding model. */
+    val totalMs: Double
+) {
+    val tokensPerSecond: Double
+        get() = if (totalMs > 0) tokens * 1000.0 / totalMs else 0.0
+}
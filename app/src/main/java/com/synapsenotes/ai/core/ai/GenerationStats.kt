@@ -0,0 +1,57 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Where the time of one generation went, measured natively. Reported for [LlmEngine.completion] /
+ * [LlmEngine.completionFlow] and for every request on the batch scheduler.
+ */
+data class GenerationStats(
+    /** Backend the chat model was loaded on ("CPU", "Vulkan", "OpenCL"). */
+    val backend: String,
+    /** Repeating layers offloaded to the GPU, -1 if the split is unknown. */
+    val gpuLayers: Int,
+    val promptTokens: Int,
+    /** Prompt tokens reused from the KV cache instead of prefilled. */
+    val cachedPromptTokens: Int,
+    val generatedTokens: Int,
+    /** Tokens evicted by context shifting: cut from an overlong prompt or shifted out while generating. */
+    val discardedTokens: Int,
+    val prefillBatches: Int,
+    /** Largest batch this request's tokens were decoded in, shared with other requests when scheduled. */
+    val maxBatchTokens: Int,
+    val draftedTokens: Int,
+    val acceptedTokens: Int,
+    /** KV cache cells in use over all sequences when the request ended. */
+    val kvCacheUsed: Int,
+    val contextSize: Int,
+    /** Waiting for the context: the chat lock or a free scheduler slot. */
+    val queueMs: Double,
+    /** Chat template and tokenization. */
+    val tokenizeMs: Double,
+    val prefillMs: Double,
+    val timeToFirstTokenMs: Double,
+    val decodeMs: Double,
+    /**
+     * Decode governor throttle level at the end of the request: 0 runs at full speed, each level drops
+     * a decode thread, halves the prefill chunk and paces steps. Always 0 for scheduled requests.
+     */
+    val throttleLevel: Int,
+    /** Governor level changes during the request. */
+    val throttleChanges: Int,
+    /** Decode threads in effect at the end, 0 on GPU backends. */
+    val decodeThreads: Int,
+    val prefillChunkTokens: Int,
+    /** Pauses inserted between decode steps to hold a steady rate. */
+    val pacingMs: Double,
+    /** SoC temperature at the end, 0 if no thermal zone is readable. */
+    val socTemperatureC: Double,
+    val cancelled: Boolean
+) {
+    val prefillTokensPerSecond: Double
+        get() = if (prefillMs > 0) (promptTokens - cachedPromptTokens) * 1000.0 / prefillMs else 0.0
+
+    val decodeTokensPerSecond: Double
+        get() = if (decodeMs > 0) generatedTokens * 1000.0 / decodeMs else 0.0
+
+    val kvCacheOccupancy: Float
+        get() = if (contextSize > 0) kvCacheUsed.toFloat() / contextSize else 0f
+}
@@ -40,6 +40,13 @@ interface HardwareCapabilityProvider {
      */
     fun getRecommendedContextSize(): Int
 
+    /**
+     * Memory the chat model may use for weights, KV cache and compute buffers, shared with the
+     * embedding model. The native loader sizes the context and KV cache type to it, using
+     * [getRecommendedContextSize] as the context to aim for. 0 disables budgeting.
+     */
+    fun getMemoryBudgetBytes(): Long
+
     /**
      * Check if memory mapping (mmap) is safe to use on this device.
      * Samsung S22/S23 (Gen 1) have kernel bugs with mmap + Vulkan.
@@ -93,4 +100,17 @@ interface HardwareCapabilityProvider {
      * Clear the attempting status (called after successful completion of risk-prone operation).
      */
     fun clearBackendAttempting()
+
+    /**
+     * Get benchmarked backends for a model on this device (see [LlmContext.getBackendProfileKey]).
+     * A null value means the backend recently failed to load or run that model; failures expire
+     * after a week or when the system or app is updated, so the backend is measured again.
+     */
+    fun getBackendProfile(profileKey: String): Map<BackendType, BackendBenchmark?>
+
+    /**
+     * Persist the benchmark of [backend] for [profileKey]; null records a failure, except for CPU,
+     * which must stay available as the last resort.
+     */
+    fun recordBackendBenchmark(profileKey: String, backend: BackendType, benchmark: BackendBenchmark?)
 }
@@ -0,0 +1,12 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Background embedding progress since the queue was last empty.
+ */
+data class IndexingProgress(
+    val done: Int,
+    val total: Int
+) {
+    val isIndexing: Boolean
+        get() = done < total
+}
@@ -0,0 +1,11 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Element type of the chat model's KV cache, in the order of the native KvCacheType. Quantized caches
+ * take roughly half (Q8_0) or a quarter (Q4_0) of the memory per context token of F16.
+ */
+enum class KvCacheType {
+    F16,
+    Q8_0,
+    Q4_0
+}
@@ -17,10 +17,47 @@ class LlamaContext {
     }
 
     external fun loadModelNative(path: String, template: String?, nBatch: Int, nCtx: Int, useMmap: Boolean, backendId: Int): Boolean
+    external fun getBackendProfileKeyNative(path: String): String
+    external fun benchmarkBackendNative(): FloatArray
+    external fun getOffloadPlanNative(): LongArray
     external fun loadEmbeddingModelNative(path: String): Boolean
+    external fun startModelLoadNative(path: String, template: String?, nBatch: Int, nCtx: Int, useMmap: Boolean, backendId: Int, callback: ModelLoadCallback): Long
+    external fun startEmbeddingModelLoadNative(path: String, useMmap: Boolean, callback: ModelLoadCallback): Long
+    external fun cancelModelLoadNative(handle: Long): Boolean
+    external fun loadDraftModelNative(path: String, nDraft: Int): Boolean
+    external fun unloadDraftModelNative()
+    external fun loadLoraAdapterNative(path: String): Boolean
+    external fun setLoraAdaptersNative(paths: Array<String>, scales: FloatArray): Boolean
+    external fun unloadLoraAdapterNative(path: String): Boolean
+    external fun inspectModelNative(path: String, nCtx: Int): ModelInfo?
+    external fun getSpeculativeStats(): IntArray
+    external fun setPromptLookupNative(ngramMax: Int, nDraft: Int)
+    external fun setContextShiftNative(enabled: Boolean)
+    external fun setDecodeGovernorNative(enabled: Boolean)
+    external fun setMemoryBudgetNative(budgetBytes: Long)
+    external fun getMemoryPlanNative(): LongArray
+    external fun getLastGenerationStatsNative(): GenerationStats?
+    external fun getLastEmbeddingStatsNative(): EmbeddingStats?
+    external fun startTraceNative(path: String): Boolean
+    external fun stopTraceNative(): Boolean
     external fun completion(prompt: String, callback: LlmCallback): String
+    external fun assemblePromptNative(query: String, chunks: Array<String>, budgetTokens: Int): AssembledPrompt?
+    external fun completionTokens(tokens: IntArray, callback: LlmCallback): String
+    external fun submitNative(prompt: String, maxTokens: Int, callback: LlmRequestCallback): Long
+    external fun cancelNative(handle: Long): Boolean
+    external fun saveSessionNative(dir: String, sessionId: String): Boolean
+    external fun restoreSessionNative(dir: String, sessionId: String): Boolean
     external fun stopCompletion()
     external fun embed(text: String): FloatArray
+    external fun embedBatch(texts: Array<String>): FloatArray
+    external fun embedEncoded(text: String, dims: Int, encoding: Int): ByteArray
+    external fun embedBatchEncoded(texts: Array<String>, dims: Int, encoding: Int): ByteArray
+    external fun scoreEncoded(query: ByteArray, rows: ByteArray, dims: Int, encoding: Int): FloatArray
+    external fun embedChunks(text: String, windowTokens: Int, overlapTokens: Int): Array<EmbeddingChunk>
+    external fun embedPooled(text: String, windowTokens: Int, overlapTokens: Int, weighted: Boolean): FloatArray
+    external fun startEmbeddingPipelineNative(callback: EmbeddingPipelineCallback, cacheDir: String): Boolean
+    external fun enqueueEmbeddingNative(id: String, text: String, version: Long): Boolean
+    external fun cancelEmbeddingNative(id: String): Boolean
     external fun unload()
     external fun isGpuEnabled(): Boolean
     external fun isOpenCLAvailable(): Boolean
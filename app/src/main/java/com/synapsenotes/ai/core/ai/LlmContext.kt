@@ -8,10 +8,47 @@ import javax.inject.Inject
  */
 interface LlmContext {
     fun loadModel(path: String, template: String? = null, nBatch: Int = 512, nCtx: Int = 2048, useMmap: Boolean = true, backendType: BackendType): Boolean
+    fun getBackendProfileKey(modelPath: String): String
+    fun benchmarkBackend(): BackendBenchmark?
+    fun getOffloadPlan(): OffloadPlan?
+    fun setMemoryBudget(budgetBytes: Long)
+    fun getMemoryPlan(): MemoryPlan?
     fun loadEmbeddingModel(path: String): Boolean
+    fun startModelLoad(path: String, template: String?, nBatch: Int, nCtx: Int, useMmap: Boolean, backendType: BackendType, callback: ModelLoadCallback): Long
+    fun startEmbeddingModelLoad(path: String, useMmap: Boolean, callback: ModelLoadCallback): Long
+    fun cancelModelLoad(handle: Long): Boolean
+    fun loadDraftModel(path: String, nDraft: Int = 8): Boolean
+    fun unloadDraftModel()
+    fun loadLoraAdapter(path: String): Boolean
+    fun setLoraAdapters(paths: Array<String>, scales: FloatArray): Boolean
+    fun unloadLoraAdapter(path: String): Boolean
+    fun inspectModel(path: String, contextSize: Int = 0): ModelInfo?
+    fun getSpeculativeStats(): SpeculativeStats
+    fun setPromptLookup(ngramMax: Int, nDraft: Int)
+    fun setContextShift(enabled: Boolean)
+    fun setDecodeGovernor(enabled: Boolean)
+    fun getLastGenerationStats(): GenerationStats?
+    fun getLastEmbeddingStats(): EmbeddingStats?
+    fun startTrace(path: String): Boolean
+    fun stopTrace(): Boolean
     fun completion(prompt: String, callback: LlmCallback? = null): String
+    fun assemblePrompt(query: String, chunks: Array<String>, budgetTokens: Int = 0): AssembledPrompt?
+    fun completionTokens(tokens: IntArray, callback: LlmCallback? = null): String
+    fun submit(prompt: String, maxTokens: Int, callback: LlmRequestCallback): Long
+    fun cancel(handle: Long): Boolean
+    fun saveSession(dir: String, sessionId: String): Boolean
+    fun restoreSession(dir: String, sessionId: String): Boolean
     fun stopCompletion()
     fun embed(text: String): FloatArray
+    fun embedBatch(texts: Array<String>): FloatArray
+    fun embedEncoded(text: String, dims: Int, encoding: EmbeddingEncoding): ByteArray
+    fun embedBatchEncoded(texts: Array<String>, dims: Int, encoding: EmbeddingEncoding): ByteArray
+    fun scoreEncoded(query: ByteArray, rows: ByteArray, dims: Int, encoding: EmbeddingEncoding): FloatArray
+    fun embedChunks(text: String, windowTokens: Int = 0, overlapTokens: Int = 64): Array<EmbeddingChunk>
+    fun embedPooled(text: String, windowTokens: Int = 0, overlapTokens: Int = 64, weighted: Boolean = true): FloatArray
+    fun startEmbeddingPipeline(callback: EmbeddingPipelineCallback, cacheDir: String): Boolean
+    fun enqueueEmbedding(id: String, text: String, version: Long): Boolean
+    fun cancelEmbedding(id: String): Boolean
     fun unload()
     fun isGpuEnabled(): Boolean
     fun isOpenCLAvailable(): Boolean
@@ -32,16 +69,185 @@ class DefaultLlmContext @Inject constructor() : LlmContext {
         return nativeContext.loadModelNative(path, template, nBatch, nCtx, useMmap, backendType.ordinal)
     }
 
+    override fun getBackendProfileKey(modelPath: String): String {
+        if (!isLibraryLoaded()) return ""
+        return nativeContext.getBackendProfileKeyNative(modelPath)
+    }
+
+    override fun benchmarkBackend(): BackendBenchmark? {
+        if (!isLibraryLoaded()) return null
+        val result = nativeContext.benchmarkBackendNative()
+        if (result.size < 2) return null
+        return BackendBenchmark(prefillTokensPerSecond = result[0], decodeTokensPerSecond = result[1])
+    }
+
+    override fun getOffloadPlan(): OffloadPlan? {
+        if (!isLibraryLoaded()) return null
+        val plan = nativeContext.getOffloadPlanNative()
+        if (plan.size < 7) return null
+        return OffloadPlan(
+            gpuLayers = plan[0].toInt(),
+            totalLayers = plan[1].toInt(),
+            cpuFfnLayers = plan[2].toInt(),
+            gpuBytes = plan[3],
+            cpuBytes = plan[4],
+            kvCacheBytes = plan[5],
+            budgetBytes = plan[6]
+        )
+    }
+
+    override fun setMemoryBudget(budgetBytes: Long) {
+        if (isLibraryLoaded()) {
+            nativeContext.setMemoryBudgetNative(budgetBytes)
+        }
+    }
+
+    override fun getMemoryPlan(): MemoryPlan? {
+        if (!isLibraryLoaded()) return null
+        val plan = nativeContext.getMemoryPlanNative()
+        if (plan.size < 8) return null
+        return MemoryPlan(
+            contextSize = plan[0].toInt(),
+            kvCacheType = KvCacheType.values().getOrElse(plan[1].toInt()) { KvCacheType.F16 },
+            flashAttention = plan[2] != 0L,
+            fitsBudget = plan[3] != 0L,
+            kvCacheBytes = plan[4],
+            weightBytes = plan[5],
+            reservedBytes = plan[6],
+            budgetBytes = plan[7]
+        )
+    }
+
     override fun loadEmbeddingModel(path: String): Boolean {
         if (!isLibraryLoaded()) return false
         return nativeContext.loadEmbeddingModelNative(path)
     }
 
+    override fun startModelLoad(path: String, template: String?, nBatch: Int, nCtx: Int, useMmap: Boolean, backendType: BackendType, callback: ModelLoadCallback): Long {
+        if (!isLibraryLoaded()) return 0L
+        return nativeContext.startModelLoadNative(path, template, nBatch, nCtx, useMmap, backendType.ordinal, callback)
+    }
+
+    override fun startEmbeddingModelLoad(path: String, useMmap: Boolean, callback: ModelLoadCallback): Long {
+        if (!isLibraryLoaded()) return 0L
+        return nativeContext.startEmbeddingModelLoadNative(path, useMmap, callback)
+    }
+
+    override fun cancelModelLoad(handle: Long): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.cancelModelLoadNative(handle)
+    }
+
+    override fun loadDraftModel(path: String, nDraft: Int): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.loadDraftModelNative(path, nDraft)
+    }
+
+    override fun unloadDraftModel() {
+        if (isLibraryLoaded()) {
+            nativeContext.unloadDraftModelNative()
+        }
+    }
+
+    override fun loadLoraAdapter(path: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.loadLoraAdapterNative(path)
+    }
+
+    override fun setLoraAdapters(paths: Array<String>, scales: FloatArray): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.setLoraAdaptersNative(paths, scales)
+    }
+
+    override fun unloadLoraAdapter(path: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.unloadLoraAdapterNative(path)
+    }
+
+    override fun inspectModel(path: String, contextSize: Int): ModelInfo? {
+        if (!isLibraryLoaded()) return null
+        return nativeContext.inspectModelNative(path, contextSize)
+    }
+
+    override fun getSpeculativeStats(): SpeculativeStats {
+        if (!isLibraryLoaded()) return SpeculativeStats(0, 0)
+        val stats = nativeContext.getSpeculativeStats()
+        return SpeculativeStats(draftedTokens = stats[0], acceptedTokens = stats[1])
+    }
+
+    override fun setPromptLookup(ngramMax: Int, nDraft: Int) {
+        if (isLibraryLoaded()) {
+            nativeContext.setPromptLookupNative(ngramMax, nDraft)
+        }
+    }
+
+    override fun setContextShift(enabled: Boolean) {
+        if (isLibraryLoaded()) {
+            nativeContext.setContextShiftNative(enabled)
+        }
+    }
+
+    override fun setDecodeGovernor(enabled: Boolean) {
+        if (isLibraryLoaded()) {
+            nativeContext.setDecodeGovernorNative(enabled)
+        }
+    }
+
+    override fun getLastGenerationStats(): GenerationStats? {
+        if (!isLibraryLoaded()) return null
+        return nativeContext.getLastGenerationStatsNative()
+    }
+
+    override fun getLastEmbeddingStats(): EmbeddingStats? {
+        if (!isLibraryLoaded()) return null
+        return nativeContext.getLastEmbeddingStatsNative()
+    }
+
+    override fun startTrace(path: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.startTraceNative(path)
+    }
+
+    override fun stopTrace(): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.stopTraceNative()
+    }
+
     override fun completion(prompt: String, callback: LlmCallback?): String {
         if (!isLibraryLoaded()) return "Error: Native library not loaded"
         return nativeContext.completion(prompt, callback ?: object : LlmCallback { override fun onToken(token: String) {} })
     }
 
+    override fun assemblePrompt(query: String, chunks: Array<String>, budgetTokens: Int): AssembledPrompt? {
+        if (!isLibraryLoaded()) return null
+        return nativeContext.assemblePromptNative(query, chunks, budgetTokens)
+    }
+
+    override fun completionTokens(tokens: IntArray, callback: LlmCallback?): String {
+        if (!isLibraryLoaded()) return "Error: Native library not loaded"
+        return nativeContext.completionTokens(tokens, callback ?: object : LlmCallback { override fun onToken(token: String) {} })
+    }
+
+    override fun submit(prompt: String, maxTokens: Int, callback: LlmRequestCallback): Long {
+        if (!isLibraryLoaded()) return 0L
+        return nativeContext.submitNative(prompt, maxTokens, callback)
+    }
+
+    override fun cancel(handle: Long): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.cancelNative(handle)
+    }
+
+    override fun saveSession(dir: String, sessionId: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.saveSessionNative(dir, sessionId)
+    }
+
+    override fun restoreSession(dir: String, sessionId: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.restoreSessionNative(dir, sessionId)
+    }
+
     override fun stopCompletion() {
         if (isLibraryLoaded()) {
             nativeContext.stopCompletion()
@@ -53,6 +259,51 @@ class DefaultLlmContext @Inject constructor() : LlmContext {
         return nativeContext.embed(text)
     }
 
+    override fun embedBatch(texts: Array<String>): FloatArray {
+        if (!isLibraryLoaded()) return floatArrayOf()
+        return nativeContext.embedBatch(texts)
+    }
+
+    override fun embedEncoded(text: String, dims: Int, encoding: EmbeddingEncoding): ByteArray {
+        if (!isLibraryLoaded()) return byteArrayOf()
+        return nativeContext.embedEncoded(text, dims, encoding.ordinal)
+    }
+
+    override fun embedBatchEncoded(texts: Array<String>, dims: Int, encoding: EmbeddingEncoding): ByteArray {
+        if (!isLibraryLoaded()) return byteArrayOf()
+        return nativeContext.embedBatchEncoded(texts, dims, encoding.ordinal)
+    }
+
+    override fun scoreEncoded(query: ByteArray, rows: ByteArray, dims: Int, encoding: EmbeddingEncoding): FloatArray {
+        if (!isLibraryLoaded()) return floatArrayOf()
+        return nativeContext.scoreEncoded(query, rows, dims, encoding.ordinal)
+    }
+
+    override fun embedChunks(text: String, windowTokens: Int, overlapTokens: Int): Array<EmbeddingChunk> {
+        if (!isLibraryLoaded()) return emptyArray()
+        return nativeContext.embedChunks(text, windowTokens, overlapTokens)
+    }
+
+    override fun embedPooled(text: String, windowTokens: Int, overlapTokens: Int, weighted: Boolean): FloatArray {
+        if (!isLibraryLoaded()) return floatArrayOf()
+        return nativeContext.embedPooled(text, windowTokens, overlapTokens, weighted)
+    }
+
+    override fun startEmbeddingPipeline(callback: EmbeddingPipelineCallback, cacheDir: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.startEmbeddingPipelineNative(callback, cacheDir)
+    }
+
+    override fun enqueueEmbedding(id: String, text: String, version: Long): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.enqueueEmbeddingNative(id, text, version)
+    }
+
+    override fun cancelEmbedding(id: String): Boolean {
+        if (!isLibraryLoaded()) return false
+        return nativeContext.cancelEmbeddingNative(id)
+    }
+
     override fun unload() {
         if (isLibraryLoaded()) {
             nativeContext.unload()
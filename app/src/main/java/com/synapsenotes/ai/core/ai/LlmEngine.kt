@@ -1,16 +1,28 @@
 package com.synapsenotes.ai.core.ai
 
 import android.util.Log
+import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.ensureActive
+import kotlinx.coroutines.suspendCancellableCoroutine
 import kotlinx.coroutines.withContext
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
 import javax.inject.Inject
 import javax.inject.Singleton
 import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.MutableSharedFlow
+import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.flow.SharedFlow
+import kotlinx.coroutines.flow.StateFlow
+import kotlinx.coroutines.flow.asSharedFlow
+import kotlinx.coroutines.flow.asStateFlow
 import kotlinx.coroutines.flow.callbackFlow
+import kotlinx.coroutines.flow.toList
 import kotlinx.coroutines.channels.awaitClose
 import kotlinx.coroutines.launch
+import kotlin.coroutines.resume
+import kotlin.coroutines.resumeWithException
 
 @Singleton
 class LlmEngine @Inject constructor(
@@ -22,9 +34,22 @@ class LlmEngine @Inject constructor(
         private const val TAG = "LlmEngine"
     }
 
-    private var isLoaded = false
+    @Volatile private var isLoaded = false
     private val mutex = Mutex()
 
+    @Volatile private var loadHandle = 0L
+    private val _loadProgress = MutableStateFlow<ModelLoadProgress?>(null)
+    /** Progress of the model load in progress, null when none is running. */
+    val loadProgress: StateFlow<ModelLoadProgress?> = _loadProgress.asStateFlow()
+
+    private val _generationStats = MutableSharedFlow<GenerationStats>(extraBufferCapacity = 16)
+    /** Native timings of every finished generation, chat and scheduled. Dropped when nobody keeps up. */
+    val generationStats: SharedFlow<GenerationStats> = _generationStats.asSharedFlow()
+
+    private val _embeddingStats = MutableSharedFlow<EmbeddingStats>(extraBufferCapacity = 16)
+    /** Native timings of every embedding call made through this engine. */
+    val embeddingStats: SharedFlow<EmbeddingStats> = _embeddingStats.asSharedFlow()
+
     /**
      * Get information about the hardware acceleration status.
      */
@@ -42,6 +67,71 @@ class LlmEngine @Inject constructor(
 
     fun isGpuEnabled(): Boolean = llmContext.isGpuEnabled()
 
+    /**
+     * Start recording native trace events (tokenize, template, prefill chunks, sampling, decodes)
+     * until [stopTrace] writes them to [path] as Chrome trace-event JSON, viewable in ui.perfetto.dev.
+     * Returns false if a recording is already running.
+     */
+    fun startTrace(path: String): Boolean = llmContext.startTrace(path)
+
+    /**
+     * Stop the trace recording and write it out. Returns false if none was running or the write failed.
+     */
+    fun stopTrace(): Boolean = llmContext.stopTrace()
+
+    private fun publishGenerationStats() {
+        llmContext.getLastGenerationStats()?.let { _generationStats.tryEmit(it) }
+    }
+
+    private fun publishEmbeddingStats() {
+        llmContext.getLastEmbeddingStats()?.let { _embeddingStats.tryEmit(it) }
+    }
+
+    /**
+     * Abort the model load in progress, if any. The pending [loadModel] or [loadEmbeddingModel]
+     * call returns a failure with a [CancellationException].
+     */
+    fun cancelLoad() {
+        val handle = loadHandle
+        if (handle != 0L) llmContext.cancelModelLoad(handle)
+    }
+
+    /**
+     * Run a native load started by [start] off the calling thread and publish its progress.
+     * Cancelling the caller aborts the load at the next tensor; a load aborted through
+     * [cancelLoad] throws [CancellationException].
+     */
+    private suspend fun awaitModelLoad(path: String, start: (ModelLoadCallback) -> Long): Boolean =
+        suspendCancellableCoroutine { continuation ->
+            val callback = object : ModelLoadCallback {
+                override fun onProgress(loadedBytes: Long, totalBytes: Long) {
+                    _loadProgress.value = ModelLoadProgress(path, loadedBytes, totalBytes)
+                }
+
+                override fun onComplete(success: Boolean, cancelled: Boolean) {
+                    loadHandle = 0L
+                    _loadProgress.value = null
+                    if (cancelled) {
+                        continuation.resumeWithException(CancellationException("Model load cancelled"))
+                    } else {
+                        continuation.resume(success)
+                    }
+                }
+            }
+            val handle = start(callback)
+            if (handle == 0L) {
+                continuation.resume(false)
+            } else {
+                loadHandle = handle
+                continuation.invokeOnCancellation { llmContext.cancelModelLoad(handle) }
+            }
+        }
+
+    /**
+     * Load the chat model on the fastest backend this device has measured for it. The first load of a
+     * model on a given SoC/driver benchmarks every usable backend once and persists the results, so
+     * later loads go straight to the winner instead of trying backends in a fixed order.
+     */
     suspend fun loadModel(path: String, template: String? = null): Result<Boolean> = withContext(Dispatchers.IO) {
         mutex.withLock {
             if (isLoaded) {
@@ -56,11 +146,13 @@ class LlmEngine @Inject constructor(
             val nBatch = hardwareCapabilityProvider.getRecommendedBatchSize()
             val nCtx = hardwareCapabilityProvider.getRecommendedContextSize()
             val useMmap = hardwareCapabilityProvider.isMmapSafe()
+            // With a budget, nCtx is the context the native side tries to reach before trading KV
+            // precision for length; the context it settles on is reported by getMemoryPlan()
+            llmContext.setMemoryBudget(hardwareCapabilityProvider.getMemoryBudgetBytes())
 
-            // Try each available backend in order
-            for (backend in availableBackends) {
+            suspend fun tryLoad(backend: BackendType): Boolean {
                 Log.i(TAG, "Attempting to load model with backend: ${backend.name}")
-                
+
                 // Mark this backend as being attempted BEFORE the native call.
                 // If it crashes consistently, it will be added to the failed list on next startup.
                 // We only do this for GPU backends which are prone to driver crashes.
@@ -69,18 +161,16 @@ class LlmEngine @Inject constructor(
                 }
 
                 try {
-                    val success = llmContext.loadModel(path, template, nBatch, nCtx, useMmap, backend)
-                    
+                    val success = awaitModelLoad(path) { callback ->
+                        llmContext.startModelLoad(path, template, nBatch, nCtx, useMmap, backend, callback)
+                    }
+
                     if (success) {
                         // Success! Clear the attempting flag.
                         if (backend != BackendType.CPU) {
                             hardwareCapabilityProvider.clearBackendAttempting()
                         }
-                        
-                        isLoaded = true
-                        val hwInfo = getHardwareInfo()
-                        Log.i(TAG, "Model loaded successfully. Active Backend: ${hwInfo.backendName}. Batch: $nBatch, Ctx: $nCtx, Mmap: $useMmap")
-                        return@withContext Result.success(true)
+                        return true
                     } else {
                         Log.w(TAG, "Backend $backend failed to load model (returned false), marking as failed")
                         if (backend != BackendType.CPU) {
@@ -88,6 +178,12 @@ class LlmEngine @Inject constructor(
                             hardwareCapabilityProvider.clearBackendAttempting() // Failed gracefully, so clear attempting
                         }
                     }
+                } catch (e: CancellationException) {
+                    // Not the backend's fault
+                    if (backend != BackendType.CPU) {
+                        hardwareCapabilityProvider.clearBackendAttempting()
+                    }
+                    throw e
                 } catch (e: Exception) {
                     Log.e(TAG, "Exception loading model with backend $backend", e)
                     if (backend != BackendType.CPU) {
@@ -95,17 +191,76 @@ class LlmEngine @Inject constructor(
                         hardwareCapabilityProvider.clearBackendAttempting() // Failed gracefully, so clear attempting
                     }
                 }
+                return false
             }
 
-            // If we get here, all backends failed
-            Log.e(TAG, "Failed to load model with all available backends")
-            Result.failure(Exception("Failed to load model with all available backends"))
+            try {
+                // Benchmark backends this model has not been measured on yet. The last one that loaded
+                // stays loaded so it does not have to be loaded again if it turns out fastest.
+                val profileKey = llmContext.getBackendProfileKey(path)
+                val profile = hardwareCapabilityProvider.getBackendProfile(profileKey).toMutableMap()
+                var loadedBackend: BackendType? = null
+                for (backend in availableBackends.filter { it !in profile }) {
+                    Log.i(TAG, "Benchmarking backend $backend for $profileKey")
+                    loadedBackend = null
+                    val benchmark = if (tryLoad(backend)) llmContext.benchmarkBackend() else null
+                    if (benchmark != null) loadedBackend = backend
+                    // A load cut short by cancellation says nothing about the backend
+                    ensureActive()
+                    hardwareCapabilityProvider.recordBackendBenchmark(profileKey, backend, benchmark)
+                    profile[backend] = benchmark
+                }
+
+                // CPU stays the last resort even when it could not be measured
+                val measured = availableBackends
+                    .filter { profile[it] != null }
+                    .sortedBy { profile[it]!!.typicalTurnSeconds }
+                val ranked = if (BackendType.CPU in availableBackends && BackendType.CPU !in measured) {
+                    measured + BackendType.CPU
+                } else {
+                    measured
+                }
+                Log.i(TAG, "Backend ranking: ${ranked.map { "$it=${profile[it]}" }}")
+
+                for (backend in ranked) {
+                    if (backend == loadedBackend || tryLoad(backend)) {
+                        hardwareCapabilityProvider.setPreferredBackend(backend)
+                        isLoaded = true
+                        val hwInfo = getHardwareInfo()
+                        Log.i(TAG, "Model loaded successfully. Active Backend: ${hwInfo.backendName}. Batch: $nBatch, Ctx: $nCtx, Mmap: $useMmap")
+                        llmContext.getOffloadPlan()?.let { Log.i(TAG, "Memory split: $it") }
+                        llmContext.getMemoryPlan()?.let { Log.i(TAG, "Context: $it") }
+                        return@withContext Result.success(true)
+                    }
+                    // Measured once but no longer loads (e.g. after a driver update broke it)
+                    ensureActive()
+                    hardwareCapabilityProvider.recordBackendBenchmark(profileKey, backend, null)
+                }
+
+                // If we get here, all backends failed
+                Log.e(TAG, "Failed to load model with all available backends")
+                Result.failure(Exception("Failed to load model with all available backends"))
+            } catch (e: CancellationException) {
+                ensureActive() // Propagate if the caller was cancelled, report if cancelLoad() was
+                Log.i(TAG, "Model load cancelled")
+                Result.failure(e)
+            }
         }
     }
 
+    /**
+     * Load the embedding model. It is memory-mapped where mmap is safe, so its pages stay reclaimable
+     * page cache instead of a private copy of the file.
+     */
     suspend fun loadEmbeddingModel(path: String): Result<Boolean> = withContext(Dispatchers.IO) {
         mutex.withLock {
-            val success = llmContext.loadEmbeddingModel(path)
+            val useMmap = hardwareCapabilityProvider.isMmapSafe()
+            val success = try {
+                awaitModelLoad(path) { callback -> llmContext.startEmbeddingModelLoad(path, useMmap, callback) }
+            } catch (e: CancellationException) {
+                ensureActive()
+                return@withLock Result.failure(e)
+            }
             if (success) {
                 Log.i(TAG, "Embedding model loaded successfully")
                 Result.success(true)
@@ -115,7 +270,160 @@ class LlmEngine @Inject constructor(
         }
     }
 
-    fun completionFlow(prompt: String): Flow<String> = callbackFlow {
+    /**
+     * Load a small draft model that proposes tokens for the chat model to verify in one decode.
+     * It must share the chat model's vocabulary and is dropped whenever the chat model is reloaded.
+     */
+    suspend fun loadDraftModel(path: String, nDraft: Int = 8): Result<Boolean> = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock Result.failure(IllegalStateException("Model not loaded"))
+            if (llmContext.loadDraftModel(path, nDraft)) {
+                Log.i(TAG, "Draft model loaded, speculating up to $nDraft tokens")
+                Result.success(true)
+            } else {
+                Result.failure(Exception("Failed to load draft model at $path"))
+            }
+        }
+    }
+
+    suspend fun unloadDraftModel() = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            llmContext.unloadDraftModel()
+        }
+    }
+
+    /**
+     * Read the metadata, tensor types and memory needs of the GGUF model at [path] without loading it,
+     * estimating the KV cache for [contextSize] tokens (0: the training context length). Also checks
+     * the file's structure, so a truncated download shows up as an invalid [ModelInfo]. Needs no
+     * loaded model; null if the native library is unavailable.
+     */
+    suspend fun inspectModel(path: String, contextSize: Int = 0): ModelInfo? = withContext(Dispatchers.IO) {
+        llmContext.inspectModel(path, contextSize)
+    }
+
+    /**
+     * Load a LoRA adapter (GGUF) against the resident chat model, e.g. one per task such as
+     * summarizing or tagging. Loading the same path again is a no-op. Adapters stay loaded until
+     * unloaded or the chat model is reloaded, and only take effect once activated with [setLoraAdapters].
+     */
+    suspend fun loadLoraAdapter(path: String): Result<Boolean> = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock Result.failure(IllegalStateException("Model not loaded"))
+            if (llmContext.loadLoraAdapter(path)) {
+                Result.success(true)
+            } else {
+                Result.failure(Exception("Failed to load LoRA adapter at $path"))
+            }
+        }
+    }
+
+    /**
+     * Make [scales] (adapter path to scale, all loaded) the active adapters for following requests;
+     * an empty map returns to the base model. Switching takes milliseconds but drops the KV cache,
+     * so the next prompt is prefilled in full. Setting the active set again is free.
+     */
+    suspend fun setLoraAdapters(scales: Map<String, Float>): Boolean = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock false
+            llmContext.setLoraAdapters(scales.keys.toTypedArray(), scales.values.toFloatArray())
+        }
+    }
+
+    suspend fun unloadLoraAdapter(path: String): Boolean = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            llmContext.unloadLoraAdapter(path)
+        }
+    }
+
+    /**
+     * GPU/CPU split chosen for the loaded chat model, or null when no model is loaded.
+     */
+    suspend fun getOffloadPlan(): OffloadPlan? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (isLoaded) llmContext.getOffloadPlan() else null
+        }
+    }
+
+    /**
+     * Context size and KV cache type chosen for the loaded chat model, or null when no model is loaded.
+     */
+    suspend fun getMemoryPlan(): MemoryPlan? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (isLoaded) llmContext.getMemoryPlan() else null
+        }
+    }
+
+    /**
+     * Draft acceptance of the most recent completion; zero when no draft model is loaded.
+     */
+    suspend fun getSpeculativeStats(): SpeculativeStats = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            llmContext.getSpeculativeStats()
+        }
+    }
+
+    /**
+     * Enable draft-free speculation for following completions: the recent output n-gram (up to
+     * [ngramMax] tokens) is matched against the prompt and the tokens that followed it are verified
+     * as drafts. Pays off when answers quote the prompt, as RAG answers do. A loaded draft model
+     * takes precedence.
+     */
+    suspend fun setPromptLookup(enabled: Boolean, ngramMax: Int = 4, nDraft: Int = 10) = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (enabled) llmContext.setPromptLookup(ngramMax, nDraft) else llmContext.setPromptLookup(0, 0)
+        }
+    }
+
+    /**
+     * Context shifting (on by default): when a completion fills the context window, the oldest tokens
+     * after the pinned system prompt are evicted from the KV cache and generation continues without a
+     * re-prefill, and prompts longer than the window lose their oldest part instead of failing. Lets
+     * small context sizes answer long RAG prompts and long chats without cut-off answers. Disabled,
+     * generation stops at the end of the window.
+     */
+    suspend fun setContextShift(enabled: Boolean) = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            llmContext.setContextShift(enabled)
+        }
+    }
+
+    /**
+     * Decode governor (on by default): watches decode step latency and the SoC temperature during
+     * chat completions and, as the device throttles, steps down the decode threads and prefill chunk
+     * size and paces token steps to hold a steady rate instead of bursting and crawling. Its decisions
+     * are reported in [GenerationStats]. Disabled, completions always run at full thread count.
+     */
+    suspend fun setDecodeGovernor(enabled: Boolean) = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            llmContext.setDecodeGovernor(enabled)
+        }
+    }
+
+    fun completionFlow(prompt: String): Flow<String> =
+        chatCompletionFlow { callback -> llmContext.completion(prompt, callback) }
+
+    /**
+     * Build a RAG prompt natively: [chunks] (ranked, best first) are packed in order into
+     * [budgetTokens] (0 = as much of the context window as a prompt may take) around [query], and
+     * the chat template is applied, all on token runs with per-chunk tokenizations cached across
+     * questions. Returns null when the loaded template cannot be assembled this way; fall back to
+     * [completionFlow] with a text prompt then.
+     */
+    suspend fun assemblePrompt(query: String, chunks: List<String>, budgetTokens: Int = 0): AssembledPrompt? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock null
+            llmContext.assemblePrompt(query, chunks.toTypedArray(), budgetTokens)
+        }
+    }
+
+    /**
+     * Stream the reply to a prompt from [assemblePrompt], which is already templated and tokenized.
+     */
+    fun completionFlow(prompt: AssembledPrompt): Flow<String> =
+        chatCompletionFlow { callback -> llmContext.completionTokens(prompt.tokens, callback) }
+
+    private fun chatCompletionFlow(run: (LlmCallback) -> String): Flow<String> = callbackFlow {
         // Launch a coroutine to run the blocking native call
         launch(Dispatchers.IO) {
             mutex.withLock {
@@ -131,7 +439,8 @@ class LlmEngine @Inject constructor(
                         }
                     }
                     // This call blocks until completion finishes
-                    llmContext.completion(prompt, callback)
+                    run(callback)
+                    publishGenerationStats()
                     close()
                 } catch (e: Exception) {
                     close(e)
@@ -144,6 +453,51 @@ class LlmEngine @Inject constructor(
         }
     }
     
+    /**
+     * Generate on the native batch scheduler. Unlike [completionFlow] this does not hold the engine
+     * lock: requests get their own sequence and are decoded together with the chat and with each
+     * other, so background jobs and chat do not wait on one another. Cancelling the flow cancels
+     * the request. A request waits until its prompt plus [maxTokens] fit in the KV cells the chat
+     * leaves free; the flow fails if the request cannot be completed.
+     */
+    fun generateFlow(prompt: String, maxTokens: Int = 512): Flow<String> = callbackFlow {
+        if (!isLoaded) {
+            close(IllegalStateException("Model not loaded"))
+            return@callbackFlow
+        }
+
+        val callback = object : LlmRequestCallback {
+            @Volatile
+            private var failure: Throwable? = null
+
+            override fun onToken(token: String) {
+                trySend(token)
+            }
+
+            override fun onError(message: String) {
+                failure = IllegalStateException(message)
+            }
+
+            override fun onComplete(result: String, cancelled: Boolean) {
+                close(failure)
+            }
+
+            override fun onStats(stats: GenerationStats) {
+                _generationStats.tryEmit(stats)
+            }
+        }
+        val handle = llmContext.submit(prompt, maxTokens, callback)
+        if (handle == 0L) {
+            close(IllegalStateException("Model not loaded"))
+        }
+        awaitClose {
+            if (handle != 0L) llmContext.cancel(handle)
+        }
+    }
+
+    suspend fun generate(prompt: String, maxTokens: Int = 512): String =
+        generateFlow(prompt, maxTokens).toList().joinToString("")
+
     suspend fun stopGeneration() {
         llmContext.stopCompletion()
     }
@@ -151,14 +505,108 @@ class LlmEngine @Inject constructor(
     suspend fun completion(prompt: String): String = withContext(Dispatchers.IO) {
         mutex.withLock {
             if (!isLoaded) throw IllegalStateException("Model not loaded")
-            llmContext.completion(prompt)
+            llmContext.completion(prompt).also { publishGenerationStats() }
+        }
+    }
+
+    /**
+     * Persist the chat context's KV state for [sessionId] so it survives process death. Snapshots
+     * are keyed by session and model. They hold what the chat cache holds: the system prompt and
+     * the last exchange, since prompts carry no history, so a restore saves the prefill of that
+     * prefix rather than of the conversation.
+     */
+    suspend fun saveSession(dir: String, sessionId: String): Boolean = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock false
+            llmContext.saveSession(dir, sessionId)
+        }
+    }
+
+    /**
+     * Restore a snapshot written by [saveSession]. Returns false if none exists for the loaded model.
+     */
+    suspend fun restoreSession(dir: String, sessionId: String): Boolean = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) return@withLock false
+            llmContext.restoreSession(dir, sessionId)
         }
     }
 
     suspend fun embed(text: String): FloatArray = withContext(Dispatchers.IO) {
         mutex.withLock {
             if (!isLoaded) throw IllegalStateException("Model not loaded")
-            llmContext.embed(text)
+            llmContext.embed(text).also { publishEmbeddingStats() }
+        }
+    }
+
+    /**
+     * Embed several texts with one JNI call; the native side packs them into shared decodes.
+     * Returns one vector per input, in order. Empty inputs yield zero vectors.
+     */
+    suspend fun embedBatch(texts: List<String>): List<FloatArray> = withContext(Dispatchers.IO) {
+        if (texts.isEmpty()) return@withContext emptyList()
+        mutex.withLock {
+            if (!isLoaded) throw IllegalStateException("Model not loaded")
+            val flat = llmContext.embedBatch(texts.toTypedArray())
+            publishEmbeddingStats()
+            val dim = flat.size / texts.size
+            List(texts.size) { i -> flat.copyOfRange(i * dim, (i + 1) * dim) }
+        }
+    }
+
+    /**
+     * Embed [text] in a compact [format]: truncated and renormalized to [EmbeddingFormat.dimensions],
+     * then encoded. Empty for a text without tokens.
+     */
+    suspend fun embedEncoded(text: String, format: EmbeddingFormat): ByteArray = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) throw IllegalStateException("Model not loaded")
+            llmContext.embedEncoded(text, format.dimensions, format.encoding).also { publishEmbeddingStats() }
+        }
+    }
+
+    /**
+     * [embedBatch] in a compact [format]. Returns one code per input, in order; all codes have the
+     * same size.
+     */
+    suspend fun embedBatchEncoded(texts: List<String>, format: EmbeddingFormat): List<ByteArray> = withContext(Dispatchers.IO) {
+        if (texts.isEmpty()) return@withContext emptyList()
+        mutex.withLock {
+            if (!isLoaded) throw IllegalStateException("Model not loaded")
+            val flat = llmContext.embedBatchEncoded(texts.toTypedArray(), format.dimensions, format.encoding)
+            publishEmbeddingStats()
+            val size = flat.size / texts.size
+            List(texts.size) { i -> flat.copyOfRange(i * size, (i + 1) * size) }
+        }
+    }
+
+    /**
+     * Similarity of [query] to each code in [rows] (concatenated), all encoded with [encoding] at
+     * [dimensions] components. INT8 scores approximate the cosine; BINARY scores are 1 - 2 * Hamming
+     * distance / [dimensions], which ranks by angle. Needs no loaded model.
+     */
+    suspend fun scoreEncoded(query: ByteArray, rows: ByteArray, dimensions: Int, encoding: EmbeddingEncoding): FloatArray = withContext(Dispatchers.IO) {
+        llmContext.scoreEncoded(query, rows, dimensions, encoding)
+    }
+
+    /**
+     * Embed a long text as overlapping token windows, one vector per window.
+     * [windowTokens] <= 0 uses the largest window the embedding context can decode at once.
+     */
+    suspend fun embedChunks(text: String, windowTokens: Int = 0, overlapTokens: Int = 64): List<EmbeddingChunk> = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) throw IllegalStateException("Model not loaded")
+            llmContext.embedChunks(text, windowTokens, overlapTokens).toList().also { publishEmbeddingStats() }
+        }
+    }
+
+    /**
+     * Embed a long text as overlapping token windows pooled into one note vector.
+     */
+    suspend fun embedPooled(text: String, windowTokens: Int = 0, overlapTokens: Int = 64, weighted: Boolean = true): FloatArray = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            if (!isLoaded) throw IllegalStateException("Model not loaded")
+            llmContext.embedPooled(text, windowTokens, overlapTokens, weighted).also { publishEmbeddingStats() }
         }
     }
 
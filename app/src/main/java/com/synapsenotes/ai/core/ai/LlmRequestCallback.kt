@@ -0,0 +1,15 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Callback for requests queued on the native batch scheduler. Invoked on a native worker thread;
+ * [onComplete] is called exactly once, also after cancellation or failure, right after [onStats]
+ * and, for a request that failed, [onError].
+ */
+interface LlmRequestCallback : LlmCallback {
+    fun onComplete(result: String, cancelled: Boolean)
+
+    fun onStats(stats: GenerationStats) {}
+
+    /** The request did not finish: its prompt never fits the scheduler's KV cells or a decode failed. */
+    fun onError(message: String) {}
+}
@@ -0,0 +1,29 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Context configuration of the loaded chat model. With a memory budget (see
+ * [HardwareCapabilityProvider.getMemoryBudgetBytes]) the native loader picks the KV cache type and the
+ * largest context that fit next to the weights and the embedding model; without one the requested
+ * context size is used with an F16 cache and [budgetBytes] is 0.
+ */
+data class MemoryPlan(
+    val contextSize: Int,
+    val kvCacheType: KvCacheType,
+    /** Forced on for quantized caches; otherwise llama.cpp decides per device. */
+    val flashAttention: Boolean,
+    /** False if even the smallest context and cache exceeded the budget. */
+    val fitsBudget: Boolean,
+    val kvCacheBytes: Long,
+    val weightBytes: Long,
+    /** Compute buffers and the embedding model. */
+    val reservedBytes: Long,
+    val budgetBytes: Long
+) {
+    override fun toString(): String {
+        val mb = 1024 * 1024
+        return "MemoryPlan(n_ctx $contextSize, $kvCacheType KV ${kvCacheBytes / mb} MB" +
+            (if (flashAttention) ", flash attention" else "") +
+            ", weights ${weightBytes / mb} MB, reserved ${reservedBytes / mb} MB, budget ${budgetBytes / mb} MB" +
+            (if (fitsBudget || budgetBytes == 0L) "" else ", over budget") + ")"
+    }
+}
@@ -0,0 +1,47 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * What a GGUF model file holds, read from its header without loading it (see [LlmEngine.inspectModel]).
+ * Takes milliseconds, so model choice, backend ranking and memory checks can run before committing to
+ * a load. If the header is malformed or the file is truncated, [valid] is false and [error] says why.
+ * Constructed from native code, keep the constructor signature in sync with native-lib.cpp.
+ */
+class ModelInfo(
+    val valid: Boolean,
+    val error: String,
+    val architecture: String,
+    val name: String,
+    /** Template embedded in the file, null if it has none. */
+    val chatTemplate: String?,
+    /** Context length the model was trained with, 0 if unknown. */
+    val trainingContextLength: Int,
+    val layerCount: Int,
+    val embeddingLength: Int,
+    val headCount: Int,
+    val headCountKv: Int,
+    val vocabSize: Int,
+    val tensorCount: Int,
+    /** Tensor types ("q4_K", "f32", ...) by total bytes, largest first, parallel to [tensorTypeBytes]. */
+    val tensorTypes: Array<String>,
+    val tensorTypeBytes: LongArray,
+    val weightBytes: Long,
+    /** F16 KV cache for [kvContextSize] tokens; roughly half with a Q8_0 cache, a quarter with Q4_0. */
+    val kvCacheBytes: Long,
+    val kvContextSize: Int,
+    val fileBytes: Long
+) {
+    /** Main quantization: the tensor type holding the most weight bytes. */
+    val quantization: String?
+        get() = tensorTypes.firstOrNull()
+
+    /** Weights plus the KV cache, before compute buffers. */
+    val estimatedMemoryBytes: Long
+        get() = weightBytes + kvCacheBytes
+
+    override fun toString(): String {
+        val mb = 1024 * 1024
+        if (!valid) return "ModelInfo(invalid: $error)"
+        return "ModelInfo($architecture \"$name\", $layerCount layers, n_ctx_train $trainingContextLength, " +
+            "${quantization ?: "?"}, weights ${weightBytes / mb} MB, KV ${kvCacheBytes / mb} MB at $kvContextSize)"
+    }
+}
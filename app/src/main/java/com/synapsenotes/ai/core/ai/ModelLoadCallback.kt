@@ -0,0 +1,10 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Progress of a native model load, delivered on its loader thread. [onComplete] is called exactly
+ * once, also after cancellation.
+ */
+interface ModelLoadCallback {
+    fun onProgress(loadedBytes: Long, totalBytes: Long)
+    fun onComplete(success: Boolean, cancelled: Boolean)
+}
@@ -0,0 +1,13 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Bytes of a model file read so far by the load in progress.
+ */
+data class ModelLoadProgress(
+    val path: String,
+    val loadedBytes: Long,
+    val totalBytes: Long
+) {
+    val fraction: Float
+        get() = if (totalBytes > 0) (loadedBytes.toFloat() / totalBytes).coerceIn(0f, 1f) else 0f
+}
@@ -14,10 +14,16 @@ class ModelManager @Inject constructor(
     private val modelsDir: File
         get() = File(context.filesDir, "models")
 
+    private val sessionsDir: File
+        get() = File(context.filesDir, "sessions")
+
     init {
         if (!modelsDir.exists()) {
             modelsDir.mkdirs()
         }
+        if (!sessionsDir.exists()) {
+            sessionsDir.mkdirs()
+        }
     }
 
     fun isModelAvailable(modelName: String): Boolean {
@@ -29,6 +35,13 @@ class ModelManager @Inject constructor(
         return File(modelsDir, modelName).absolutePath
     }
     
+    /**
+     * Directory holding persisted chat KV snapshots (see [LlmEngine.saveSession]).
+     */
+    fun getSessionsPath(): String {
+        return sessionsDir.absolutePath
+    }
+
     fun getConfigPath(modelFilename: String): String {
         return File(modelsDir, "${modelFilename}.json").absolutePath
     }
@@ -0,0 +1,104 @@
+package com.synapsenotes.ai.core.ai
+
+import android.content.Context
+import android.util.Log
+import com.synapsenotes.ai.domain.model.Note
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import dagger.hilt.android.qualifiers.ApplicationContext
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.flow.first
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
+import java.io.File
+import javax.inject.Inject
+import javax.inject.Singleton
+
+/**
+ * Persistent BM25 keyword index over note titles and content, kept in sync by the note use cases.
+ * Works without an embedding model, and fuses with [NoteVectorIndex] hits for hybrid retrieval.
+ * If the index file is missing or unreadable, the index is rebuilt from all notes when it is opened.
+ */
+@Singleton
+class NoteTextIndex @Inject constructor(
+    @ApplicationContext private val context: Context,
+    private val repository: NoteRepository
+) {
+    companion object {
+        private const val TAG = "NoteTextIndex"
+    }
+
+    private val mutex = Mutex()
+    private var index: TextIndex? = null
+
+    private suspend fun indexFor(): TextIndex? {
+        if (index == null) {
+            val opened = TextIndex(File(context.filesDir, "notes.tidx").absolutePath)
+            index = if (opened.isAvailable) opened else null
+            // Built before the first add, which would otherwise save an index of just that note
+            index?.takeIf { it.size == 0 }?.let { build(it) }
+        }
+        return index
+    }
+
+    // The native tokenizer only folds ASCII case
+    private fun indexedText(note: Note): String = "${note.title}\n${note.content}".lowercase()
+
+    private suspend fun build(idx: TextIndex) {
+        val notes = repository.getAllNotes().first()
+        if (notes.isNotEmpty()) {
+            Log.i(TAG, "Building text index from ${notes.size} notes")
+            notes.forEach { idx.add(it.id, indexedText(it)) }
+            idx.save()
+        }
+    }
+
+    /**
+     * Top-[topK] (note id, BM25 score) pairs for [query], or null when the native index is unavailable.
+     */
+    suspend fun search(query: String, topK: Int): List<Pair<String, Float>>? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            val idx = indexFor() ?: return@withLock null
+            idx.search(query.lowercase(), topK)
+        }
+    }
+
+    /**
+     * Top-[topK] note ids ranked by `alpha * cosine + (1 - alpha) * BM25`, or null when the
+     * native index is unavailable.
+     */
+    suspend fun searchHybrid(
+        query: String,
+        topK: Int,
+        vectorHits: List<Pair<String, Float>>,
+        alpha: Float
+    ): List<String>? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            val idx = indexFor() ?: return@withLock null
+            idx.searchHybrid(query.lowercase(), topK, vectorHits, alpha).map { it.first }
+        }
+    }
+
+    suspend fun upsert(note: Note) = upsertAll(listOf(note))
+
+    /**
+     * Add or replace several notes, persisting the index once.
+     */
+    suspend fun upsertAll(notes: List<Note>) = withContext(Dispatchers.IO) {
+        if (notes.isEmpty()) return@withContext
+        mutex.withLock {
+            val idx = indexFor() ?: return@withLock
+            notes.forEach { idx.add(it.id, indexedText(it)) }
+            idx.save()
+        }
+    }
+
+    suspend fun remove(noteId: String) = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            val idx = indexFor() ?: return@withLock
+            if (idx.remove(noteId)) {
+                idx.save()
+            }
+        }
+    }
+}
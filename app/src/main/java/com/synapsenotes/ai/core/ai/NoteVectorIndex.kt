@@ -0,0 +1,100 @@
+package com.synapsenotes.ai.core.ai
+
+import android.content.Context
+import android.util.Log
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import dagger.hilt.android.qualifiers.ApplicationContext
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.flow.first
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
+import java.io.File
+import javax.inject.Inject
+import javax.inject.Singleton
+
+/**
+ * Persistent ANN index of note embeddings, kept in sync by the note use cases.
+ * The index file is keyed by embedding dimension so switching embedding models starts a fresh index.
+ * An index that could not be loaded is rebuilt from the stored embeddings before it is first used.
+ */
+@Singleton
+class NoteVectorIndex @Inject constructor(
+    @ApplicationContext private val context: Context,
+    private val repository: NoteRepository
+) {
+    companion object {
+        private const val TAG = "NoteVectorIndex"
+        private val INDEX_FILE = Regex("notes-(\\d+)\\.vidx")
+    }
+
+    private val mutex = Mutex()
+    private var index: VectorIndex? = null
+
+    private fun indexFile(dim: Int): File = File(context.filesDir, "notes-$dim.vidx")
+
+    private suspend fun indexFor(dim: Int): VectorIndex? {
+        val current = index
+        if (current != null && current.dim == dim) return current
+
+        current?.close()
+        val opened = VectorIndex(indexFile(dim).absolutePath, dim)
+        index = if (opened.isAvailable) opened else null
+        // Missing (first run after an upgrade, new embedding model) or unreadable: backfill before
+        // anything is added, or notes embedded earlier would never reach the index
+        index?.takeIf { it.size == 0 }?.let { build(it) }
+        return index
+    }
+
+    private suspend fun build(idx: VectorIndex) {
+        val notes = repository.getAllNotes().first().filter { it.embedding?.size == idx.dim }
+        if (notes.isNotEmpty()) {
+            Log.i(TAG, "Building vector index from ${notes.size} notes")
+            notes.forEach { idx.add(it.id, it.embedding!!) }
+            idx.save()
+        }
+    }
+
+    // Dimension of the index written last, which is the current embedding model's
+    private fun lastIndexDim(): Int? {
+        return context.filesDir.listFiles()
+            ?.filter { INDEX_FILE.matches(it.name) }
+            ?.maxByOrNull { it.lastModified() }
+            ?.let { INDEX_FILE.matchEntire(it.name)!!.groupValues[1].toIntOrNull() }
+    }
+
+    /**
+     * Top-[topK] (note id, cosine similarity) pairs for [query], or null when the native index is unavailable.
+     */
+    suspend fun search(query: FloatArray, topK: Int): List<Pair<String, Float>>? = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            val idx = indexFor(query.size) ?: return@withLock null
+            idx.search(query, topK)
+        }
+    }
+
+    suspend fun upsert(noteId: String, embedding: FloatArray) = upsertAll(listOf(noteId to embedding))
+
+    /**
+     * Add or replace several embeddings, persisting the index once.
+     */
+    suspend fun upsertAll(entries: List<Pair<String, FloatArray>>) = withContext(Dispatchers.IO) {
+        if (entries.isEmpty()) return@withContext
+        mutex.withLock {
+            val idx = indexFor(entries.first().second.size) ?: return@withLock
+            entries.filter { it.second.size == idx.dim }.forEach { (id, embedding) -> idx.add(id, embedding) }
+            idx.save()
+        }
+    }
+
+    suspend fun remove(noteId: String) = withContext(Dispatchers.IO) {
+        mutex.withLock {
+            // Not opened yet in this process: the persisted index still has to drop the note
+            val dim = index?.dim ?: lastIndexDim() ?: return@withLock
+            val idx = indexFor(dim) ?: return@withLock
+            if (idx.remove(noteId)) {
+                idx.save()
+            }
+        }
+    }
+}
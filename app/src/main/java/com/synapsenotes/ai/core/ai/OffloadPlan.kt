@@ -0,0 +1,27 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * How the loaded chat model is split between GPU and CPU memory, planned from its tensor sizes and
+ * the memory available at load time.
+ */
+data class OffloadPlan(
+    val gpuLayers: Int,
+    val totalLayers: Int,
+    /** Leading layers that run on the GPU but keep their FFN matrices in CPU memory. */
+    val cpuFfnLayers: Int,
+    val gpuBytes: Long,
+    val cpuBytes: Long,
+    val kvCacheBytes: Long,
+    val budgetBytes: Long
+) {
+    /** Whether every layer and the output head run on the GPU with no tensors left on the CPU. */
+    val isFullOffload: Boolean
+        get() = gpuLayers > totalLayers && cpuFfnLayers == 0
+
+    override fun toString(): String {
+        val mb = 1024 * 1024
+        return "OffloadPlan(${minOf(gpuLayers, totalLayers)}/$totalLayers layers on GPU" +
+            (if (cpuFfnLayers > 0) ", $cpuFfnLayers with CPU FFN" else "") +
+            ", GPU ${gpuBytes / mb} MB, CPU ${cpuBytes / mb} MB, KV ${kvCacheBytes / mb} MB, budget ${budgetBytes / mb} MB)"
+    }
+}
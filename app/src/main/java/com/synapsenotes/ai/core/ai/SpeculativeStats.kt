@@ -0,0 +1,12 @@
+package com.synapsenotes.ai.core.ai
+
+/**
+ * Draft-token acceptance of the last completion when speculative decoding is active.
+ */
+data class SpeculativeStats(
+    val draftedTokens: Int,
+    val acceptedTokens: Int
+) {
+    val acceptanceRate: Float
+        get() = if (draftedTokens > 0) acceptedTokens.toFloat() / draftedTokens else 0f
+}
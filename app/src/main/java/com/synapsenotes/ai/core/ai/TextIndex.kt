@@ -0,0 +1,81 @@
+package com.synapsenotes.ai.core.ai
+
+import java.io.Closeable
+
+/**
+ * Native BM25 inverted index over text, persisted at [path].
+ * Terms are split on non-alphanumeric ASCII and lowercased for ASCII only, so callers should
+ * lowercase non-Latin text themselves. Calls are not thread-safe; callers serialize access.
+ */
+class TextIndex(private val path: String) : Closeable {
+
+    private var handle: Long = if (LlamaContext.isLibraryLoaded) nativeOpen(path) else 0L
+
+    val isAvailable: Boolean
+        get() = handle != 0L
+
+    val size: Int
+        get() = if (isAvailable) nativeSize(handle) else 0
+
+    fun add(id: String, text: String) {
+        if (isAvailable) nativeAdd(handle, id, text)
+    }
+
+    fun remove(id: String): Boolean {
+        return isAvailable && nativeRemove(handle, id)
+    }
+
+    /**
+     * Returns up to [k] (id, BM25 score) pairs, best first.
+     */
+    fun search(query: String, k: Int): List<Pair<String, Float>> {
+        if (!isAvailable) return emptyList()
+        val scores = FloatArray(k)
+        val ids = nativeSearch(handle, query, k, scores)
+        return ids.mapIndexed { i, id -> id to scores[i] }
+    }
+
+    /**
+     * Fuses BM25 with [vectorHits] (id, cosine similarity) from [VectorIndex.search]:
+     * `alpha * cosine + (1 - alpha) * normalized BM25`. Returns up to [k] pairs, best first.
+     */
+    fun searchHybrid(query: String, k: Int, vectorHits: List<Pair<String, Float>>, alpha: Float): List<Pair<String, Float>> {
+        if (!isAvailable) return emptyList()
+        val scores = FloatArray(k)
+        val ids = nativeSearchHybrid(
+            handle, query, k,
+            vectorHits.map { it.first }.toTypedArray(),
+            vectorHits.map { it.second }.toFloatArray(),
+            alpha, scores
+        )
+        return ids.mapIndexed { i, id -> id to scores[i] }
+    }
+
+    fun save(): Boolean {
+        return isAvailable && nativeSave(handle, path)
+    }
+
+    override fun close() {
+        if (isAvailable) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+
+    private external fun nativeOpen(path: String): Long
+    private external fun nativeAdd(handle: Long, id: String, text: String)
+    private external fun nativeRemove(handle: Long, id: String): Boolean
+    private external fun nativeSearch(handle: Long, query: String, k: Int, scoresOut: FloatArray): Array<String>
+    private external fun nativeSearchHybrid(
+        handle: Long,
+        query: String,
+        k: Int,
+        vectorIds: Array<String>,
+        vectorScores: FloatArray,
+        alpha: Float,
+        scoresOut: FloatArray
+    ): Array<String>
+    private external fun nativeSave(handle: Long, path: String): Boolean
+    private external fun nativeSize(handle: Long): Int
+    private external fun nativeClose(handle: Long)
+}
@@ -0,0 +1,60 @@
+package com.synapsenotes.ai.core.ai
+
+import java.io.Closeable
+
+/**
+ * Native approximate-nearest-neighbour index (HNSW) over embeddings, backed by a
+ * memory-mapped file at [path]. Vectors are stored int8-quantized when [quantized] is set.
+ * Calls are not thread-safe; callers serialize access.
+ */
+class VectorIndex(
+    private val path: String,
+    val dim: Int,
+    quantized: Boolean = true
+) : Closeable {
+
+    private var handle: Long = if (LlamaContext.isLibraryLoaded) nativeOpen(path, dim, quantized) else 0L
+
+    val isAvailable: Boolean
+        get() = handle != 0L
+
+    val size: Int
+        get() = if (isAvailable) nativeSize(handle) else 0
+
+    fun add(id: String, vector: FloatArray) {
+        if (isAvailable) nativeAdd(handle, id, vector)
+    }
+
+    fun remove(id: String): Boolean {
+        return isAvailable && nativeRemove(handle, id)
+    }
+
+    /**
+     * Returns up to [k] (id, similarity) pairs, best first.
+     */
+    fun search(query: FloatArray, k: Int): List<Pair<String, Float>> {
+        if (!isAvailable) return emptyList()
+        val scores = FloatArray(k)
+        val ids = nativeSearch(handle, query, k, scores)
+        return ids.mapIndexed { i, id -> id to scores[i] }
+    }
+
+    fun save(): Boolean {
+        return isAvailable && nativeSave(handle, path)
+    }
+
+    override fun close() {
+        if (isAvailable) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+
+    private external fun nativeOpen(path: String, dim: Int, quantized: Boolean): Long
+    private external fun nativeAdd(handle: Long, id: String, vector: FloatArray)
+    private external fun nativeRemove(handle: Long, id: String): Boolean
+    private external fun nativeSearch(handle: Long, query: FloatArray, k: Int, scoresOut: FloatArray): Array<String>
+    private external fun nativeSave(handle: Long, path: String): Boolean
+    private external fun nativeSize(handle: Long): Int
+    private external fun nativeClose(handle: Long)
+}
@@ -26,6 +26,10 @@ class NoteRepositoryImpl @Inject constructor(
         noteDao.insert(note.toEntity())
     }
 
+    override suspend fun updateEmbedding(id: String, updatedAt: Long, embedding: FloatArray?): Boolean {
+        return noteDao.updateEmbedding(id, updatedAt, embedding) > 0
+    }
+
     override suspend fun deleteNote(id: String) {
         noteDao.delete(id)
     }
@@ -6,7 +6,7 @@ import androidx.room.TypeConverters
 
 @Database(
     entities = [NoteEntity::class, ChatSessionEntity::class, ChatMessageEntity::class],
-    version = 3,
+    version = 4,
     exportSchema = false
 )
 @TypeConverters(Converters::class)
@@ -2,6 +2,8 @@ package com.synapsenotes.ai.core.database
 
 import androidx.room.TypeConverter
 import org.json.JSONArray
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 class Converters {
 
@@ -23,19 +25,21 @@ class Converters {
         return JSONArray(list).toString()
     }
 
+    // Embeddings are stored as little-endian float32 blobs: 4 bytes per dimension instead of ~10
+    // characters of text, and no parsing when notes are loaded
     @TypeConverter
-    fun fromFloatList(value: String?): List<Float>? {
-        if (value.isNullOrEmpty()) return null
-        return try {
-            value.split(",").map { it.trim().toFloat() }
-        } catch (e: NumberFormatException) {
-            null
-        }
+    fun fromEmbeddingBlob(value: ByteArray?): FloatArray? {
+        if (value == null || value.isEmpty() || value.size % 4 != 0) return null
+        val floats = FloatArray(value.size / 4)
+        ByteBuffer.wrap(value).order(ByteOrder.LITTLE_ENDIAN).asFloatBuffer().get(floats)
+        return floats
     }
 
     @TypeConverter
-    fun toFloatList(list: List<Float>?): String? {
-        if (list == null) return null
-        return list.joinToString(",")
+    fun toEmbeddingBlob(vector: FloatArray?): ByteArray? {
+        if (vector == null) return null
+        val buffer = ByteBuffer.allocate(vector.size * 4).order(ByteOrder.LITTLE_ENDIAN)
+        buffer.asFloatBuffer().put(vector)
+        return buffer.array()
     }
 }
@@ -0,0 +1,44 @@
+package com.synapsenotes.ai.core.database
+
+import androidx.room.migration.Migration
+import androidx.sqlite.db.SupportSQLiteDatabase
+
+/**
+ * Version 4 stores note embeddings as float32 blobs instead of comma-separated text. SQLite cannot
+ * change a column's type in place, so the table is rebuilt and existing vectors are converted here
+ * rather than dropped, which would leave every note unsearchable until it is edited again.
+ */
+val MIGRATION_3_4 = object : Migration(3, 4) {
+    override fun migrate(db: SupportSQLiteDatabase) {
+        db.execSQL(
+            "CREATE TABLE notes_new (id TEXT NOT NULL, title TEXT, content TEXT, createdAt INTEGER NOT NULL, " +
+                "updatedAt INTEGER NOT NULL, tags TEXT NOT NULL, embedding BLOB, PRIMARY KEY(id))"
+        )
+        db.execSQL(
+            "INSERT INTO notes_new (id, title, content, createdAt, updatedAt, tags) " +
+                "SELECT id, title, content, createdAt, updatedAt, tags FROM notes"
+        )
+
+        val converters = Converters()
+        db.query("SELECT id, embedding FROM notes WHERE embedding IS NOT NULL AND embedding != ''").use { cursor ->
+            while (cursor.moveToNext()) {
+                val vector = parseLegacyEmbedding(cursor.getString(1)) ?: continue
+                db.execSQL(
+                    "UPDATE notes_new SET embedding = ? WHERE id = ?",
+                    arrayOf<Any?>(converters.toEmbeddingBlob(vector), cursor.getString(0))
+                )
+            }
+        }
+
+        db.execSQL("DROP TABLE notes")
+        db.execSQL("ALTER TABLE notes_new RENAME TO notes")
+    }
+}
+
+private fun parseLegacyEmbedding(value: String): FloatArray? {
+    return try {
+        value.split(",").map { it.trim().toFloat() }.toFloatArray()
+    } catch (e: NumberFormatException) {
+        null
+    }
+}
@@ -17,6 +17,10 @@ interface NoteDao {
     @Insert(onConflict = OnConflictStrategy.REPLACE)
     suspend fun insert(note: NoteEntity)
 
+    // Only the embedding column, and only while the note is the version it was computed from
+    @Query("UPDATE notes SET embedding = :embedding WHERE id = :id AND updatedAt = :updatedAt")
+    suspend fun updateEmbedding(id: String, updatedAt: Long, embedding: FloatArray?): Int
+
     @Query("DELETE FROM notes WHERE id = :id")
     suspend fun delete(id: String)
 }
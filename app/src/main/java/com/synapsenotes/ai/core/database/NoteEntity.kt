@@ -12,5 +12,29 @@ data class NoteEntity(
     val createdAt: Long,
     val updatedAt: Long,
     val tags: List<String> = emptyList(),
-    val embedding: List<Float>? = null
-)
+    val embedding: FloatArray? = null
+) {
+    // Room emits a new entity per query, so equal rows must compare equal despite the array field
+    override fun equals(other: Any?): Boolean {
+        if (this === other) return true
+        if (other !is NoteEntity) return false
+        return id == other.id &&
+            title == other.title &&
+            content == other.content &&
+            createdAt == other.createdAt &&
+            updatedAt == other.updatedAt &&
+            tags == other.tags &&
+            embedding.contentEquals(other.embedding)
+    }
+
+    override fun hashCode(): Int {
+        var result = id.hashCode()
+        result = 31 * result + (title?.hashCode() ?: 0)
+        result = 31 * result + (content?.hashCode() ?: 0)
+        result = 31 * result + createdAt.hashCode()
+        result = 31 * result + updatedAt.hashCode()
+        result = 31 * result + tags.hashCode()
+        result = 31 * result + embedding.contentHashCode()
+        return result
+    }
+}
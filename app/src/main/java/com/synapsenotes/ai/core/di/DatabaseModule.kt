@@ -4,6 +4,7 @@ import android.content.Context
 import androidx.room.Room
 import com.synapsenotes.ai.core.database.AppDatabase
 import com.synapsenotes.ai.core.database.ChatDao
+import com.synapsenotes.ai.core.database.MIGRATION_3_4
 import com.synapsenotes.ai.core.database.NoteDao
 import dagger.Module
 import dagger.Provides
@@ -24,6 +25,7 @@ object DatabaseModule {
             AppDatabase::class.java,
             "llm_notes_db"
         )
+        .addMigrations(MIGRATION_3_4)
         .fallbackToDestructiveMigration()
         .build()
     }
@@ -7,5 +7,29 @@ data class Note(
     val createdAt: Long,
     val updatedAt: Long,
     val tags: List<String>,
-    val embedding: List<Float>?
-)
+    val embedding: FloatArray?
+) {
+    // Arrays compare by identity in generated data class members; compare the embedding by content
+    override fun equals(other: Any?): Boolean {
+        if (this === other) return true
+        if (other !is Note) return false
+        return id == other.id &&
+            title == other.title &&
+            content == other.content &&
+            createdAt == other.createdAt &&
+            updatedAt == other.updatedAt &&
+            tags == other.tags &&
+            embedding.contentEquals(other.embedding)
+    }
+
+    override fun hashCode(): Int {
+        var result = id.hashCode()
+        result = 31 * result + title.hashCode()
+        result = 31 * result + content.hashCode()
+        result = 31 * result + createdAt.hashCode()
+        result = 31 * result + updatedAt.hashCode()
+        result = 31 * result + tags.hashCode()
+        result = 31 * result + embedding.contentHashCode()
+        return result
+    }
+}
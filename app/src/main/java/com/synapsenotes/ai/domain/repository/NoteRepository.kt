@@ -7,5 +7,11 @@ interface NoteRepository {
     fun getAllNotes(): Flow<List<Note>>
     suspend fun getNoteById(id: String): Note?
     suspend fun saveNote(note: Note)
+
+    /**
+     * Store [embedding] on note [id] if it is still at version [updatedAt], leaving every other column
+     * alone. Returns false if the note was edited or deleted since.
+     */
+    suspend fun updateEmbedding(id: String, updatedAt: Long, embedding: FloatArray?): Boolean
     suspend fun deleteNote(id: String)
 }
@@ -1,12 +1,21 @@
 package com.synapsenotes.ai.domain.usecase
 
+import com.synapsenotes.ai.core.ai.EmbeddingIndexer
+import com.synapsenotes.ai.core.ai.NoteTextIndex
+import com.synapsenotes.ai.core.ai.NoteVectorIndex
 import com.synapsenotes.ai.domain.repository.NoteRepository
 import javax.inject.Inject
 
 class DeleteNoteUseCase @Inject constructor(
-    private val repository: NoteRepository
+    private val repository: NoteRepository,
+    private val noteVectorIndex: NoteVectorIndex,
+    private val noteTextIndex: NoteTextIndex,
+    private val embeddingIndexer: EmbeddingIndexer
 ) {
     suspend operator fun invoke(id: String) {
+        embeddingIndexer.cancel(id)
         repository.deleteNote(id)
+        noteVectorIndex.remove(id)
+        noteTextIndex.remove(id)
     }
 }
@@ -1,27 +1,45 @@
 package com.synapsenotes.ai.domain.usecase
 
-import com.synapsenotes.ai.core.ai.LlmEngine
+import com.synapsenotes.ai.core.ai.EmbeddingIndexer
+import com.synapsenotes.ai.core.ai.NoteTextIndex
+import com.synapsenotes.ai.core.ai.NoteVectorIndex
 import com.synapsenotes.ai.domain.model.Note
 import com.synapsenotes.ai.domain.repository.NoteRepository
 import javax.inject.Inject
 
 class SaveNoteUseCase @Inject constructor(
     private val repository: NoteRepository,
-    private val llmEngine: LlmEngine
+    private val embeddingIndexer: EmbeddingIndexer,
+    private val noteVectorIndex: NoteVectorIndex,
+    private val noteTextIndex: NoteTextIndex
 ) {
+    /**
+     * Save [note] right away; its embedding is computed in the background by [EmbeddingIndexer].
+     * Until then the vector index keeps the previous version's vector.
+     */
     suspend operator fun invoke(note: Note) {
-        // Generate embedding if content is present
-        val embedding = if (note.content.isNotBlank()) {
-            try {
-                llmEngine.embed(note.content).toList()
-            } catch (e: Exception) {
-                null
-            }
-        } else {
-            null
+        repository.saveNote(note)
+        noteTextIndex.upsert(note)
+
+        if (note.content.isBlank() || !embeddingIndexer.enqueue(note)) {
+            embeddingIndexer.cancel(note.id)
+            noteVectorIndex.remove(note.id)
+        }
+    }
+
+    /**
+     * Save many notes at once (imports, re-indexing). Embeddings are queued as one background job.
+     */
+    suspend fun saveAll(notes: List<Note>) {
+        for (note in notes) {
+            repository.saveNote(note)
+        }
+        noteTextIndex.upsertAll(notes)
+
+        val (toEmbed, blank) = notes.partition { it.content.isNotBlank() }
+        blank.forEach { noteVectorIndex.remove(it.id) }
+        if (!embeddingIndexer.enqueueAll(toEmbed)) {
+            toEmbed.forEach { noteVectorIndex.remove(it.id) }
         }
-        
-        val noteWithEmbedding = note.copy(embedding = embedding)
-        repository.saveNote(noteWithEmbedding)
     }
 }
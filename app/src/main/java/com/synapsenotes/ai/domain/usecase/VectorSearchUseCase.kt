@@ -1,6 +1,8 @@
 package com.synapsenotes.ai.domain.usecase
 
 import com.synapsenotes.ai.core.ai.LlmEngine
+import com.synapsenotes.ai.core.ai.NoteTextIndex
+import com.synapsenotes.ai.core.ai.NoteVectorIndex
 import com.synapsenotes.ai.core.util.VectorMath
 import com.synapsenotes.ai.domain.model.Note
 import com.synapsenotes.ai.domain.repository.NoteRepository
@@ -9,25 +11,45 @@ import javax.inject.Inject
 
 class VectorSearchUseCase @Inject constructor(
     private val repository: NoteRepository,
-    private val llmEngine: LlmEngine
+    private val llmEngine: LlmEngine,
+    private val noteVectorIndex: NoteVectorIndex,
+    private val noteTextIndex: NoteTextIndex
 ) {
+    companion object {
+        // Weight of semantic similarity against keyword relevance in hybrid ranking
+        private const val HYBRID_ALPHA = 0.7f
+    }
+
     suspend operator fun invoke(query: String, topK: Int = 3): List<Note> {
-        val allNotes = repository.getAllNotes().first()
+        val allNotes: suspend () -> List<Note> = { repository.getAllNotes().first() }
 
         val queryEmbedding = try {
             llmEngine.embed(query)
         } catch (e: Exception) {
-            // Fallback to simple keyword search if embedding fails
-            return allNotes.filter { 
+            // Fallback to BM25 keyword search if embedding fails
+            val keywordHits = noteTextIndex.search(query, topK)
+            if (keywordHits != null) {
+                return keywordHits.mapNotNull { repository.getNoteById(it.first) }
+            }
+            return allNotes().filter { 
                 it.title.contains(query, ignoreCase = true) || 
                 it.content.contains(query, ignoreCase = true) 
             }.take(topK)
         }
-        
-        return allNotes
+
+        // Sub-linear lookup through the native indexes; only the hits are loaded
+        val vectorHits = noteVectorIndex.search(queryEmbedding, maxOf(topK * 4, 20))
+        if (vectorHits != null) {
+            val ids = noteTextIndex.searchHybrid(query, topK, vectorHits, HYBRID_ALPHA)
+                ?: vectorHits.take(topK).map { it.first }
+            return ids.mapNotNull { repository.getNoteById(it) }
+        }
+
+        // Native index unavailable: brute-force scan
+        return allNotes()
             .filter { it.embedding != null }
             .map { note ->
-                val similarity = VectorMath.cosineSimilarity(queryEmbedding, note.embedding!!.toFloatArray())
+                val similarity = VectorMath.cosineSimilarity(queryEmbedding, note.embedding!!)
                 note to similarity
             }
             .sortedByDescending { it.second }
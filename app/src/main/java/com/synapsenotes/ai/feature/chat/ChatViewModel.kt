@@ -4,6 +4,7 @@ import androidx.lifecycle.ViewModel
 import androidx.lifecycle.viewModelScope
 import com.synapsenotes.ai.core.ai.HardwareInfo
 import com.synapsenotes.ai.core.ai.LlmEngine
+import com.synapsenotes.ai.core.ai.ModelManager
 import com.synapsenotes.ai.domain.model.ChatMessage
 import com.synapsenotes.ai.domain.model.Note
 import com.synapsenotes.ai.domain.model.SourceNote
@@ -27,7 +28,8 @@ class ChatViewModel @Inject constructor(
     private val vectorSearchUseCase: VectorSearchUseCase,
     private val llmEngine: LlmEngine,
     private val chatRepository: ChatRepository,
-    private val noteRepository: NoteRepository
+    private val noteRepository: NoteRepository,
+    private val modelManager: ModelManager
 ) : ViewModel() {
 
     private val _currentSessionId = MutableStateFlow<String?>(null)
@@ -64,6 +66,7 @@ class ChatViewModel @Inject constructor(
     }
 
     fun createNewSession() {
+        saveSessionOnLeave(_currentSessionId.value)
         _currentSessionId.value = null
         _messages.value = emptyList()
         _selectedNotes.value = emptyList()
@@ -77,9 +80,28 @@ class ChatViewModel @Inject constructor(
         }
     }
     
+    // Prompts carry no conversation history, so the chat KV cache only ever holds the system prompt
+    // and the last exchange, and a snapshot per answer would rewrite much the same prefix each time.
+    // One snapshot when the session is left is enough to skip that prefill on the first follow-up
+    // after coming back to it, also in a later process.
+    private fun saveSessionOnLeave(sessionId: String?) {
+        if (sessionId == null) return
+        viewModelScope.launch {
+            llmEngine.saveSession(modelManager.getSessionsPath(), sessionId)
+        }
+    }
+
     fun loadSession(sessionId: String) {
+        val previousSessionId = _currentSessionId.value
         viewModelScope.launch {
             _currentSessionId.value = sessionId
+            launch {
+                // Snapshot the session being left before its cache is replaced by this one's
+                if (previousSessionId != null && previousSessionId != sessionId) {
+                    llmEngine.saveSession(modelManager.getSessionsPath(), previousSessionId)
+                }
+                llmEngine.restoreSession(modelManager.getSessionsPath(), sessionId)
+            }
             chatRepository.getMessagesForSession(sessionId).collect { dbMessages ->
                 _messages.value = dbMessages
             }
@@ -121,20 +143,25 @@ class ChatViewModel @Inject constructor(
                     vectorSearchUseCase(text)
                 }
 
-                var context = relevantNotes.joinToString("\n\n") { "Note: ${it.title}\n${it.content}" }
-                val sources = relevantNotes.map { note ->
+                // Pack the notes natively by token count, in rank order, so the prompt fills the
+                // context window without overflowing it
+                val chunks = relevantNotes.map { "Note: ${it.title}\n${it.content}" }
+                val assembled = if (chunks.isNotEmpty()) llmEngine.assemblePrompt(text, chunks) else null
+                val usedNotes = assembled?.includedChunks?.map { relevantNotes[it] } ?: relevantNotes
+                val sources = usedNotes.map { note ->
                     SourceNote(noteId = note.id, noteTitle = note.title)
                 }
-                
-                if (context.length > 10000) {
-                     context = context.take(10000) + "\n\n[System: Context truncated due to length]"
-                }
+                val hasContext = usedNotes.isNotEmpty()
 
-                val contextString = if (context.isNotBlank()) "Context:\n$context\n\n" else ""
-                val prompt = if (contextString.isNotBlank()) {
-                    "$contextString\n$text"
+                val replyFlow = if (assembled != null) {
+                    llmEngine.completionFlow(assembled)
                 } else {
-                    text
+                    // Template cannot be assembled from tokens: plain text prompt, cut to a rough size
+                    var context = chunks.joinToString("\n\n")
+                    if (context.length > 10000) {
+                        context = context.take(10000) + "\n\n[System: Context truncated due to length]"
+                    }
+                    llmEngine.completionFlow(if (context.isNotBlank()) "Context:\n$context\n\n\n$text" else text)
                 }
                 
                 var currentResponse = ""
@@ -149,7 +176,10 @@ class ChatViewModel @Inject constructor(
                 
                 _messages.update { it + aiMsg }
 
-                llmEngine.completionFlow(prompt).collect { token ->
+                // Answers grounded in notes copy phrases from them, which prompt lookup can draft for free
+                llmEngine.setPromptLookup(enabled = hasContext)
+
+                replyFlow.collect { token ->
                     var processedToken = token
                     
                     if (token.contains("<think>")) {
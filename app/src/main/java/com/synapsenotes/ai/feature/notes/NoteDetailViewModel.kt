@@ -113,7 +113,8 @@ class NoteDetailViewModel @Inject constructor(
                     AiAction.AUTO_COMPLETE -> "Continue this text:\n$currentContent"
                 }
                 
-                val result = llmEngine.completion(prompt)
+                // Scheduled alongside chat instead of waiting for it
+                val result = llmEngine.generate(prompt)
                 
                 val newContent = if (action == AiAction.AUTO_COMPLETE) {
                     currentContent + result
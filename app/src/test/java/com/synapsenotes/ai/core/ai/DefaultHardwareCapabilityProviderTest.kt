@@ -9,10 +9,14 @@ import io.mockk.mockk
 import io.mockk.spyk
 import io.mockk.verify
 import org.junit.jupiter.api.Assertions.assertEquals
+import org.junit.jupiter.api.Assertions.assertFalse
+import org.junit.jupiter.api.Assertions.assertTrue
 import org.junit.jupiter.api.BeforeEach
 import org.junit.jupiter.api.Test
 import org.junit.jupiter.api.extension.RegisterExtension
+import org.junit.jupiter.api.io.TempDir
 import android.os.Build
+import java.io.File
 import java.lang.reflect.Field
 import java.lang.reflect.Modifier
 
@@ -29,6 +33,11 @@ class DefaultHardwareCapabilityProviderTest {
     private val sharedPreferences: SharedPreferences = mockk(relaxed = true)
     private val prefsEditor: SharedPreferences.Editor = mockk(relaxed = true)
 
+    @TempDir
+    lateinit var filesDir: File
+    private var now = 1_700_000_000_000L
+    private var softwareBuild = "build-1"
+
     @BeforeEach
     fun setup() {
         every { context.packageManager } returns packageManager
@@ -44,12 +53,15 @@ class DefaultHardwareCapabilityProviderTest {
         // Default: No backend being attempted (no previous crash)
         every { sharedPreferences.getString("attempting_backend", null) } returns null
         every { prefsEditor.remove(any()) } returns prefsEditor
+        every { context.filesDir } returns filesDir
 
         val realProvider = DefaultHardwareCapabilityProvider(context, llmContext)
         provider = spyk(realProvider)
         every { provider["getSdkInt"]() } returns 30
         every { provider["getModel"]() } returns "generic"
         every { provider["getHardware"]() } returns "generic"
+        every { provider["currentTimeMillis"]() } answers { now }
+        every { provider["getSoftwareBuild"]() } answers { softwareBuild }
     }
 
     private fun setStaticField(clazz: Class<*>, fieldName: String, value: Any) {
@@ -82,4 +94,56 @@ class DefaultHardwareCapabilityProviderTest {
         
         assertEquals(BackendType.CPU, result)
     }
-}
\ No newline at end of file
+
+    @Test
+    fun `backend benchmarks persist across provider instances`() {
+        provider.recordBackendBenchmark("model@soc", BackendType.VULKAN, BackendBenchmark(300f, 20f))
+        provider.recordBackendBenchmark("model@soc", BackendType.CPU, BackendBenchmark(50f, 8f))
+        provider.recordBackendBenchmark("other@soc", BackendType.OPENCL, BackendBenchmark(100f, 10f))
+
+        val reloaded = DefaultHardwareCapabilityProvider(context, llmContext)
+
+        assertEquals(
+            mapOf(BackendType.VULKAN to BackendBenchmark(300f, 20f), BackendType.CPU to BackendBenchmark(50f, 8f)),
+            reloaded.getBackendProfile("model@soc")
+        )
+        assertTrue(File(filesDir, "backend_profiles.json").exists())
+        assertFalse(File(filesDir, "backend_profiles.json.tmp").exists())
+    }
+
+    @Test
+    fun `recorded backend failure is reported until it expires`() {
+        provider.recordBackendBenchmark("model@soc", BackendType.OPENCL, null)
+
+        val profile = provider.getBackendProfile("model@soc")
+        assertTrue(BackendType.OPENCL in profile)
+        assertEquals(null, profile[BackendType.OPENCL])
+
+        now += 8L * 24 * 60 * 60 * 1000
+        assertFalse(BackendType.OPENCL in provider.getBackendProfile("model@soc"))
+    }
+
+    @Test
+    fun `recorded backend failure is retried after a software update`() {
+        provider.recordBackendBenchmark("model@soc", BackendType.VULKAN, null)
+
+        softwareBuild = "build-2"
+
+        assertFalse(BackendType.VULKAN in provider.getBackendProfile("model@soc"))
+    }
+
+    @Test
+    fun `CPU failure is never recorded`() {
+        provider.recordBackendBenchmark("model@soc", BackendType.CPU, BackendBenchmark(50f, 8f))
+        provider.recordBackendBenchmark("model@soc", BackendType.CPU, null)
+
+        assertEquals(mapOf(BackendType.CPU to BackendBenchmark(50f, 8f)), provider.getBackendProfile("model@soc"))
+    }
+
+    @Test
+    fun `unreadable backend profiles are discarded`() {
+        File(filesDir, "backend_profiles.json").writeText("{truncated")
+
+        assertEquals(emptyMap<BackendType, BackendBenchmark?>(), provider.getBackendProfile("model@soc"))
+    }
+}
@@ -0,0 +1,108 @@
+package com.synapsenotes.ai.core.ai
+
+import android.content.Context
+import com.synapsenotes.ai.domain.model.Note
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import io.mockk.coEvery
+import io.mockk.coVerify
+import io.mockk.every
+import io.mockk.mockk
+import io.mockk.slot
+import io.mockk.verify
+import org.junit.jupiter.api.Assertions.assertFalse
+import org.junit.jupiter.api.Assertions.assertTrue
+import org.junit.jupiter.api.BeforeEach
+import org.junit.jupiter.api.Test
+import org.junit.jupiter.api.io.TempDir
+import java.io.File
+
+class EmbeddingIndexerTest {
+
+    @TempDir
+    lateinit var filesDir: File
+
+    private val context: Context = mockk(relaxed = true)
+    private val llmContext: LlmContext = mockk(relaxed = true)
+    private val repository: NoteRepository = mockk(relaxed = true)
+    private val noteVectorIndex: NoteVectorIndex = mockk(relaxed = true)
+    private val pipelineCallback = slot<EmbeddingPipelineCallback>()
+
+    private lateinit var indexer: EmbeddingIndexer
+
+    private fun note(id: String, updatedAt: Long) =
+        Note(id = id, title = id, content = "Text of $id", createdAt = 1L, updatedAt = updatedAt, tags = emptyList(), embedding = null)
+
+    @BeforeEach
+    fun setup() {
+        every { context.filesDir } returns filesDir
+        every { llmContext.startEmbeddingPipeline(capture(pipelineCallback), any()) } returns true
+        every { llmContext.enqueueEmbedding(any(), any(), any()) } returns true
+        indexer = EmbeddingIndexer(context, llmContext, repository, noteVectorIndex)
+    }
+
+    @Test
+    fun `enqueue passes the note version to the pipeline`() {
+        assertTrue(indexer.enqueueAll(listOf(note("a", 10L), note("b", 20L))))
+
+        verify { llmContext.enqueueEmbedding("a", "Text of a", 10L) }
+        verify { llmContext.enqueueEmbedding("b", "Text of b", 20L) }
+        assertTrue(File(filesDir, "embed_cache").isDirectory)
+    }
+
+    @Test
+    fun `embedding is stored on the note and in the vector index`() {
+        val vector = floatArrayOf(0.1f, 0.2f)
+        coEvery { repository.updateEmbedding("a", 10L, vector) } returns true
+        indexer.enqueue(note("a", 10L))
+
+        pipelineCallback.captured.onEmbedded("a", 10L, vector)
+
+        coVerify(timeout = 2000) { noteVectorIndex.upsert("a", vector) }
+    }
+
+    @Test
+    fun `result for an outdated version is dropped`() {
+        val stale = floatArrayOf(1f, 0f)
+        val fresh = floatArrayOf(0f, 1f)
+        coEvery { repository.updateEmbedding("a", 10L, any()) } returns false
+        coEvery { repository.updateEmbedding("a", 11L, any()) } returns true
+        indexer.enqueue(note("a", 11L))
+
+        pipelineCallback.captured.onEmbedded("a", 10L, stale)
+        pipelineCallback.captured.onEmbedded("a", 11L, fresh)
+
+        // Results are stored in order, so the stale one has been handled once the fresh one is
+        coVerify(timeout = 2000) { noteVectorIndex.upsert("a", fresh) }
+        coVerify(exactly = 0) { noteVectorIndex.upsert("a", stale) }
+        coVerify(exactly = 0) { noteVectorIndex.remove(any()) }
+    }
+
+    @Test
+    fun `failed embedding removes the note from the vector index`() {
+        coEvery { repository.updateEmbedding("a", 10L, null) } returns true
+        indexer.enqueue(note("a", 10L))
+
+        pipelineCallback.captured.onEmbedded("a", 10L, null)
+
+        coVerify(timeout = 2000) { noteVectorIndex.remove("a") }
+        coVerify(exactly = 0) { noteVectorIndex.upsert(any(), any()) }
+    }
+
+    @Test
+    fun `cancel reaches the pipeline only once it has started`() {
+        indexer.cancel("a")
+        verify(exactly = 0) { llmContext.cancelEmbedding(any()) }
+
+        indexer.enqueue(note("a", 10L))
+        indexer.cancel("a")
+        verify { llmContext.cancelEmbedding("a") }
+    }
+
+    @Test
+    fun `enqueue fails when the native pipeline is unavailable`() {
+        every { llmContext.startEmbeddingPipeline(any(), any()) } returns false
+
+        assertFalse(indexer.enqueue(note("a", 10L)))
+        verify(exactly = 0) { llmContext.enqueueEmbedding(any(), any(), any()) }
+    }
+}
@@ -13,8 +13,12 @@ import org.mockito.ArgumentMatchers.anyInt
 import org.mockito.ArgumentMatchers.anyString
 import org.mockito.kotlin.any
 import org.mockito.kotlin.anyOrNull
+import org.mockito.kotlin.atLeastOnce
 import org.mockito.kotlin.doAnswer
+import org.mockito.kotlin.eq
+import org.mockito.kotlin.isNull
 import org.mockito.kotlin.mock
+import org.mockito.kotlin.never
 import org.mockito.kotlin.verify
 import org.mockito.kotlin.whenever
 
@@ -35,30 +39,48 @@ class LlmEngineTest {
         whenever(hardwareCapabilityProvider.getRecommendedContextSize()).thenReturn(2048)
         whenever(hardwareCapabilityProvider.isVulkanSupported()).thenReturn(true)
         whenever(hardwareCapabilityProvider.getGpuName()).thenReturn("Test GPU")
+        whenever(hardwareCapabilityProvider.getAvailableBackends()).thenReturn(listOf(BackendType.VULKAN))
+        whenever(llmContext.benchmarkBackend()).thenReturn(BackendBenchmark(100f, 10f))
         
         llmEngine = LlmEngine(hardwareCapabilityProvider, llmContext)
     }
 
+    // Native loads run on their own thread and report through the callback
+    private fun stubModelLoad(success: Boolean) {
+        doAnswer { invocation ->
+            invocation.getArgument<ModelLoadCallback>(6).onComplete(success, false)
+            1L
+        }.whenever(llmContext).startModelLoad(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any(), any())
+    }
+
+    private fun stubModelLoad(loads: (BackendType) -> Boolean) {
+        doAnswer { invocation ->
+            val backend = invocation.getArgument<BackendType>(5)
+            invocation.getArgument<ModelLoadCallback>(6).onComplete(loads(backend), false)
+            1L
+        }.whenever(llmContext).startModelLoad(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any(), any())
+    }
+
     @Test
     fun `loadModel success calls context load`() = runTest {
         whenever(hardwareCapabilityProvider.getPreferredBackend()).thenReturn(BackendType.VULKAN)
         whenever(hardwareCapabilityProvider.isMmapSafe()).thenReturn(true)
         
-        // Match 6 arguments: path, template, nBatch, nCtx, useMmap, backendType
-        whenever(llmContext.loadModel(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any())).thenReturn(true)
+        stubModelLoad(true)
         whenever(llmContext.isGpuEnabled()).thenReturn(true)
         
         val result = llmEngine.loadModel("/path/to/model")
         
         assertTrue(result.isSuccess)
-        verify(llmContext).loadModel(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any())
+        // Match 7 arguments: path, template, nBatch, nCtx, useMmap, backendType, callback
+        verify(llmContext, atLeastOnce()).startModelLoad(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any(), any())
     }
     
     @Test
     fun `completionFlow emits tokens`() = runTest {
         whenever(hardwareCapabilityProvider.getPreferredBackend()).thenReturn(BackendType.VULKAN)
         whenever(hardwareCapabilityProvider.isMmapSafe()).thenReturn(true)
-        whenever(llmContext.loadModel(anyString(), anyOrNull(), anyInt(), anyInt(), any(), any())).thenReturn(true)
+        stubModelLoad(true)
         llmEngine.loadModel("path")
         
         doAnswer { invocation ->
@@ -72,4 +94,58 @@ class LlmEngineTest {
         
         assertEquals(listOf("Hello", " World"), tokens)
     }
+
+    @Test
+    fun `loadModel picks the backend with the fastest typical turn`() = runTest {
+        whenever(hardwareCapabilityProvider.getAvailableBackends())
+            .thenReturn(listOf(BackendType.VULKAN, BackendType.OPENCL, BackendType.CPU))
+        whenever(llmContext.getBackendProfileKey(anyString())).thenReturn("model@soc")
+        // VULKAN prefills fastest, but OPENCL's decode speed wins a typical turn
+        whenever(hardwareCapabilityProvider.getBackendProfile("model@soc")).thenReturn(mapOf(
+            BackendType.VULKAN to BackendBenchmark(400f, 8f),
+            BackendType.OPENCL to BackendBenchmark(200f, 20f),
+            BackendType.CPU to BackendBenchmark(50f, 6f)
+        ))
+        stubModelLoad { true }
+
+        val result = llmEngine.loadModel("/path/to/model")
+
+        assertTrue(result.isSuccess)
+        verify(hardwareCapabilityProvider).setPreferredBackend(BackendType.OPENCL)
+        verify(llmContext, never()).startModelLoad(anyString(), anyOrNull(), anyInt(), anyInt(), any(), eq(BackendType.VULKAN), any())
+        verify(llmContext, never()).benchmarkBackend()
+    }
+
+    @Test
+    fun `loadModel benchmarks unmeasured backends and records the results`() = runTest {
+        whenever(hardwareCapabilityProvider.getAvailableBackends()).thenReturn(listOf(BackendType.VULKAN, BackendType.CPU))
+        whenever(llmContext.getBackendProfileKey(anyString())).thenReturn("model@soc")
+        whenever(hardwareCapabilityProvider.getBackendProfile("model@soc")).thenReturn(emptyMap())
+        stubModelLoad { it == BackendType.CPU }
+        whenever(llmContext.benchmarkBackend()).thenReturn(BackendBenchmark(50f, 6f))
+
+        val result = llmEngine.loadModel("/path/to/model")
+
+        assertTrue(result.isSuccess)
+        verify(hardwareCapabilityProvider).recordBackendBenchmark(eq("model@soc"), eq(BackendType.VULKAN), isNull())
+        verify(hardwareCapabilityProvider).recordBackendBenchmark("model@soc", BackendType.CPU, BackendBenchmark(50f, 6f))
+        verify(hardwareCapabilityProvider).setPreferredBackend(BackendType.CPU)
+    }
+
+    @Test
+    fun `loadModel falls back when the fastest backend no longer loads`() = runTest {
+        whenever(hardwareCapabilityProvider.getAvailableBackends()).thenReturn(listOf(BackendType.VULKAN, BackendType.CPU))
+        whenever(llmContext.getBackendProfileKey(anyString())).thenReturn("model@soc")
+        whenever(hardwareCapabilityProvider.getBackendProfile("model@soc")).thenReturn(mapOf(
+            BackendType.VULKAN to BackendBenchmark(400f, 30f),
+            BackendType.CPU to BackendBenchmark(50f, 6f)
+        ))
+        stubModelLoad { it == BackendType.CPU }
+
+        val result = llmEngine.loadModel("/path/to/model")
+
+        assertTrue(result.isSuccess)
+        verify(hardwareCapabilityProvider).recordBackendBenchmark(eq("model@soc"), eq(BackendType.VULKAN), isNull())
+        verify(hardwareCapabilityProvider).setPreferredBackend(BackendType.CPU)
+    }
 }
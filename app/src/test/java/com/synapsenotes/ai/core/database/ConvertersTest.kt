@@ -0,0 +1,37 @@
+package com.synapsenotes.ai.core.database
+
+import org.junit.jupiter.api.Assertions.assertArrayEquals
+import org.junit.jupiter.api.Assertions.assertEquals
+import org.junit.jupiter.api.Assertions.assertNull
+import org.junit.jupiter.api.Test
+
+class ConvertersTest {
+
+    private val converters = Converters()
+
+    @Test
+    fun `embedding survives a blob round trip`() {
+        val vector = floatArrayOf(0.5f, -1.25f, 3.0e-7f, Float.MAX_VALUE, 0f)
+
+        val blob = converters.toEmbeddingBlob(vector)
+
+        assertEquals(vector.size * 4, blob!!.size)
+        assertArrayEquals(vector, converters.fromEmbeddingBlob(blob))
+    }
+
+    @Test
+    fun `blob is little-endian float32`() {
+        val blob = converters.toEmbeddingBlob(floatArrayOf(1.0f))
+
+        // 1.0f is 0x3F800000
+        assertArrayEquals(byteArrayOf(0x00, 0x00, 0x80.toByte(), 0x3F), blob)
+    }
+
+    @Test
+    fun `missing or malformed blobs read as no embedding`() {
+        assertNull(converters.toEmbeddingBlob(null))
+        assertNull(converters.fromEmbeddingBlob(null))
+        assertNull(converters.fromEmbeddingBlob(ByteArray(0)))
+        assertNull(converters.fromEmbeddingBlob(ByteArray(6)))
+    }
+}
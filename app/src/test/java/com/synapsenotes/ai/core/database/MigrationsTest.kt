@@ -0,0 +1,66 @@
+package com.synapsenotes.ai.core.database
+
+import android.database.Cursor
+import androidx.sqlite.db.SupportSQLiteDatabase
+import io.mockk.Runs
+import io.mockk.every
+import io.mockk.just
+import io.mockk.mockk
+import io.mockk.verifyOrder
+import org.junit.jupiter.api.Assertions.assertArrayEquals
+import org.junit.jupiter.api.Assertions.assertEquals
+import org.junit.jupiter.api.Test
+
+class MigrationsTest {
+
+    private val db: SupportSQLiteDatabase = mockk(relaxed = true)
+    private val updates = mutableListOf<Array<Any?>>()
+
+    private fun legacyRows(vararg rows: Pair<String, String>) {
+        val cursor: Cursor = mockk(relaxed = true)
+        var position = -1
+        every { cursor.moveToNext() } answers { ++position < rows.size }
+        every { cursor.getString(0) } answers { rows[position].first }
+        every { cursor.getString(1) } answers { rows[position].second }
+        every { db.query(any<String>()) } returns cursor
+        every { db.execSQL(any(), capture(updates)) } just Runs
+    }
+
+    private fun convertedRows(): Map<String, FloatArray?> =
+        updates.associate { args -> args[1] as String to Converters().fromEmbeddingBlob(args[0] as ByteArray) }
+
+    @Test
+    fun `migration 3 to 4 converts legacy text embeddings to blobs`() {
+        legacyRows("a" to "0.5,-1.25,2", "b" to " 1.0 , 2.5 ")
+
+        MIGRATION_3_4.migrate(db)
+
+        val converted = convertedRows()
+        assertEquals(setOf("a", "b"), converted.keys)
+        assertArrayEquals(floatArrayOf(0.5f, -1.25f, 2f), converted["a"])
+        assertArrayEquals(floatArrayOf(1.0f, 2.5f), converted["b"])
+    }
+
+    @Test
+    fun `migration 3 to 4 leaves unparsable embeddings empty for reindexing`() {
+        legacyRows("good" to "1,2", "bad" to "1,abc,3")
+
+        MIGRATION_3_4.migrate(db)
+
+        assertEquals(setOf("good"), convertedRows().keys)
+    }
+
+    @Test
+    fun `migration 3 to 4 replaces the notes table`() {
+        legacyRows()
+
+        MIGRATION_3_4.migrate(db)
+
+        verifyOrder {
+            db.execSQL(match<String> { it.startsWith("CREATE TABLE notes_new") })
+            db.execSQL(match<String> { it.startsWith("INSERT INTO notes_new") })
+            db.execSQL("DROP TABLE notes")
+            db.execSQL("ALTER TABLE notes_new RENAME TO notes")
+        }
+    }
+}
@@ -0,0 +1,78 @@
+package com.synapsenotes.ai.domain.usecase
+
+import com.synapsenotes.ai.core.ai.EmbeddingIndexer
+import com.synapsenotes.ai.core.ai.NoteTextIndex
+import com.synapsenotes.ai.core.ai.NoteVectorIndex
+import com.synapsenotes.ai.domain.model.Note
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import io.mockk.coVerify
+import io.mockk.every
+import io.mockk.mockk
+import io.mockk.verify
+import kotlinx.coroutines.test.runTest
+import org.junit.jupiter.api.Test
+
+class SaveNoteUseCaseTest {
+
+    private val repository: NoteRepository = mockk(relaxed = true)
+    private val embeddingIndexer: EmbeddingIndexer = mockk(relaxed = true)
+    private val noteVectorIndex: NoteVectorIndex = mockk(relaxed = true)
+    private val noteTextIndex: NoteTextIndex = mockk(relaxed = true)
+
+    private val saveNote = SaveNoteUseCase(repository, embeddingIndexer, noteVectorIndex, noteTextIndex)
+
+    private fun note(id: String, content: String) =
+        Note(id = id, title = "Title $id", content = content, createdAt = 1L, updatedAt = 2L, tags = emptyList(), embedding = null)
+
+    @Test
+    fun `saveAll queues notes with content and drops blank ones from the vector index`() = runTest {
+        val full = note("full", "Some text")
+        val blank = note("blank", "  ")
+        every { embeddingIndexer.enqueueAll(any()) } returns true
+
+        saveNote.saveAll(listOf(full, blank))
+
+        coVerify { repository.saveNote(full) }
+        coVerify { repository.saveNote(blank) }
+        coVerify { noteTextIndex.upsertAll(listOf(full, blank)) }
+        verify { embeddingIndexer.enqueueAll(listOf(full)) }
+        coVerify { noteVectorIndex.remove("blank") }
+        coVerify(exactly = 0) { noteVectorIndex.remove("full") }
+    }
+
+    @Test
+    fun `saveAll drops queued notes from the vector index when the pipeline is unavailable`() = runTest {
+        val first = note("a", "First")
+        val second = note("b", "Second")
+        every { embeddingIndexer.enqueueAll(any()) } returns false
+
+        saveNote.saveAll(listOf(first, second))
+
+        coVerify { noteVectorIndex.remove("a") }
+        coVerify { noteVectorIndex.remove("b") }
+    }
+
+    @Test
+    fun `saving a note keeps its previous vector until the new one is embedded`() = runTest {
+        val edited = note("a", "Edited text")
+        every { embeddingIndexer.enqueue(edited) } returns true
+
+        saveNote(edited)
+
+        coVerify { repository.saveNote(edited) }
+        coVerify { noteTextIndex.upsert(edited) }
+        coVerify(exactly = 0) { noteVectorIndex.remove(any()) }
+        verify(exactly = 0) { embeddingIndexer.cancel(any()) }
+    }
+
+    @Test
+    fun `saving an emptied note cancels its embedding and drops its vector`() = runTest {
+        val emptied = note("a", "")
+
+        saveNote(emptied)
+
+        verify(exactly = 0) { embeddingIndexer.enqueue(any()) }
+        verify { embeddingIndexer.cancel("a") }
+        coVerify { noteVectorIndex.remove("a") }
+    }
+}
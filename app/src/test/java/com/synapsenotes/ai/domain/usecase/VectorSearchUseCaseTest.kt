@@ -0,0 +1,100 @@
+package com.synapsenotes.ai.domain.usecase
+
+import com.synapsenotes.ai.core.ai.LlmEngine
+import com.synapsenotes.ai.core.ai.NoteTextIndex
+import com.synapsenotes.ai.core.ai.NoteVectorIndex
+import com.synapsenotes.ai.domain.model.Note
+import com.synapsenotes.ai.domain.repository.NoteRepository
+import io.mockk.coEvery
+import io.mockk.coVerify
+import io.mockk.every
+import io.mockk.mockk
+import kotlinx.coroutines.flow.flowOf
+import kotlinx.coroutines.test.runTest
+import org.junit.jupiter.api.Assertions.assertEquals
+import org.junit.jupiter.api.BeforeEach
+import org.junit.jupiter.api.Test
+
+class VectorSearchUseCaseTest {
+
+    private val repository: NoteRepository = mockk(relaxed = true)
+    private val llmEngine: LlmEngine = mockk(relaxed = true)
+    private val noteVectorIndex: NoteVectorIndex = mockk(relaxed = true)
+    private val noteTextIndex: NoteTextIndex = mockk(relaxed = true)
+
+    private val search = VectorSearchUseCase(repository, llmEngine, noteVectorIndex, noteTextIndex)
+
+    private val notes = listOf(
+        note("kotlin", "Kotlin coroutines", floatArrayOf(1f, 0f)),
+        note("rust", "Rust ownership", floatArrayOf(0.6f, 0.8f)),
+        note("recipes", "Pasta recipes", floatArrayOf(0f, 1f)),
+        note("draft", "Kotlin flows draft", null)
+    ).associateBy { it.id }
+
+    private val vectorHits = listOf("kotlin" to 0.9f, "rust" to 0.7f, "recipes" to 0.1f)
+
+    private fun note(id: String, content: String, embedding: FloatArray?) =
+        Note(id = id, title = id, content = content, createdAt = 1L, updatedAt = 1L, tags = emptyList(), embedding = embedding)
+
+    private fun ids(result: List<Note>) = result.map { it.id }
+
+    @BeforeEach
+    fun setup() {
+        every { repository.getAllNotes() } returns flowOf(notes.values.toList())
+        coEvery { repository.getNoteById(any()) } answers { notes[firstArg()] }
+        coEvery { llmEngine.embed(any()) } returns floatArrayOf(1f, 0f)
+    }
+
+    @Test
+    fun `hybrid ranking decides the order of the vector hits`() = runTest {
+        coEvery { noteVectorIndex.search(any(), any()) } returns vectorHits
+        coEvery { noteTextIndex.searchHybrid("rust", 2, vectorHits, 0.7f) } returns listOf("rust", "kotlin")
+
+        val result = search("rust", topK = 2)
+
+        assertEquals(listOf("rust", "kotlin"), ids(result))
+        // Candidates are over-fetched so keyword relevance can reorder them
+        coVerify { noteVectorIndex.search(any(), 20) }
+    }
+
+    @Test
+    fun `vector hits are used as ranked when the text index is unavailable`() = runTest {
+        coEvery { noteVectorIndex.search(any(), any()) } returns vectorHits
+        coEvery { noteTextIndex.searchHybrid(any(), any(), any(), any()) } returns null
+
+        val result = search("anything", topK = 2)
+
+        assertEquals(listOf("kotlin", "rust"), ids(result))
+    }
+
+    @Test
+    fun `falls back to a cosine scan when the vector index is unavailable`() = runTest {
+        coEvery { noteVectorIndex.search(any(), any()) } returns null
+
+        val result = search("anything", topK = 3)
+
+        // Notes without an embedding are skipped
+        assertEquals(listOf("kotlin", "rust", "recipes"), ids(result))
+    }
+
+    @Test
+    fun `falls back to BM25 when the query cannot be embedded`() = runTest {
+        coEvery { llmEngine.embed(any()) } throws IllegalStateException("Embedding model not loaded")
+        coEvery { noteTextIndex.search("kotlin", 3) } returns listOf("draft" to 2.5f, "kotlin" to 1.5f)
+
+        val result = search("kotlin")
+
+        assertEquals(listOf("draft", "kotlin"), ids(result))
+        coVerify(exactly = 0) { noteVectorIndex.search(any(), any()) }
+    }
+
+    @Test
+    fun `falls back to substring matching without embeddings or text index`() = runTest {
+        coEvery { llmEngine.embed(any()) } throws IllegalStateException("Embedding model not loaded")
+        coEvery { noteTextIndex.search(any(), any()) } returns null
+
+        val result = search("KOTLIN")
+
+        assertEquals(listOf("kotlin", "draft"), ids(result))
+    }
+}
@@ -2,6 +2,7 @@ package com.synapsenotes.ai.feature.chat
 
 import com.synapsenotes.ai.core.ai.HardwareInfo
 import com.synapsenotes.ai.core.ai.LlmEngine
+import com.synapsenotes.ai.core.ai.ModelManager
 import com.synapsenotes.ai.domain.repository.ChatRepository
 import com.synapsenotes.ai.domain.repository.NoteRepository
 import com.synapsenotes.ai.domain.usecase.VectorSearchUseCase
@@ -28,6 +29,7 @@ class ChatViewModelTest {
     private val llmEngine: LlmEngine = mockk(relaxed = true)
     private val chatRepository: ChatRepository = mockk(relaxed = true)
     private val noteRepository: NoteRepository = mockk(relaxed = true)
+    private val modelManager: ModelManager = mockk(relaxed = true)
 
     @BeforeEach
     fun setup() {
@@ -39,7 +41,8 @@ class ChatViewModelTest {
             vectorSearchUseCase,
             llmEngine,
             chatRepository,
-            noteRepository
+            noteRepository,
+            modelManager
         )
     }
 